@@ -0,0 +1,411 @@
+#include "Benchmark.h"
+#include "Game.h"
+#include "String.h"
+#include "Stream.h"
+#include "Platform.h"
+#include "Builder.h"
+#include "Entity.h"
+#include "EntityComponents.h"
+#include "ExtMath.h"
+#include "Window.h"
+#include "World.h"
+#include "Graphics.h"
+#include "Logger.h"
+#include "Funcs.h"
+#include "Server.h"
+#include "Protocol.h"
+#include "Event.h"
+
+#if defined CC_BUILD_WIN && !defined CC_BUILD_UWP
+	#define WIN32_LEAN_AND_MEAN
+	#define NOSERVICE
+	#define NOMCX
+	#define NOIME
+	#include <windows.h>
+	#include <psapi.h>
+#elif defined CC_BUILD_DARWIN
+	#include <mach/mach.h>
+#endif
+
+cc_bool Benchmark_Enabled, Benchmark_Network;
+/* Number of frames the camera takes to complete one orbit around the map */
+#define BENCHMARK_FRAMES 1200
+/* Camera pitch while orbiting (positive pitch looks down) */
+#define BENCHMARK_PITCH 25.0f
+
+static cc_bool running;
+static int frameIndex;
+static cc_uint64 frameStart, benchStart;
+static cc_uint32 frameTimes[BENCHMARK_FRAMES];
+static float totalVertices;
+
+static int begChunksBuilt;
+static cc_uint64 begBuildTime, begLightTime;
+
+static cc_uint64 frameTotal, joinStart, joinTotal;
+static cc_uint32 frameMax, joinMax;
+static int joinCount;
+
+
+/*########################################################################################################################*
+*-------------------------------------------------------Camera path-------------------------------------------------------*
+*#########################################################################################################################*/
+/* Moves the camera to the given point on a circle around the map, looking down towards the centre */
+/* NOTE: The path only depends on the frame number, so that every run renders exactly the same frames */
+static void MoveCamera(int frame) {
+	struct LocalPlayer* p = Entities.CurPlayer;
+	struct LocationUpdate update;
+	float angle  = (float)frame / BENCHMARK_FRAMES * 360.0f;
+	float radius = min(World.Width, World.Length) * 0.4f;
+	float rad    = angle * MATH_DEG2RAD;
+
+	update.flags = LU_HAS_POS | LU_HAS_YAW | LU_HAS_PITCH | LU_POS_ABSOLUTE_INSTANT;
+	update.pos.x = World.Width  * 0.5f - Math_SinF(rad) * radius;
+	update.pos.y = World.Height * 0.75f;
+	update.pos.z = World.Length * 0.5f + Math_CosF(rad) * radius;
+	update.yaw   = angle;
+	update.pitch = BENCHMARK_PITCH;
+	p->Base.VTABLE->SetLocation(&p->Base, &update);
+}
+
+
+/*########################################################################################################################*
+*---------------------------------------------------------Results---------------------------------------------------------*
+*#########################################################################################################################*/
+static void SortFrameTimes(int left, int right) {
+	cc_uint32* keys = frameTimes; cc_uint32 key;
+
+	while (left < right) {
+		int i = left, j = right;
+		cc_uint32 pivot = keys[(i + j) >> 1];
+
+		/* partition the list */
+		while (i <= j) {
+			while (pivot > keys[i]) i++;
+			while (pivot < keys[j]) j--;
+			QuickSort_Swap_Maybe();
+		}
+		/* recurse into the smaller subset */
+		QuickSort_Recurse(SortFrameTimes)
+	}
+}
+
+static int Percentile(int percent) {
+	return (int)frameTimes[(BENCHMARK_FRAMES - 1) * percent / 100];
+}
+
+/* Peak memory used by the process is only known on some platforms */
+#if defined CC_BUILD_WIN && !defined CC_BUILD_UWP
+#define BENCHMARK_PEAK_MEMORY
+static BOOL (WINAPI *_GetProcessMemoryInfo)(HANDLE process, PROCESS_MEMORY_COUNTERS* counters, DWORD cb);
+
+static cc_bool PeakMemoryKB(int* value) {
+	static const struct DynamicLibSym funcs[] = {
+		DynamicLib_OptSym(GetProcessMemoryInfo)
+	};
+	static const cc_string psapi = String_FromConst("PSAPI.DLL");
+	PROCESS_MEMORY_COUNTERS counters;
+	void* lib;
+
+	if (!_GetProcessMemoryInfo) {
+		DynamicLib_LoadAll(&psapi, funcs, Array_Elems(funcs), &lib);
+		if (!_GetProcessMemoryInfo) return false;
+	}
+
+	counters.cb = sizeof(counters);
+	if (!_GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return false;
+	*value = (int)(counters.PeakWorkingSetSize / 1024);
+	return true;
+}
+#elif defined CC_BUILD_DARWIN
+#define BENCHMARK_PEAK_MEMORY
+static cc_bool PeakMemoryKB(int* value) {
+	struct mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count)) return false;
+	*value = (int)(info.resident_size_max / 1024);
+	return true;
+}
+#elif defined CC_BUILD_LINUX
+#define BENCHMARK_PEAK_MEMORY
+static cc_bool PeakMemoryKB(int* value) {
+	static const cc_string path = String_FromConst("/proc/self/status");
+	static const cc_string key  = String_FromConst("VmHWM:");
+	cc_string line; char lineBuffer[STRING_SIZE];
+	struct Stream stream;
+	cc_bool found = false;
+	int i;
+
+	if (Stream_OpenFile(&stream, &path)) return false;
+	String_InitArray(line, lineBuffer);
+
+	while (!Stream_ReadLine(&stream, &line)) {
+		if (!String_CaselessStarts(&line, &key)) continue;
+
+		/* e.g. "VmHWM:\t   12345 kB" */
+		*value = 0;
+		for (i = key.length; i < line.length; i++)
+		{
+			if (line.buffer[i] < '0' || line.buffer[i] > '9') continue;
+			*value = *value * 10 + (line.buffer[i] - '0');
+		}
+		found = true;
+		break;
+	}
+
+	stream.Close(&stream);
+	return found;
+}
+#endif
+
+static void WriteResults(void) {
+	static const cc_string path = String_FromConst("benchmark.json");
+	cc_string str; char strBuffer[1024];
+	cc_uint64 elapsed = Stopwatch_ElapsedMicroseconds(benchStart, Stopwatch_Measure());
+	int totalMs, meanFrame, p50, p90, p99, maxFrame, vertices;
+	int chunks, buildMs, lightMs;
+#ifdef BENCHMARK_PEAK_MEMORY
+	int memory;
+#endif
+	cc_uint64 total = 0;
+	struct Stream stream;
+	cc_result res;
+	int i;
+
+	for (i = 0; i < BENCHMARK_FRAMES; i++) total += frameTimes[i];
+	SortFrameTimes(0, BENCHMARK_FRAMES - 1);
+
+	totalMs   = (int)(elapsed / 1000);
+	meanFrame = (int)(total / BENCHMARK_FRAMES);
+	p50 = Percentile(50); p90 = Percentile(90); p99 = Percentile(99);
+	maxFrame  = (int)frameTimes[BENCHMARK_FRAMES - 1];
+	vertices  = (int)(totalVertices / BENCHMARK_FRAMES);
+
+	chunks  = Builder_ChunksBuilt - begChunksBuilt;
+	buildMs = (int)((Builder_BuildTime - begBuildTime) / 1000);
+	lightMs = (int)((Builder_LightTime - begLightTime) / 1000);
+
+	res = Stream_CreateFile(&stream, &path);
+	if (res) { Logger_SysWarn2(res, "creating", &path); return; }
+	String_InitArray(str, strBuffer);
+
+	String_Format3(&str, "{ \"frames\": %i, \"totalMs\": %i, \"builderThreads\": %i, ",
+		&frameIndex, &totalMs, &Builder_WorkerThreads);
+	String_Format3(&str, "\"mapSize\": [%i, %i, %i], ",
+		&World.Width, &World.Height, &World.Length);
+	String_Format1(&str, "\"frameTimeUs\": { \"mean\": %i, ", &meanFrame);
+	String_Format4(&str, "\"p50\": %i, \"p90\": %i, \"p99\": %i, \"max\": %i }, ",
+		&p50, &p90, &p99, &maxFrame);
+	String_Format4(&str, "\"verticesPerFrame\": %i, \"chunksBuilt\": %i, \"chunkBuildMs\": %i, \"lightingMs\": %i",
+		&vertices, &chunks, &buildMs, &lightMs);
+#ifdef BENCHMARK_PEAK_MEMORY
+	/* Left out entirely on platforms where it can't be measured */
+	if (PeakMemoryKB(&memory)) String_Format1(&str, ", \"peakMemoryKB\": %i", &memory);
+#endif
+	String_AppendConst(&str, " }");
+
+	res = Stream_WriteLine(&stream, &str);
+	if (res) Logger_SysWarn2(res, "writing", &path);
+	stream.Close(&stream);
+}
+
+
+/*########################################################################################################################*
+*--------------------------------------------------------Benchmark--------------------------------------------------------*
+*#########################################################################################################################*/
+static void Benchmark_Start(void) {
+	struct LocalPlayer* p = Entities.CurPlayer;
+	running    = true;
+	frameIndex = 0;
+	totalVertices = 0;
+
+	begChunksBuilt = Builder_ChunksBuilt;
+	begBuildTime   = Builder_BuildTime;
+	begLightTime   = Builder_LightTime;
+
+	/* Stop the camera from falling or colliding with terrain while moving along the path */
+	HacksComp_SetFlying(&p->Hacks, true);
+	HacksComp_SetNoclip(&p->Hacks, true);
+	MoveCamera(0);
+
+	benchStart = Stopwatch_Measure();
+	frameStart = benchStart;
+}
+
+static void Benchmark_Finish(void) {
+	running = false;
+	WriteResults();
+	Window_RequestClose();
+}
+
+/* Called once per frame after everything else has been rendered */
+static void Benchmark_OnFrame(float delta) {
+	cc_uint64 now;
+	if (!running) return;
+
+	now = Stopwatch_Measure();
+	frameTimes[frameIndex] = (cc_uint32)Stopwatch_ElapsedMicroseconds(frameStart, now);
+	totalVertices += Game_Vertices;
+	frameStart     = now;
+
+	if (++frameIndex == BENCHMARK_FRAMES) {
+		Benchmark_Finish();
+	} else {
+		MoveCamera(frameIndex);
+	}
+}
+
+
+/*########################################################################################################################*
+*----------------------------------------------------Network benchmark----------------------------------------------------*
+*#########################################################################################################################*/
+static int PerSecond(cc_uint64 value, int totalMs) {
+	return totalMs ? (int)(value * 1000 / totalMs) : 0;
+}
+
+static void WriteNetHandlers(struct Stream* stream, cc_string* str) {
+	int i, count, time;
+	cc_bool first = true;
+
+	for (i = 0; i < 256; i++)
+	{
+		if (!NetStats.Counts[i]) continue;
+		count = (int)NetStats.Counts[i];
+		time  = (int)Stopwatch_ElapsedMicroseconds(0, NetStats.Times[i]);
+
+		str->length = 0;
+		String_Format4(str, "%c{ \"opcode\": %i, \"count\": %i, \"us\": %i }",
+			first ? "    " : "  , ", &i, &count, &time);
+		Stream_WriteLine(stream, str);
+		first = false;
+	}
+}
+
+static void WriteNetResults(void) {
+	static const cc_string path = String_FromConst("netbenchmark.json");
+	cc_string str; char strBuffer[1024];
+	cc_uint64 elapsed = Stopwatch_ElapsedMicroseconds(benchStart, Stopwatch_Measure());
+	int totalMs, bytes, packets, bytesPerSec, packetsPerSec;
+	int updates, updatesPerSec, handlerMs, joinMs, meanFrame;
+	cc_uint64 handlerTime = 0;
+	struct Stream stream;
+	cc_result res;
+	int i;
+
+	for (i = 0; i < 256; i++) handlerTime += NetStats.Times[i];
+	updates = (int)(NetStats.Counts[OPCODE_ENTITY_TELEPORT] + NetStats.Counts[OPCODE_ENTITY_TELEPORT_EXT]
+		+ NetStats.Counts[OPCODE_RELPOS_AND_ORI_UPDATE] + NetStats.Counts[OPCODE_RELPOS_UPDATE]
+		+ NetStats.Counts[OPCODE_ORI_UPDATE]);
+
+	totalMs   = (int)(elapsed / 1000);
+	bytes     = (int)NetStats.Bytes;
+	packets   = (int)NetStats.Packets;
+	handlerMs = (int)(Stopwatch_ElapsedMicroseconds(0, handlerTime) / 1000);
+	joinMs    = (int)(joinTotal / 1000);
+	meanFrame = frameIndex ? (int)(frameTotal / frameIndex) : 0;
+
+	bytesPerSec   = PerSecond(NetStats.Bytes,   totalMs);
+	packetsPerSec = PerSecond(NetStats.Packets, totalMs);
+	updatesPerSec = PerSecond(updates,          totalMs);
+
+	res = Stream_CreateFile(&stream, &path);
+	if (res) { Logger_SysWarn2(res, "creating", &path); return; }
+	String_InitArray(str, strBuffer);
+
+	String_Format4(&str, "{ \"totalMs\": %i, \"bytes\": %i, \"packets\": %i, \"handlerMs\": %i, ",
+		&totalMs, &bytes, &packets, &handlerMs);
+	String_Format2(&str, "\"bytesPerSec\": %i, \"packetsPerSec\": %i, ",
+		&bytesPerSec, &packetsPerSec);
+	String_Format2(&str, "\"entityUpdates\": %i, \"entityUpdatesPerSec\": %i, ",
+		&updates, &updatesPerSec);
+	String_Format3(&str, "\"mapJoins\": %i, \"mapJoinMs\": %i, \"maxMapJoinMs\": %i, ",
+		&joinCount, &joinMs, &joinMax);
+	String_Format3(&str, "\"frames\": %i, \"frameTimeUs\": { \"mean\": %i, \"max\": %i }, \"handlers\": [",
+		&frameIndex, &meanFrame, &frameMax);
+	Stream_WriteLine(&stream, &str);
+
+	WriteNetHandlers(&stream, &str);
+	str.length = 0;
+	String_AppendConst(&str, "] }");
+
+	res = Stream_WriteLine(&stream, &str);
+	if (res) Logger_SysWarn2(res, "writing", &path);
+	stream.Close(&stream);
+}
+
+static void Benchmark_OnConnected(void* obj) {
+	running    = true;
+	benchStart = Stopwatch_Measure();
+	frameStart = benchStart;
+}
+
+/* Called once per frame after everything else has been rendered */
+static void Benchmark_OnNetFrame(float delta) {
+	cc_uint64 now;
+	cc_uint32 elapsed;
+	if (!running) return;
+
+	now     = Stopwatch_Measure();
+	elapsed = (cc_uint32)Stopwatch_ElapsedMicroseconds(frameStart, now);
+	frameTotal += elapsed;
+	frameMax    = max(frameMax, elapsed);
+	frameStart  = now;
+	frameIndex++;
+
+	/* Finish once all captured data has been replayed (or replaying failed) */
+	if (!NetStats.ReplayEnded && !Server.Disconnected) return;
+	running = false;
+	WriteNetResults();
+	Window_RequestClose();
+}
+
+
+/*########################################################################################################################*
+*--------------------------------------------------Benchmark component----------------------------------------------------*
+*#########################################################################################################################*/
+static void OnInit(void) {
+	int i;
+	if (!Benchmark_Enabled) return;
+
+	/* Frames must be drawn as fast as possible to be measured */
+	Game_SetFpsLimit(FPS_LIMIT_NONE);
+	NetStats.MeasureHandlers = Benchmark_Network;
+	if (Benchmark_Network) Event_Register_(&NetEvents.Connected, NULL, Benchmark_OnConnected);
+
+	for (i = 0; i < Array_Elems(Game.Draw2DHooks); i++)
+	{
+		if (Game.Draw2DHooks[i]) continue;
+		Game.Draw2DHooks[i] = Benchmark_Network ? Benchmark_OnNetFrame : Benchmark_OnFrame; return;
+	}
+	{
+		static const cc_string msg = String_FromConst("&cNo free draw hook to run benchmark with");
+		Logger_WarnFunc(&msg);
+	}
+}
+
+static void OnNewMap(void) {
+	if (Benchmark_Network) joinStart = Stopwatch_Measure();
+}
+
+static void OnNewMapLoaded(void) {
+	cc_uint32 elapsed;
+	if (!Benchmark_Enabled) return;
+
+	if (Benchmark_Network) {
+		elapsed    = (cc_uint32)Stopwatch_ElapsedMicroseconds(joinStart, Stopwatch_Measure());
+		joinTotal += elapsed;
+		joinMax    = max(joinMax, elapsed / 1000);
+		joinCount++;
+	} else if (!running && !frameIndex) {
+		Benchmark_Start();
+	}
+}
+
+struct IGameComponent Benchmark_Component = {
+	OnInit,  /* Init */
+	NULL,    /* Free */
+	NULL,    /* Reset */
+	OnNewMap,      /* OnNewMap */
+	OnNewMapLoaded /* OnNewMapLoaded */
+};
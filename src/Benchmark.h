@@ -0,0 +1,22 @@
+#ifndef CC_BENCHMARK_H
+#define CC_BENCHMARK_H
+#include "Core.h"
+/* Measures how long frames and chunk mesh building take while flying the camera along a fixed path,
+     then writes the results to benchmark.json and closes the game.
+   Or measures how quickly captured network data is processed while replaying it,
+     then writes the results to netbenchmark.json and closes the game.
+   Copyright 2014-2025 ClassiCube | Licensed under BSD-3
+*/
+CC_BEGIN_HEADER
+
+struct IGameComponent;
+extern struct IGameComponent Benchmark_Component;
+/* Whether to run the benchmark once the map has finished loading */
+/* NOTE: Must be set before the game is started */
+extern cc_bool Benchmark_Enabled;
+/* Whether to measure replaying captured network data instead */
+/* NOTE: Must be set before the game is started */
+extern cc_bool Benchmark_Network;
+
+CC_END_HEADER
+#endif
@@ -8,6 +8,7 @@
 #include "Event.h"
 #include "Picking.h"
 #include "Lighting.h"
+#include "Platform.h"
 
 struct _BlockLists Blocks;
 
@@ -350,23 +351,17 @@ static cc_bool Block_MightCull(BlockID block, BlockID other) {
 	return (bType == COLLIDE_SOLID && oType == COLLIDE_SOLID) || bType != COLLIDE_SOLID;
 }
 
-static void Block_CalcCulling(BlockID block, BlockID other) {
+static cc_uint8 Block_CalcCulling(BlockID block, BlockID other) {
 	Vec3 bMin, bMax, oMin, oMax;
 	cc_bool occludedX, occludedY, occludedZ, bothLiquid;
 	int f;
 
 	/* Fast path: Full opaque neighbouring blocks will always have all shared faces hidden */
-	if (Blocks.FullOpaque[block] && Blocks.FullOpaque[other]) {
-		Blocks.Hidden[(block * BLOCK_COUNT) + other] = 0x3F;
-		return;
-	}
+	if (Blocks.FullOpaque[block] && Blocks.FullOpaque[other]) return 0x3F;
 
 	/* Some blocks may not cull 'other' block, in which case just skip detailed check */
 	/* e.g. sprite blocks, default leaves, will not cull any other blocks */
-	if (!Block_MightCull(block, other)) {	
-		Blocks.Hidden[(block * BLOCK_COUNT) + other] = 0;
-		return;
-	}
+	if (!Block_MightCull(block, other)) return 0;
 
 	bMin = Blocks.MinBB[block]; bMax = Blocks.MaxBB[block];
 	oMin = Blocks.MinBB[other]; oMax = Blocks.MaxBB[other];
@@ -390,30 +385,141 @@ static void Block_CalcCulling(BlockID block, BlockID other) {
 	f |= occludedZ && oMin.z == 0.0f && bMax.z == 1.0f ? FACE_BIT_ZMAX : 0;
 	f |= occludedY && (bothLiquid || (oMax.y == 1.0f && bMin.y == 0.0f)) ? FACE_BIT_YMIN : 0;
 	f |= occludedY && (bothLiquid || (oMin.y == 0.0f && bMax.y == 1.0f)) ? FACE_BIT_YMAX : 0;
-	Blocks.Hidden[(block * BLOCK_COUNT) + other] = f;
+	return f;
+}
+
+/* Block whose properties are used to calculate culling of each culling class, or -1 if class is unused */
+static int cullClassBlocks[BLOCK_COUNT];
+static int cullClassesCount;
+
+/* Water and lava have special culling rules based on their block IDs */
+static int Block_CullGroup(BlockID block) {
+	if (block == BLOCK_WATER || block == BLOCK_STILL_WATER) return 1;
+	if (block == BLOCK_LAVA  || block == BLOCK_STILL_LAVA)  return 2;
+	return 0;
+}
+
+/* Whether the two blocks hide and are hidden by all other blocks in exactly the same way */
+static cc_bool Block_CullsSame(BlockID a, BlockID b) {
+	cc_uint8 draw = Blocks.Draw[a];
+	if (a == b) return true;
+	if (draw != Blocks.Draw[b]) return false;
+	/* Sprites never hide or are hidden by other blocks */
+	if (draw == DRAW_SPRITE) return true;
+
+	if (Blocks.Collide[a] != Blocks.Collide[b] || Blocks.IsLiquid[a] != Blocks.IsLiquid[b]) return false;
+	if (!Vec3_Equals(&Blocks.MinBB[a], &Blocks.MinBB[b]))  return false;
+	if (!Vec3_Equals(&Blocks.MaxBB[a], &Blocks.MaxBB[b]))  return false;
+	if (Block_CullGroup(a) != Block_CullGroup(b)) return false;
+
+	/* These blocks hide faces of the same block, but not of different blocks with the same properties */
+	/* (see Block_MightCull), so each block needs its own culling class */
+	return !(draw == DRAW_TRANSPARENT || draw == DRAW_GAS || (draw == DRAW_OPAQUE && Blocks.IsLiquid[a]));
+}
+
+/* Calculates which faces are hidden between the given culling class and all other culling classes */
+static void Block_CalcClassCulling(int cls) {
+	BlockID block = (BlockID)cullClassBlocks[cls];
+	BlockID other;
+	int i;
+
+	for (i = 0; i < cullClassesCount; i++) {
+		if (cullClassBlocks[i] < 0) continue;
+		other = (BlockID)cullClassBlocks[i];
+
+		Block_HiddenFaces(cls, i) = Block_CalcCulling(block, other);
+		Block_HiddenFaces(i, cls) = Block_CalcCulling(other, block);
+	}
+}
+
+/* Ensures the table of hidden faces between culling classes can store at least the given number of classes */
+/* Returns true if the table had to be resized, in which case all of its entries need to be recalculated */
+static cc_bool Block_ReserveClasses(int count) {
+	int stride = Blocks.CullStride;
+	if (count <= stride) return false;
+
+	while (stride < count) stride = stride ? stride * 2 : 64;
+	stride = min(stride, BLOCK_COUNT);
+
+	Mem_Free(Blocks.Hidden);
+	Blocks.Hidden     = (cc_uint8*)Mem_Alloc(stride, stride, "culling classes");
+	Blocks.CullStride = stride;
+	return true;
+}
+
+static void Block_CalcAllClassCulling(void) {
+	int cls, other;
+	for (cls = 0; cls < cullClassesCount; cls++) {
+		if (cullClassBlocks[cls] < 0) continue;
+
+		for (other = 0; other < cullClassesCount; other++) {
+			if (cullClassBlocks[other] < 0) continue;
+			Block_HiddenFaces(cls, other) = Block_CalcCulling((BlockID)cullClassBlocks[cls], (BlockID)cullClassBlocks[other]);
+		}
+	}
+}
+
+/* Finds the culling class the given block belongs to, or -1 if there isn't one yet */
+static int Block_FindClass(BlockID block) {
+	int i;
+	for (i = 0; i < cullClassesCount; i++) {
+		if (cullClassBlocks[i] >= 0 && Block_CullsSame((BlockID)cullClassBlocks[i], block)) return i;
+	}
+	return -1;
 }
 
 /* Updates culling data of all blocks */
 static void Block_UpdateAllCulling(void) {
-	int block, neighbour;
+	int block, cls;
+	cullClassesCount = 0;
 
 	for (block = BLOCK_AIR; block < BLOCK_COUNT; block++) {
 		Block_CalcStretch((BlockID)block);
-		for (neighbour = BLOCK_AIR; neighbour < BLOCK_COUNT; neighbour++) {
-			Block_CalcCulling((BlockID)block, (BlockID)neighbour);
+		cls = Block_FindClass((BlockID)block);
+
+		if (cls == -1) {
+			cls = cullClassesCount++;
+			cullClassBlocks[cls] = block;
 		}
+		Blocks.CullClass[block] = cls;
 	}
+
+	Block_ReserveClasses(cullClassesCount);
+	Block_CalcAllClassCulling();
 }
 
 /* Updates culling data just for this block */
 /* (e.g. whether block can be stretched, visibility with other blocks) */
 static void Block_UpdateCulling(BlockID block) {
-	int neighbour;
+	int i, cls = Blocks.CullClass[block];
 	Block_CalcStretch(block);
-	
-	for (neighbour = BLOCK_AIR; neighbour < BLOCK_COUNT; neighbour++) {
-		Block_CalcCulling(block, (BlockID)neighbour);
-		Block_CalcCulling((BlockID)neighbour, block);
+
+	/* Old culling class may still have other blocks in it, in which case one of those is used */
+	if (cullClassBlocks[cls] == block) {
+		cullClassBlocks[cls] = -1;
+
+		for (i = BLOCK_AIR; i < BLOCK_COUNT; i++) {
+			if (i == block || Blocks.CullClass[i] != cls) continue;
+			cullClassBlocks[cls] = i; break;
+		}
+	}
+
+	cls = Block_FindClass(block);
+	if (cls >= 0) { Blocks.CullClass[block] = cls; return; }
+
+	/* Reuse a culling class that is now unused */
+	for (cls = 0; cls < cullClassesCount; cls++) {
+		if (cullClassBlocks[cls] < 0) break;
+	}
+	if (cls == cullClassesCount) cullClassesCount++;
+
+	cullClassBlocks[cls]    = block;
+	Blocks.CullClass[block] = cls;
+
+	if (Block_ReserveClasses(cullClassesCount)) {
+		Block_CalcAllClassCulling();
+	} else {
+		Block_CalcClassCulling(cls);
 	}
 }
 
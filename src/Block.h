@@ -98,8 +98,13 @@ CC_VAR extern struct _BlockLists {
 	/* Whether this block is allowed to be deleted. */
 	cc_bool CanDelete[BLOCK_COUNT];
 
-	/* Bit flags of faces hidden of two neighbouring blocks. */
-	cc_uint8 Hidden[BLOCK_COUNT * BLOCK_COUNT];
+	/* Culling class of each block. Blocks in the same class hide, and are hidden by, */
+	/*  other blocks in exactly the same way. (e.g. all full opaque blocks) */
+	BlockID CullClass[BLOCK_COUNT];
+	/* Bit flags of faces hidden between two neighbouring culling classes. See Block_HiddenFaces. */
+	cc_uint8* Hidden;
+	/* Number of entries in each row of the Hidden table */
+	int CullStride;
 	/* Bit flags of which faces of this block can stretch with greedy meshing. */
 	cc_uint8 CanStretch[BLOCK_COUNT];
 	/* Gravity of particles spawned when this block is broken */
@@ -143,8 +148,10 @@ void Block_SetSide(TextureLoc texLoc, BlockID blockId);
 /* The texture for the given face of the given block */
 #define Block_Tex(block, face) Blocks.Textures[(block) * FACE_COUNT + (face)]
 
+/* Bit flags of faces of a block in culling class 'cls' that are hidden by a neighbouring block in class 'other' */
+#define Block_HiddenFaces(cls, other) Blocks.Hidden[(cls) * Blocks.CullStride + (other)]
 /* Whether the given face of this block is occluded/hidden */
-#define Block_IsFaceHidden(block, other, face) (Blocks.Hidden[((block) * BLOCK_COUNT) + (other)] & (1 << (face)))
+#define Block_IsFaceHidden(block, other, face) (Block_HiddenFaces(Blocks.CullClass[block], Blocks.CullClass[other]) & (1 << (face)))
 
 /* Whether blocks can be automatically rotated */
 extern cc_bool AutoRotate_Enabled;
@@ -163,10 +163,14 @@ void Physics_OnBlockChanged(int x, int y, int z, BlockID old, BlockID now) {
 }
 
 static void Physics_TickRandomBlocks(void) {
+	struct ChunkSummary* summary;
 	int lo, hi, index;
+	cc_bool empty;
 	BlockID block;
 	PhysicsHandler tick;
 	int x, y, z, x2, y2, z2;
+	/* Chunks that are only air can only do anything when ticked if air has a handler */
+	cc_bool skipAir = !Physics.OnRandomTick[BLOCK_AIR];
 
 	for (y = 0; y < World.Height; y += CHUNK_SIZE) {
 		y2 = min(y + CHUNK_MAX, World.MaxY);
@@ -175,24 +179,36 @@ static void Physics_TickRandomBlocks(void) {
 			for (x = 0; x < World.Width; x += CHUNK_SIZE) {
 				x2 = min(x + CHUNK_MAX, World.MaxX);
 
+				/* Most chunks above the ground are only sky, so avoid reading their blocks */
+				summary = &World.Summaries[World_ChunkPack(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT)];
+				empty   = skipAir && !summary->NonAir;
+
 				/* Inlined 3 random ticks for this chunk */
+				/* NOTE: Random positions are still generated for empty chunks, so that the */
+				/*  sequence of random numbers is the same as when no chunks are skipped */
 				lo = World_Pack( x,  y,  z);
 				hi = World_Pack(x2, y2, z2);
 				
 				index = Random_Range(&physics_rnd, lo, hi);
-				block = World.Blocks[index];
-				tick = Physics.OnRandomTick[block];
-				if (tick) tick(index, block);
+				if (!empty) {
+					block = World.Blocks[index];
+					tick = Physics.OnRandomTick[block];
+					if (tick) tick(index, block);
+				}
 
 				index = Random_Range(&physics_rnd, lo, hi);
-				block = World.Blocks[index];
-				tick = Physics.OnRandomTick[block];
-				if (tick) tick(index, block);
+				if (!empty) {
+					block = World.Blocks[index];
+					tick = Physics.OnRandomTick[block];
+					if (tick) tick(index, block);
+				}
 
 				index = Random_Range(&physics_rnd, lo, hi);
-				block = World.Blocks[index];
-				tick = Physics.OnRandomTick[block];
-				if (tick) tick(index, block);
+				if (!empty) {
+					block = World.Blocks[index];
+					tick = Physics.OnRandomTick[block];
+					if (tick) tick(index, block);
+				}
 			}
 		}
 	}
@@ -13,21 +13,36 @@
 #include "TexturePack.h"
 #include "Game.h"
 #include "Options.h"
+#include "Event.h"
+#include "Utils.h"
 
 int Builder_SidesLevel, Builder_EdgeLevel;
+int Builder_ChunksBuilt;
+cc_uint64 Builder_BuildTime, Builder_LightTime;
+cc_bool Builder_PackedVertices;
 /* Packs an index into the 16x16x16 count array. Coordinates range from 0 to 15. */
 #define Builder_PackCount(xx, yy, zz) ((((yy) << 8) | ((zz) << 4) | (xx)) * FACE_COUNT)
 /* Packs an index into the 18x18x18 chunk array. Coordinates range from -1 to 16. */
 #define Builder_PackChunk(xx, yy, zz) (((yy) + 1) * EXTCHUNK_SIZE_2 + ((zz) + 1) * EXTCHUNK_SIZE + ((xx) + 1))
 
-static BlockID* Builder_Chunk;
-static cc_uint8* Builder_Counts;
-static int* Builder_BitFlags;
-static int Builder_X, Builder_Y, Builder_Z;
-static BlockID Builder_Block;
-static int Builder_ChunkIndex;
-static cc_bool Builder_FullBright;
-static int Builder_ChunkEndX, Builder_ChunkEndZ;
+/* State used while building a chunk mesh */
+/* NOTE: Chunk meshes may be built on multiple threads at once, so each thread needs its own copy */
+#ifdef CC_BUILD_THREADEDBUILDER
+	#define BUILDER_STATE static CC_THREADLOCAL
+#else
+	#define BUILDER_STATE static
+#endif
+
+BUILDER_STATE BlockID* Builder_Chunk;
+/* Culling class of each block in Builder_Chunk */
+BUILDER_STATE BlockID* Builder_Classes;
+BUILDER_STATE cc_uint8* Builder_Counts;
+BUILDER_STATE int* Builder_BitFlags;
+BUILDER_STATE int Builder_X, Builder_Y, Builder_Z;
+BUILDER_STATE BlockID Builder_Block;
+BUILDER_STATE int Builder_ChunkIndex;
+BUILDER_STATE cc_bool Builder_FullBright;
+BUILDER_STATE int Builder_ChunkEndX, Builder_ChunkEndZ;
 static int Builder_Offsets[FACE_COUNT] = { -1,1, -EXTCHUNK_SIZE,EXTCHUNK_SIZE, -EXTCHUNK_SIZE_2,EXTCHUNK_SIZE_2 };
 
 static int (*Builder_StretchXLiquid)(int countIndex, int x, int y, int z, int chunkIndex, BlockID block);
@@ -49,8 +64,8 @@ struct Builder1DPart {
 
 /* Part builder data, for both normal and translucent parts.
 The first ATLAS1D_MAX_ATLASES parts are for normal parts, remainder are for translucent parts. */
-static CC_BIG_VAR struct Builder1DPart Builder_Parts[ATLAS1D_MAX_ATLASES * 2];
-static struct VertexTextured* Builder_Vertices;
+BUILDER_STATE CC_BIG_VAR struct Builder1DPart Builder_Parts[ATLAS1D_MAX_ATLASES * 2];
+BUILDER_STATE struct VertexTextured* Builder_Vertices;
 
 static int Builder1DPart_VerticesCount(struct Builder1DPart* part) {
 	int i, count = part->sCount;
@@ -151,31 +166,68 @@ static void PrepareChunk(int x1, int y1, int z1) {
 	int yMax = min(World.Height, y1 + CHUNK_SIZE);
 	int zMax = min(World.Length, z1 + CHUNK_SIZE);
 
-	int cIndex, index, tileIdx;
+	/* Bit (xx + 1) of a row is set when the block at (xx, yy, zz) is fully opaque / not air */
+	cc_uint32 opaqueRows[EXTCHUNK_SIZE_2];
+	cc_uint16 drawnRows[CHUNK_SIZE_2];
+	cc_uint32 opaque, drawn, enclosed, visible;
+	int cIndex, index, tileIdx, row;
 	BlockID b;
 	int x, y, z, xx, yy, zz;
 
-#ifdef OCCLUSION
-	int flags = ComputeOcclusion();
-#endif
-#ifdef DEBUG_OCCLUSION
-	FastColour col = new FastColour(60, 60, 60, 255);
-	if (flags & 1) col.R = 255; /* x */
-	if (flags & 4) col.G = 255; /* y */
-	if (flags & 2) col.B = 255; /* z */
-	map.Sunlight = map.Shadowlight = col;
-	map.SunlightXSide = map.ShadowlightXSide = col;
-	map.SunlightZSide = map.ShadowlightZSide = col;
-	map.SunlightYBottom = map.ShadowlightYBottom = col;
-#endif
+	/* Resolve culling classes once, so hidden faces are looked up in the small class table */
+	for (row = 0, cIndex = 0; row < EXTCHUNK_SIZE_2; row++) {
+		opaque = 0; drawn = 0;
+
+		for (xx = 0; xx < EXTCHUNK_SIZE; xx++, cIndex++) {
+			b = Builder_Chunk[cIndex];
+			Builder_Classes[cIndex] = Blocks.CullClass[b];
+			opaque |= (cc_uint32)Blocks.FullOpaque[b]         << xx;
+			drawn  |= (cc_uint32)(Blocks.Draw[b] != DRAW_GAS) << xx;
+		}
+		opaqueRows[row] = opaque;
+
+		yy = row / EXTCHUNK_SIZE - 1; zz = row % EXTCHUNK_SIZE - 1;
+		if (yy >= 0 && yy < CHUNK_SIZE && zz >= 0 && zz < CHUNK_SIZE) {
+			drawnRows[(yy << CHUNK_SHIFT) | zz] = (cc_uint16)(drawn >> 1);
+		}
+	}
 	
 	for (y = y1, yy = 0; y < yMax; y++, yy++) {
 		for (z = z1, zz = 0; z < zMax; z++, zz++) {
-			cIndex = Builder_PackChunk(0, yy, zz);
+			/* A fully opaque block with fully opaque neighbours on all six sides has no visible faces */
+			/* Faces on the world sides are never culled against neighbours though, see below */
+			row    = (yy + 1) * EXTCHUNK_SIZE + (zz + 1);
+			opaque = opaqueRows[row];
+
+			if (z == 0 || z == World.MaxZ) {
+				enclosed = 0;
+			} else {
+				enclosed = opaque & (opaque << 1) & (opaque >> 1)
+					& opaqueRows[row - 1] & opaqueRows[row + 1]
+					& opaqueRows[row - EXTCHUNK_SIZE] & opaqueRows[row + EXTCHUNK_SIZE];
+				enclosed >>= 1;
+
+				if (x1 == 0) enclosed &= ~1u;
+				if (World.MaxX - x1 < CHUNK_SIZE) enclosed &= ~(1u << (World.MaxX - x1));
+				enclosed &= 0xFFFF;
+			}
+
+			visible = drawnRows[(yy << CHUNK_SHIFT) | zz] & ~enclosed;
+			index   = Builder_PackCount(0, yy, zz);
 
+			if (enclosed == 0xFFFF) {
+				Mem_Set(&Builder_Counts[index], 0, CHUNK_SIZE * FACE_COUNT);
+			} else {
+				for (xx = 0; enclosed; xx++, enclosed >>= 1) {
+					if (enclosed & 1) Mem_Set(&Builder_Counts[index + xx * FACE_COUNT], 0, FACE_COUNT);
+				}
+			}
+			if (!visible) continue;
+
+			cIndex = Builder_PackChunk(0, yy, zz);
 			for (x = x1, xx = 0; x < xMax; x++, xx++, cIndex++) {
+				if (!(visible & (1u << xx))) continue;
 				b = Builder_Chunk[cIndex];
-				if (Blocks.Draw[b] == DRAW_GAS) continue;
 				index = Builder_PackCount(xx, yy, zz);
 
 				/* Sprites can't be stretched, nor can then be they hidden by other blocks. */
@@ -184,12 +236,12 @@ static void PrepareChunk(int x1, int y1, int z1) {
 
 				Builder_X = x; Builder_Y = y; Builder_Z = z;
 				Builder_FullBright = Blocks.Brightness[b];
-				tileIdx = b * BLOCK_COUNT;
+				tileIdx = Builder_Classes[cIndex] * Blocks.CullStride;
 				/* All of these function calls are inlined as they can be called tens of millions to hundreds of millions of times. */
 
 				if (Builder_Counts[index] == 0 ||
 					(x == 0 && (y < Builder_SidesLevel || (b >= BLOCK_WATER && b <= BLOCK_STILL_LAVA && y < Builder_EdgeLevel))) ||
-					(x != 0 && (Blocks.Hidden[tileIdx + Builder_Chunk[cIndex - 1]] & FACE_BIT_XMIN) != 0)) {
+					(x != 0 && (Blocks.Hidden[tileIdx + Builder_Classes[cIndex - 1]] & FACE_BIT_XMIN) != 0)) {
 					Builder_Counts[index] = 0;
 				} else {
 					Builder_Counts[index] = Builder_StretchZ(index, x, y, z, cIndex, b, FACE_XMIN);
@@ -198,7 +250,7 @@ static void PrepareChunk(int x1, int y1, int z1) {
 				index++;
 				if (Builder_Counts[index] == 0 ||
 					(x == World.MaxX && (y < Builder_SidesLevel || (b >= BLOCK_WATER && b <= BLOCK_STILL_LAVA && y < Builder_EdgeLevel))) ||
-					(x != World.MaxX && (Blocks.Hidden[tileIdx + Builder_Chunk[cIndex + 1]] & FACE_BIT_XMAX) != 0)) {
+					(x != World.MaxX && (Blocks.Hidden[tileIdx + Builder_Classes[cIndex + 1]] & FACE_BIT_XMAX) != 0)) {
 					Builder_Counts[index] = 0;
 				} else {
 					Builder_Counts[index] = Builder_StretchZ(index, x, y, z, cIndex, b, FACE_XMAX);
@@ -207,7 +259,7 @@ static void PrepareChunk(int x1, int y1, int z1) {
 				index++;
 				if (Builder_Counts[index] == 0 ||
 					(z == 0 && (y < Builder_SidesLevel || (b >= BLOCK_WATER && b <= BLOCK_STILL_LAVA && y < Builder_EdgeLevel))) ||
-					(z != 0 && (Blocks.Hidden[tileIdx + Builder_Chunk[cIndex - EXTCHUNK_SIZE]] & FACE_BIT_ZMIN) != 0)) {
+					(z != 0 && (Blocks.Hidden[tileIdx + Builder_Classes[cIndex - EXTCHUNK_SIZE]] & FACE_BIT_ZMIN) != 0)) {
 					Builder_Counts[index] = 0;
 				} else {
 					Builder_Counts[index] = Builder_StretchX(index, x, y, z, cIndex, b, FACE_ZMIN);
@@ -216,7 +268,7 @@ static void PrepareChunk(int x1, int y1, int z1) {
 				index++;
 				if (Builder_Counts[index] == 0 ||
 					(z == World.MaxZ && (y < Builder_SidesLevel || (b >= BLOCK_WATER && b <= BLOCK_STILL_LAVA && y < Builder_EdgeLevel))) ||
-					(z != World.MaxZ && (Blocks.Hidden[tileIdx + Builder_Chunk[cIndex + EXTCHUNK_SIZE]] & FACE_BIT_ZMAX) != 0)) {
+					(z != World.MaxZ && (Blocks.Hidden[tileIdx + Builder_Classes[cIndex + EXTCHUNK_SIZE]] & FACE_BIT_ZMAX) != 0)) {
 					Builder_Counts[index] = 0;
 				} else {
 					Builder_Counts[index] = Builder_StretchX(index, x, y, z, cIndex, b, FACE_ZMAX);
@@ -224,7 +276,7 @@ static void PrepareChunk(int x1, int y1, int z1) {
 
 				index++;
 				if (Builder_Counts[index] == 0 || y == 0 ||
-					(Blocks.Hidden[tileIdx + Builder_Chunk[cIndex - EXTCHUNK_SIZE_2]] & FACE_BIT_YMIN) != 0) {
+					(Blocks.Hidden[tileIdx + Builder_Classes[cIndex - EXTCHUNK_SIZE_2]] & FACE_BIT_YMIN) != 0) {
 					Builder_Counts[index] = 0;
 				} else {
 					Builder_Counts[index] = Builder_StretchX(index, x, y, z, cIndex, b, FACE_YMIN);
@@ -232,7 +284,7 @@ static void PrepareChunk(int x1, int y1, int z1) {
 
 				index++;
 				if (Builder_Counts[index] == 0 ||
-					(Blocks.Hidden[tileIdx + Builder_Chunk[cIndex + EXTCHUNK_SIZE_2]] & FACE_BIT_YMAX) != 0) {
+					(Blocks.Hidden[tileIdx + Builder_Classes[cIndex + EXTCHUNK_SIZE_2]] & FACE_BIT_YMAX) != 0) {
 					Builder_Counts[index] = 0;
 				} else if (b < BLOCK_WATER || b > BLOCK_STILL_LAVA) {
 					Builder_Counts[index] = Builder_StretchX(index, x, y, z, cIndex, b, FACE_YMAX);
@@ -359,31 +411,115 @@ static void OutputChunkPartsMeta(int x, int y, int z, struct ChunkInfo* info) {
 	}
 }
 
-void Builder_MakeChunk(struct ChunkInfo* info) {
 #if CC_BUILD_MAXSTACK <= (32 * 1024)
-	BlockID* chunk   = (cc_uint8*)temp_mem;
-	cc_uint8* counts = (cc_uint8*)temp_mem + EXTCHUNK_SIZE_3;
+static cc_uint32 CalcConnectivity(int x1, int y1, int z1) { return CHUNK_ALL_CONNECTED; }
 #else
-	BlockID chunk[EXTCHUNK_SIZE_3]; 
-	cc_uint8 counts[CHUNK_SIZE_3 * FACE_COUNT]; 
-#endif
+/* Packs an index into the 16x16x16 visited array. Coordinates range from 0 to 15. */
+#define Builder_PackCell(xx, yy, zz) (((yy) << 8) | ((zz) << 4) | (xx))
+
+/* Works out which faces of the chunk are connected to each other through non-opaque blocks */
+/* (i.e. whether it is possible to see from one face of the chunk through to another face) */
+static cc_uint32 CalcConnectivity(int x1, int y1, int z1) {
+	cc_uint8  visited[CHUNK_SIZE_3];
+	cc_uint16 stack[CHUNK_SIZE_3];
+	cc_uint32 connectivity = 0;
+	int xMax = min(World.Width  - x1, CHUNK_SIZE);
+	int yMax = min(World.Height - y1, CHUNK_SIZE);
+	int zMax = min(World.Length - z1, CHUNK_SIZE);
+	int x, y, z, xx, yy, zz;
+	int i, j, faces, count;
 
-#ifdef CC_BUILD_ADVLIGHTING
-	int bitFlags[EXTCHUNK_SIZE_3];
-#else
-	int bitFlags[1];
+	for (yy = 0; yy < CHUNK_SIZE; yy++) {
+		for (zz = 0; zz < CHUNK_SIZE; zz++) {
+			for (xx = 0; xx < CHUNK_SIZE; xx++) {
+				visited[Builder_PackCell(xx, yy, zz)] = Blocks.FullOpaque[Builder_Chunk[Builder_PackChunk(xx, yy, zz)]];
+			}
+		}
+	}
+
+	for (yy = 0; yy < yMax; yy++) {
+		for (zz = 0; zz < zMax; zz++) {
+			for (xx = 0; xx < xMax; xx++) {
+				i = Builder_PackCell(xx, yy, zz);
+				if (visited[i]) continue;
+
+				/* Flood fill the non-opaque blocks connected to this block */
+				visited[i] = true;
+				stack[0]   = i;
+				count      = 1;
+				faces      = 0;
+
+				while (count) {
+					i = stack[--count];
+					x = i & 0x0F; z = (i >> 4) & 0x0F; y = i >> 8;
+
+					if (x == 0) faces |= FACE_BIT_XMIN;
+					if (z == 0) faces |= FACE_BIT_ZMIN;
+					if (y == 0) faces |= FACE_BIT_YMIN;
+					if (x == CHUNK_MAX) faces |= FACE_BIT_XMAX;
+					if (z == CHUNK_MAX) faces |= FACE_BIT_ZMAX;
+					if (y == CHUNK_MAX) faces |= FACE_BIT_YMAX;
+
+					if (x > 0        && !visited[i - 1])    { visited[i - 1]    = true; stack[count++] = i - 1; }
+					if (x < xMax - 1 && !visited[i + 1])    { visited[i + 1]    = true; stack[count++] = i + 1; }
+					if (z > 0        && !visited[i - 16])   { visited[i - 16]   = true; stack[count++] = i - 16; }
+					if (z < zMax - 1 && !visited[i + 16])   { visited[i + 16]   = true; stack[count++] = i + 16; }
+					if (y > 0        && !visited[i - 256])  { visited[i - 256]  = true; stack[count++] = i - 256; }
+					if (y < yMax - 1 && !visited[i + 256])  { visited[i + 256]  = true; stack[count++] = i + 256; }
+				}
+
+				for (i = 0; i < FACE_COUNT; i++) {
+					if (!(faces & (1 << i))) continue;
+
+					for (j = i + 1; j < FACE_COUNT; j++) {
+						if (faces & (1 << j)) connectivity |= CHUNK_FACES_BIT(i, j);
+					}
+				}
+			}
+		}
+	}
+	return connectivity;
+}
 #endif
 
+/* Uses the summaries of the given chunk and its 26 neighbours to work out whether */
+/*  all the blocks around the chunk are air, or are all fully opaque, without reading them */
+static void Builder_CheckSummaries(int cx, int cy, int cz, cc_bool* allAir, cc_bool* allSolid) {
+	struct ChunkSummary* s;
+	int x, y, z;
+	*allAir = true; *allSolid = true;
+
+	for (y = cy - 1; y <= cy + 1; y++) {
+		for (z = cz - 1; z <= cz + 1; z++) {
+			for (x = cx - 1; x <= cx + 1; x++) {
+				/* Outside the world is treated as air */
+				if (x < 0 || y < 0 || z < 0 || x >= World.ChunksX || y >= World.ChunksY || z >= World.ChunksZ) {
+					*allSolid = false;
+				} else {
+					s = &World.Summaries[World_ChunkPack(x, y, z)];
+					*allAir   = *allAir   && !s->NonAir;
+					*allSolid = *allSolid && s->Uniform && Blocks.FullOpaque[s->Block];
+				}
+				if (!(*allAir) && !(*allSolid)) return;
+			}
+		}
+	}
+}
+
+/* Reads the blocks of the given chunk (and its neighbouring blocks) into Builder_Chunk */
+/* Returns false if the chunk mesh doesn't need to be built (e.g. all blocks in it are air) */
+static cc_bool Builder_ReadChunk(struct ChunkInfo* info) {
 	cc_bool allAir, allSolid, onBorder;
-	int xMax, yMax, zMax, totalVerts;
-	int cIndex, index;
-	int x, y, z, xx, yy, zz;
+	cc_uint64 beg;
 	int x1 = info->centreX - 8, y1 = info->centreY - 8, z1 = info->centreZ - 8;
 
-	Builder_Chunk  = chunk;
-	Builder_Counts = counts;
-	Builder_BitFlags = bitFlags;
-	Builder_PrePrepareChunk();
+	/* Tall maps are mostly empty sky, so avoid copying blocks when possible */
+	Builder_CheckSummaries(x1 >> CHUNK_SHIFT, y1 >> CHUNK_SHIFT, z1 >> CHUNK_SHIFT, &allAir, &allSolid);
+	if (allAir || allSolid) {
+		info->allAir       = allAir;
+		info->connectivity = allAir ? CHUNK_ALL_CONNECTED : 0;
+		return false;
+	}
 	
 	onBorder = 
 		x1 == 0 || y1 == 0 || z1 == 0   || x1 + CHUNK_SIZE >= World.Width ||
@@ -391,43 +527,54 @@ void Builder_MakeChunk(struct ChunkInfo* info) {
 
 	if (onBorder) {
 		/* less optimal case here */
-		Mem_Set(chunk, BLOCK_AIR, EXTCHUNK_SIZE_3 * sizeof(BlockID));
+		Mem_Set(Builder_Chunk, BLOCK_AIR, EXTCHUNK_SIZE_3 * sizeof(BlockID));
 		allSolid = ReadBorderChunkData(x1, y1, z1, &allAir);
 	} else {
 		allSolid = ReadChunkData(x1, y1, z1, &allAir);
 	}
 
 	info->allAir = allAir;
-	if (allAir || allSolid) return;
+	if (allAir)   info->connectivity = CHUNK_ALL_CONNECTED;
+	if (allSolid) info->connectivity = 0;
+
+	if (allAir || allSolid) return false;
+
+	beg = Stopwatch_Measure();
 	Lighting.LightHint(x1 - 1, y1 - 1, z1 - 1);
+	Builder_LightTime += Stopwatch_ElapsedMicroseconds(beg, Stopwatch_Measure());
+	return true;
+}
 
-	Mem_Set(counts, 1, CHUNK_SIZE_3 * FACE_COUNT);
-	xMax = min(World.Width,  x1 + CHUNK_SIZE);
-	yMax = min(World.Height, y1 + CHUNK_SIZE);
-	zMax = min(World.Length, z1 + CHUNK_SIZE);
+/* Calculates the visible faces of the blocks in the chunk, and outputs the mesh parts metadata */
+/* Returns the total number of vertices in the chunk mesh */
+static int Builder_CountVertices(struct ChunkInfo* info) {
+	int totalVerts;
+	int x1 = info->centreX - 8, y1 = info->centreY - 8, z1 = info->centreZ - 8;
+	info->connectivity = CalcConnectivity(x1, y1, z1);
+	Builder_PrePrepareChunk();
 
-	Builder_ChunkEndX = xMax; Builder_ChunkEndZ = zMax;
+	Mem_Set(Builder_Counts, 1, CHUNK_SIZE_3 * FACE_COUNT);
+	Builder_ChunkEndX = min(World.Width,  x1 + CHUNK_SIZE);
+	Builder_ChunkEndZ = min(World.Length, z1 + CHUNK_SIZE);
 	PrepareChunk(x1, y1, z1);
 
 	totalVerts = Builder_TotalVerticesCount();
-	if (!totalVerts) return;
+	if (!totalVerts) return 0;
 	
 	OutputChunkPartsMeta(x1, y1, z1, info);
-#ifdef OCCLUSION
-	if (info.NormalParts != null || info.TranslucentParts != null)
-		info.occlusionFlags = (cc_uint8)ComputeOcclusion();
-#endif
+	return totalVerts;
+}
 
-#ifndef CC_BUILD_GL11
-	/* add an extra element to fix crashing on some GPUs */
-	info->vb = Gfx_CreateVb(VERTEX_FORMAT_TEXTURED, totalVerts + 1);
-	Builder_Vertices = (struct VertexTextured*)Gfx_LockVb(info->vb,
-													VERTEX_FORMAT_TEXTURED, totalVerts + 1);
-#else
-	/* NOTE: Relies on assumption vb is ignored by GL11 Gfx_LockVb implementation */
-	Builder_Vertices = (struct VertexTextured*)Gfx_LockVb(0, 
-													VERTEX_FORMAT_TEXTURED, totalVerts + 1);
-#endif
+/* Writes the vertices of the chunk mesh into Builder_Vertices */
+static void Builder_RenderChunk(struct ChunkInfo* info) {
+	int xMax, yMax, zMax;
+	int cIndex, index;
+	int x, y, z, xx, yy, zz;
+	int x1 = info->centreX - 8, y1 = info->centreY - 8, z1 = info->centreZ - 8;
+
+	xMax = min(World.Width,  x1 + CHUNK_SIZE);
+	yMax = min(World.Height, y1 + CHUNK_SIZE);
+	zMax = min(World.Length, z1 + CHUNK_SIZE);
 	Builder_PostPrepareChunk();
 	/* now render the chunk */
 
@@ -436,7 +583,7 @@ void Builder_MakeChunk(struct ChunkInfo* info) {
 			cIndex = Builder_PackChunk(0, yy, zz);
 
 			for (x = x1, xx = 0; x < xMax; x++, xx++, cIndex++) {
-				Builder_Block = chunk[cIndex];
+				Builder_Block = Builder_Chunk[cIndex];
 				if (Blocks.Draw[Builder_Block] == DRAW_GAS) continue;
 
 				index = Builder_PackCount(xx, yy, zz);
@@ -445,9 +592,144 @@ void Builder_MakeChunk(struct ChunkInfo* info) {
 			}
 		}
 	}
+}
+
+#ifndef CC_BUILD_GL11
+/* Allocates the vertex buffer of a chunk mesh, then acquires memory for writing its vertices into */
+static void* Builder_LockChunkVb(struct ChunkInfo* info, VertexFormat fmt, int count) {
+#ifdef CC_BUILD_VBARENA
+	info->vbSlot = Gfx_AllocArenaVb(fmt, count, info);
+	if (info->vbSlot) {
+		info->vb = Gfx_GetArenaVb(info->vbSlot, &info->vbOffset);
+		return Gfx_LockArenaVb(info->vbSlot, count);
+	}
+#endif
+	info->vbOffset = 0;
+	info->vb       = Gfx_CreateVb(fmt, count);
+	return Gfx_LockVb(info->vb, fmt, count);
+}
+
+static void Builder_UnlockChunkVb(struct ChunkInfo* info) {
+#ifdef CC_BUILD_VBARENA
+	if (info->vbSlot) { Gfx_UnlockArenaVb(info->vbSlot); return; }
+#endif
+	Gfx_UnlockVb(info->vb);
+}
+#endif
+
+#ifdef CC_BUILD_PACKEDVERTICES
+/* Converts the vertices of a chunk mesh into VERTEX_FORMAT_PACKED, relative to the chunk's origin */
+/* NOTE: dst may be the same as src, as each vertex is read before it is written */
+static void Builder_PackVertices(void* dst, const struct VertexTextured* src, int count, int x1, int y1, int z1) {
+	struct VertexPacked* d = (struct VertexPacked*)dst;
+	struct VertexTextured v;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		v = src[i];
+		d[i].x   = (cc_int16)Math_Floor((v.x - x1) * VERTEX_PACKED_POS_SCALE + 0.5f);
+		d[i].y   = (cc_int16)Math_Floor((v.y - y1) * VERTEX_PACKED_POS_SCALE + 0.5f);
+		d[i].z   = (cc_int16)Math_Floor((v.z - z1) * VERTEX_PACKED_POS_SCALE + 0.5f);
+		d[i].U   = (cc_int16)Math_Floor(v.U * VERTEX_PACKED_U_SCALE + 0.5f);
+		d[i].Col = v.Col;
+		d[i].V   = v.V;
+	}
+}
+
+/* Vertices are rendered into this first, then packed into the chunk's VB */
+static struct VertexTextured* packScratch;
+static int packScratchCapacity;
+
+static cc_bool MakePackedChunk(struct ChunkInfo* info, int totalVerts) {
+	struct VertexTextured* data;
+	void* dst;
+
+	if (totalVerts > packScratchCapacity) {
+		data = (struct VertexTextured*)Mem_TryRealloc(packScratch, totalVerts, sizeof(struct VertexTextured));
+		if (!data) return false;
+
+		packScratch         = data;
+		packScratchCapacity = totalVerts;
+	}
+
+	Builder_Vertices = packScratch;
+	Builder_RenderChunk(info);
+
+	/* add an extra element to fix crashing on some GPUs */
+	dst = Builder_LockChunkVb(info, VERTEX_FORMAT_PACKED, totalVerts + 1);
 
+	Builder_PackVertices(dst, packScratch, totalVerts,
+						info->centreX - 8, info->centreY - 8, info->centreZ - 8);
+	Mem_Set((struct VertexPacked*)dst + totalVerts, 0, SIZEOF_VERTEX_PACKED);
+	Builder_UnlockChunkVb(info);
+	return true;
+}
+
+static void FreePackScratch(void) {
+	Mem_Free(packScratch);
+	packScratch         = NULL;
+	packScratchCapacity = 0;
+}
+#else
+static void FreePackScratch(void) { }
+#endif
+
+static void MakeChunk(struct ChunkInfo* info) {
+#if CC_BUILD_MAXSTACK <= (32 * 1024)
+	BlockID* chunk   = (cc_uint8*)temp_mem;
+	BlockID* classes = (cc_uint8*)temp_mem + EXTCHUNK_SIZE_3;
+	cc_uint8* counts = (cc_uint8*)temp_mem + EXTCHUNK_SIZE_3 * 2;
+#else
+	BlockID chunk[EXTCHUNK_SIZE_3]; 
+	BlockID classes[EXTCHUNK_SIZE_3];
+	cc_uint8 counts[CHUNK_SIZE_3 * FACE_COUNT]; 
+#endif
+
+#ifdef CC_BUILD_ADVLIGHTING
+	int bitFlags[EXTCHUNK_SIZE_3];
+#else
+	int bitFlags[1];
+#endif
+	int totalVerts;
 #ifdef CC_BUILD_GL11
-	cIndex = World_ChunkPack(x1 >> CHUNK_SHIFT, y1 >> CHUNK_SHIFT, z1 >> CHUNK_SHIFT);
+	int cIndex, index;
+#endif
+
+	Builder_Chunk  = chunk;
+	Builder_Counts = counts;
+	Builder_Classes  = classes;
+	Builder_BitFlags = bitFlags;
+
+	if (!Builder_ReadChunk(info)) return;
+	/* Chunks skipped without meshing (e.g. all air) don't count as built */
+	Builder_ChunksBuilt++;
+	totalVerts = Builder_CountVertices(info);
+	if (!totalVerts) return;
+
+#ifdef CC_BUILD_PACKEDVERTICES
+	if (Builder_PackedVertices) {
+		if (MakePackedChunk(info, totalVerts)) return;
+
+		/* Out of memory, so just leave this chunk empty */
+		info->normalParts      = NULL;
+		info->translucentParts = NULL;
+		return;
+	}
+#endif
+
+#ifndef CC_BUILD_GL11
+	/* add an extra element to fix crashing on some GPUs */
+	Builder_Vertices = (struct VertexTextured*)Builder_LockChunkVb(info,
+													VERTEX_FORMAT_TEXTURED, totalVerts + 1);
+#else
+	/* NOTE: Relies on assumption vb is ignored by GL11 Gfx_LockVb implementation */
+	Builder_Vertices = (struct VertexTextured*)Gfx_LockVb(0, 
+													VERTEX_FORMAT_TEXTURED, totalVerts + 1);
+#endif
+	Builder_RenderChunk(info);
+
+#ifdef CC_BUILD_GL11
+	cIndex = World_ChunkPack(info->centreX >> CHUNK_SHIFT, info->centreY >> CHUNK_SHIFT, info->centreZ >> CHUNK_SHIFT);
 
 	for (index = 0; index < MapRenderer_1DUsedCount; index++) {
 		int curIdx = cIndex + index * World.ChunksCount;
@@ -456,10 +738,16 @@ void Builder_MakeChunk(struct ChunkInfo* info) {
 		BuildPartVbs(&MapRenderer_PartsTranslucent[curIdx]);
 	}
 #else
-	Gfx_UnlockVb(info->vb);
+	Builder_UnlockChunkVb(info);
 #endif
 }
 
+void Builder_MakeChunk(struct ChunkInfo* info) {
+	cc_uint64 beg = Stopwatch_Measure();
+	MakeChunk(info);
+	Builder_BuildTime += Stopwatch_ElapsedMicroseconds(beg, Stopwatch_Measure());
+}
+
 static cc_bool Builder_OccludedLiquid(int chunkIndex) {
 	chunkIndex += EXTCHUNK_SIZE_2; /* Checking y above */
 	return
@@ -485,7 +773,7 @@ static void DefaultPostStretchChunk(void) {
 	}
 }
 
-static RNGState spriteRng;
+BUILDER_STATE RNGState spriteRng;
 static void Builder_DrawSprite(int x, int y, int z) {
 	struct Builder1DPart* part;
 	struct VertexTextured* v;
@@ -561,6 +849,8 @@ static void Builder_DrawSprite(int x, int y, int z) {
 /*########################################################################################################################*
 *--------------------------------------------------Normal mesh builder----------------------------------------------------*
 *#########################################################################################################################*/
+BUILDER_STATE struct _DrawerData normal_drawer;
+
 static PackedCol Normal_LightColor(int x, int y, int z, Face face, BlockID block) {
 	int offset = (Blocks.LightOffset[block] >> face) & 1;
 
@@ -681,15 +971,15 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 	baseOffset = (Blocks.Draw[Builder_Block] == DRAW_TRANSLUCENT) * ATLAS1D_MAX_ATLASES;
 	lightFlags = Blocks.LightOffset[Builder_Block];
 
-	Drawer.MinBB = Blocks.MinBB[Builder_Block]; Drawer.MinBB.y = 1.0f - Drawer.MinBB.y;
-	Drawer.MaxBB = Blocks.MaxBB[Builder_Block]; Drawer.MaxBB.y = 1.0f - Drawer.MaxBB.y;
+	normal_drawer.MinBB = Blocks.MinBB[Builder_Block]; normal_drawer.MinBB.y = 1.0f - normal_drawer.MinBB.y;
+	normal_drawer.MaxBB = Blocks.MaxBB[Builder_Block]; normal_drawer.MaxBB.y = 1.0f - normal_drawer.MaxBB.y;
 
 	min = Blocks.RenderMinBB[Builder_Block]; max = Blocks.RenderMaxBB[Builder_Block];
-	Drawer.X1 = x + min.x; Drawer.Y1 = y + min.y; Drawer.Z1 = z + min.z;
-	Drawer.X2 = x + max.x; Drawer.Y2 = y + max.y; Drawer.Z2 = z + max.z;
+	normal_drawer.X1 = x + min.x; normal_drawer.Y1 = y + min.y; normal_drawer.Z1 = z + min.z;
+	normal_drawer.X2 = x + max.x; normal_drawer.Y2 = y + max.y; normal_drawer.Z2 = z + max.z;
 
-	Drawer.Tinted  = Blocks.Tinted[Builder_Block];
-	Drawer.TintCol = Blocks.FogCol[Builder_Block];
+	normal_drawer.Tinted  = Blocks.Tinted[Builder_Block];
+	normal_drawer.TintCol = Blocks.FogCol[Builder_Block];
 
 	if (count_XMin) {
 		loc    = Block_Tex(Builder_Block, FACE_XMIN);
@@ -698,7 +988,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			x >= offset ? Lighting.Color_XSide_Fast(x - offset, y, z) : Env.SunXSide;
-		Drawer_XMin(count_XMin, col, loc, &part->faces.vertices[FACE_XMIN]);
+		Drawer_XMin2(&normal_drawer, count_XMin, col, loc, &part->faces.vertices[FACE_XMIN]);
 	}
 
 	if (count_XMax) {
@@ -708,7 +998,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			x <= (World.MaxX - offset) ? Lighting.Color_XSide_Fast(x + offset, y, z) : Env.SunXSide;
-		Drawer_XMax(count_XMax, col, loc, &part->faces.vertices[FACE_XMAX]);
+		Drawer_XMax2(&normal_drawer, count_XMax, col, loc, &part->faces.vertices[FACE_XMAX]);
 	}
 
 	if (count_ZMin) {
@@ -718,7 +1008,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			z >= offset ? Lighting.Color_ZSide_Fast(x, y, z - offset) : Env.SunZSide;
-		Drawer_ZMin(count_ZMin, col, loc, &part->faces.vertices[FACE_ZMIN]);
+		Drawer_ZMin2(&normal_drawer, count_ZMin, col, loc, &part->faces.vertices[FACE_ZMIN]);
 	}
 
 	if (count_ZMax) {
@@ -728,7 +1018,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			z <= (World.MaxZ - offset) ? Lighting.Color_ZSide_Fast(x, y, z + offset) : Env.SunZSide;
-		Drawer_ZMax(count_ZMax, col, loc, &part->faces.vertices[FACE_ZMAX]);
+		Drawer_ZMax2(&normal_drawer, count_ZMax, col, loc, &part->faces.vertices[FACE_ZMAX]);
 	}
 
 	if (count_YMin) {
@@ -737,7 +1027,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 		part   = &Builder_Parts[baseOffset + Atlas1D_Index(loc)];
 
 		col = fullBright ? PACKEDCOL_WHITE : Lighting.Color_YMin_Fast(x, y - offset, z);
-		Drawer_YMin(count_YMin, col, loc, &part->faces.vertices[FACE_YMIN]);
+		Drawer_YMin2(&normal_drawer, count_YMin, col, loc, &part->faces.vertices[FACE_YMIN]);
 	}
 
 	if (count_YMax) {
@@ -746,7 +1036,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 		part   = &Builder_Parts[baseOffset + Atlas1D_Index(loc)];
 
 		col = fullBright ? PACKEDCOL_WHITE : Lighting.Color_YMax_Fast(x, y + offset, z);
-		Drawer_YMax(count_YMax, col, loc, &part->faces.vertices[FACE_YMAX]);
+		Drawer_YMax2(&normal_drawer, count_YMax, col, loc, &part->faces.vertices[FACE_YMAX]);
 	}
 }
 
@@ -769,16 +1059,223 @@ static void NormalBuilder_SetActive(void) {
 }
 
 
+/*########################################################################################################################*
+*--------------------------------------------------Greedy mesh builder----------------------------------------------------*
+*#########################################################################################################################*/
+/* Extends the normal mesh builder, by also merging faces of full opaque blocks along the V texture axis */
+/*  (i.e. so faces are merged into rectangles instead of just rows) */
+/* NOTE: Textures only repeat along the U axis in 1D atlases, so faces can only be merged along the */
+/*  V axis when all rows of pixels in the texture are identical. (e.g. solid colour textures) */
+#define GREEDY_ROWS_SHIFT 5
+#define GREEDY_COUNT_MASK ((1 << GREEDY_ROWS_SHIFT) - 1)
+/* Max number of extra rows merged into a face. (limited by upper bits of Builder_Counts) */
+#define GREEDY_MAX_ROWS 7
+
+/* Whether all rows of pixels in each texture in the terrain atlas are identical */
+static cc_bool greedy_uniformV[ATLAS2D_TILES_PER_ROW * ATLAS2D_MAX_ROWS_COUNT];
+
+/* Offsets in chunk and counts arrays for moving along the U and V texture axes of each face */
+static const int greedy_uChunk[FACE_COUNT] = { EXTCHUNK_SIZE, EXTCHUNK_SIZE, 1, 1, 1, 1 };
+static const int greedy_uCount[FACE_COUNT] = {
+	CHUNK_SIZE * FACE_COUNT, CHUNK_SIZE * FACE_COUNT, FACE_COUNT, FACE_COUNT, FACE_COUNT, FACE_COUNT
+};
+static const int greedy_vChunk[FACE_COUNT] = {
+	EXTCHUNK_SIZE_2, EXTCHUNK_SIZE_2, EXTCHUNK_SIZE_2, EXTCHUNK_SIZE_2, EXTCHUNK_SIZE, EXTCHUNK_SIZE
+};
+static const int greedy_vCount[FACE_COUNT] = {
+	CHUNK_SIZE_2 * FACE_COUNT, CHUNK_SIZE_2 * FACE_COUNT, CHUNK_SIZE_2 * FACE_COUNT,
+	CHUNK_SIZE_2 * FACE_COUNT, CHUNK_SIZE   * FACE_COUNT, CHUNK_SIZE   * FACE_COUNT
+};
+
+static cc_bool Greedy_IsUniformV(TextureLoc loc) {
+	int i, size = Atlas2D.TileSize;
+	int x = Atlas2D_TileX(loc) * size, y = Atlas2D_TileY(loc) * size;
+	BitmapCol* row = Bitmap_GetRow(&Atlas2D.Bmp, y) + x;
+
+	for (i = 1; i < size; i++)
+	{
+		if (!Mem_Equal(row, Bitmap_GetRow(&Atlas2D.Bmp, y + i) + x, size * BITMAPCOLOR_SIZE)) return false;
+	}
+	return true;
+}
+
+static void Greedy_OnAtlasChanged(void* obj) {
+	int i, count = Atlas2D.RowsCount * ATLAS2D_TILES_PER_ROW;
+	Mem_Set(greedy_uniformV, 0, sizeof(greedy_uniformV));
+	if (!Atlas2D.Bmp.scan0) return;
+
+	for (i = 0; i < count; i++)
+	{
+		greedy_uniformV[i] = Greedy_IsUniformV(i);
+	}
+}
+
+/* Whether the given face of the given block would be drawn. (see PrepareChunk) */
+static cc_bool Greedy_IsFaceVisible(BlockID block, int chunkIndex, int x, int y, int z, Face face) {
+	cc_bool border = false;
+
+	switch (face) {
+	case FACE_XMIN: border = x == 0;           break;
+	case FACE_XMAX: border = x == World.MaxX;  break;
+	case FACE_ZMIN: border = z == 0;           break;
+	case FACE_ZMAX: border = z == World.MaxZ;  break;
+	case FACE_YMIN: if (y == 0) return false; break;
+	}
+
+	if (border) {
+		return !(y < Builder_SidesLevel || (block >= BLOCK_WATER && block <= BLOCK_STILL_LAVA && y < Builder_EdgeLevel));
+	}
+	return !Block_IsFaceHidden(block, Builder_Chunk[chunkIndex + Builder_Offsets[face]], face);
+}
+
+/* Whether the given row of faces can be merged into the face being stretched */
+static cc_bool Greedy_CanMergeRow(int countIndex, int x, int y, int z, int chunkIndex, BlockID block, Face face, int count, PackedCol col) {
+	int i, dx = face >= FACE_ZMIN, dz = face < FACE_ZMIN;
+
+	for (i = 0; i < count; i++)
+	{
+		/* Face might have already been merged into another face */
+		if (!Builder_Counts[countIndex] || Builder_Chunk[chunkIndex] != block) return false;
+		if (!Greedy_IsFaceVisible(block, chunkIndex, x, y, z, face))          return false;
+		if (!Builder_FullBright && Normal_LightColor(x, y, z, face, block) != col) return false;
+
+		x += dx; z += dz;
+		chunkIndex += greedy_uChunk[face];
+		countIndex += greedy_uCount[face];
+	}
+	return true;
+}
+
+static int Greedy_StretchV(int countIndex, int x, int y, int z, int chunkIndex, BlockID block, Face face, int count) {
+	int i, rows, maxRows, dy, dz;
+	TextureLoc loc;
+	PackedCol col;
+
+	loc = Block_Tex(block, face);
+	if (!Blocks.FullOpaque[block] || loc >= Array_Elems(greedy_uniformV) || !greedy_uniformV[loc]) return 0;
+
+	if (face >= FACE_YMIN) {
+		maxRows = Builder_ChunkEndZ - z - 1;
+		dy = 0; dz = 1;
+	} else {
+		maxRows = min(World.Height, (y & ~CHUNK_MASK) + CHUNK_SIZE) - y - 1;
+		dy = 1; dz = 0;
+	}
+	maxRows = min(maxRows, GREEDY_MAX_ROWS);
+	col     = Builder_FullBright ? PACKEDCOL_WHITE : Normal_LightColor(x, y, z, face, block);
+
+	for (rows = 0; rows < maxRows; rows++)
+	{
+		y += dy; z += dz;
+		chunkIndex += greedy_vChunk[face];
+		countIndex += greedy_vCount[face];
+		if (!Greedy_CanMergeRow(countIndex, x, y, z, chunkIndex, block, face, count, col)) break;
+
+		for (i = 0; i < count; i++)
+		{
+			Builder_Counts[countIndex + i * greedy_uCount[face]] = 0;
+		}
+	}
+	return rows;
+}
+
+static int Greedy_Stretch(int countIndex, int x, int y, int z, int chunkIndex, BlockID block, Face face) {
+	int count = 1, maxCount, rows;
+	int dx = face >= FACE_ZMIN, dz = face < FACE_ZMIN;
+	int cx = x + dx, cz = z + dz;
+	int cIndex = chunkIndex + greedy_uChunk[face];
+	int index  = countIndex + greedy_uCount[face];
+	cc_bool stretchTile = (Blocks.CanStretch[block] & (1 << face)) != 0;
+
+	maxCount = dz ? Builder_ChunkEndZ - z : Builder_ChunkEndX - x;
+	/* Unlike normal builder, must check for faces already merged into a face in a previous row */
+	while (count < maxCount && stretchTile && Builder_Counts[index] && Normal_CanStretch(block, cIndex, cx, y, cz, face)) {
+		Builder_Counts[index] = 0;
+		count++;
+		cx += dx; cz += dz;
+		cIndex += greedy_uChunk[face];
+		index  += greedy_uCount[face];
+	}
+	AddVertices(block, face);
+
+	rows = Greedy_StretchV(countIndex, x, y, z, chunkIndex, block, face, count);
+	return count | (rows << GREEDY_ROWS_SHIFT);
+}
+
+static void Greedy_DrawFace(int count, Face face, int x, int y, int z, int baseOffset, cc_bool fullBright) {
+	struct VertexTextured** vertices;
+	float y2 = normal_drawer.Y2, z2 = normal_drawer.Z2;
+	int rows = count >> GREEDY_ROWS_SHIFT;
+	TextureLoc loc;
+	PackedCol col;
+
+	count   &= GREEDY_COUNT_MASK;
+	loc      = Block_Tex(Builder_Block, face);
+	vertices = &Builder_Parts[baseOffset + Atlas1D_Index(loc)].faces.vertices[face];
+	col      = fullBright ? PACKEDCOL_WHITE : Normal_LightColor(x, y, z, face, Builder_Block);
+
+	/* Extend face along V axis to cover the merged rows */
+	if (face >= FACE_YMIN) { normal_drawer.Z2 += rows; } else { normal_drawer.Y2 += rows; }
+
+	switch (face) {
+	case FACE_XMIN: Drawer_XMin2(&normal_drawer, count, col, loc, vertices); break;
+	case FACE_XMAX: Drawer_XMax2(&normal_drawer, count, col, loc, vertices); break;
+	case FACE_ZMIN: Drawer_ZMin2(&normal_drawer, count, col, loc, vertices); break;
+	case FACE_ZMAX: Drawer_ZMax2(&normal_drawer, count, col, loc, vertices); break;
+	case FACE_YMIN: Drawer_YMin2(&normal_drawer, count, col, loc, vertices); break;
+	case FACE_YMAX: Drawer_YMax2(&normal_drawer, count, col, loc, vertices); break;
+	}
+	normal_drawer.Y2 = y2; normal_drawer.Z2 = z2;
+}
+
+static void Greedy_RenderBlock(int index, int x, int y, int z) {
+	int face, count, baseOffset;
+	cc_bool fullBright;
+	Vec3 min, max;
+
+	if (Blocks.Draw[Builder_Block] == DRAW_SPRITE) {
+		Builder_DrawSprite(x, y, z); return;
+	}
+
+	fullBright = Blocks.Brightness[Builder_Block];
+	baseOffset = (Blocks.Draw[Builder_Block] == DRAW_TRANSLUCENT) * ATLAS1D_MAX_ATLASES;
+
+	normal_drawer.MinBB = Blocks.MinBB[Builder_Block]; normal_drawer.MinBB.y = 1.0f - normal_drawer.MinBB.y;
+	normal_drawer.MaxBB = Blocks.MaxBB[Builder_Block]; normal_drawer.MaxBB.y = 1.0f - normal_drawer.MaxBB.y;
+
+	min = Blocks.RenderMinBB[Builder_Block]; max = Blocks.RenderMaxBB[Builder_Block];
+	normal_drawer.X1 = x + min.x; normal_drawer.Y1 = y + min.y; normal_drawer.Z1 = z + min.z;
+	normal_drawer.X2 = x + max.x; normal_drawer.Y2 = y + max.y; normal_drawer.Z2 = z + max.z;
+
+	normal_drawer.Tinted  = Blocks.Tinted[Builder_Block];
+	normal_drawer.TintCol = Blocks.FogCol[Builder_Block];
+
+	for (face = 0; face < FACE_COUNT; face++)
+	{
+		count = Builder_Counts[index + face];
+		if (count) Greedy_DrawFace(count, face, x, y, z, baseOffset, fullBright);
+	}
+}
+
+static void GreedyBuilder_SetActive(void) {
+	Builder_SetDefault();
+	Builder_StretchXLiquid = NormalBuilder_StretchXLiquid;
+	Builder_StretchX       = Greedy_Stretch;
+	Builder_StretchZ       = Greedy_Stretch;
+	Builder_RenderBlock    = Greedy_RenderBlock;
+}
+
+
 /*########################################################################################################################*
 *-------------------------------------------------Advanced mesh builder---------------------------------------------------*
 *#########################################################################################################################*/
 #ifdef CC_BUILD_ADVLIGHTING
-static Vec3 adv_minBB, adv_maxBB;
-static int adv_initBitFlags, adv_baseOffset;
-static int* adv_bitFlags;
-static float adv_x1, adv_y1, adv_z1, adv_x2, adv_y2, adv_z2;
-static PackedCol adv_lerp[5], adv_lerpX[5], adv_lerpZ[5], adv_lerpY[5];
-static cc_bool adv_tinted;
+BUILDER_STATE Vec3 adv_minBB, adv_maxBB;
+BUILDER_STATE int adv_initBitFlags, adv_baseOffset;
+BUILDER_STATE int* adv_bitFlags;
+BUILDER_STATE float adv_x1, adv_y1, adv_z1, adv_x2, adv_y2, adv_z2;
+BUILDER_STATE PackedCol adv_lerp[5], adv_lerpX[5], adv_lerpZ[5], adv_lerpY[5];
+BUILDER_STATE cc_bool adv_tinted;
 
 enum ADV_MASK {
 	/* z-1 cube points */
@@ -1623,10 +2120,183 @@ static void ModernBuilder_SetActive(void) {
 static void ModernBuilder_SetActive(void) { NormalBuilder_SetActive(); }
 #endif
 
+/*########################################################################################################################*
+*-------------------------------------------------Threaded mesh building--------------------------------------------------*
+*#########################################################################################################################*/
+int Builder_WorkerThreads;
+#ifdef CC_BUILD_THREADEDBUILDER
+#define BUILDER_MAX_THREADS WORKERPOOL_MAX_THREADS
+#define BUILDER_THREAD_STACK (256 * 1024)
+
+struct BuilderJob {
+	struct ChunkInfo* info;
+	/* Vertices of the chunk mesh, later copied into a vertex buffer on the main thread */
+	struct VertexTextured* vertices;
+	int verticesCount, verticesCapacity;
+	BlockID chunk[EXTCHUNK_SIZE_3];
+};
+
+static struct BuilderJob* jobs;
+static int jobsCount, jobsCapacity;
+
+static void WorkerMain(void);
+static struct WorkerPool builderPool = { WorkerMain, "Chunk builder", BUILDER_THREAD_STACK };
+static void WorkerMain(void) { WorkerPool_WorkerMain(&builderPool); }
+
+static void BuildJob(struct BuilderJob* job) {
+	cc_uint8 counts[CHUNK_SIZE_3 * FACE_COUNT];
+	BlockID classes[EXTCHUNK_SIZE_3];
+#ifdef CC_BUILD_ADVLIGHTING
+	int bitFlags[EXTCHUNK_SIZE_3];
+#else
+	int bitFlags[1];
+#endif
+	struct VertexTextured* data;
+	int count;
+
+	Builder_Chunk    = job->chunk;
+	Builder_Counts   = counts;
+	Builder_Classes  = classes;
+	Builder_BitFlags = bitFlags;
+
+	job->verticesCount = 0;
+	count = Builder_CountVertices(job->info);
+	if (!count) return;
+
+	/* add an extra element to fix crashing on some GPUs */
+	count++;
+	if (count > job->verticesCapacity) {
+		data = (struct VertexTextured*)Mem_TryRealloc(job->vertices, count, sizeof(struct VertexTextured));
+
+		/* Out of memory, so just leave this chunk empty */
+		if (!data) {
+			job->info->normalParts      = NULL;
+			job->info->translucentParts = NULL;
+			return;
+		}
+		job->vertices         = data;
+		job->verticesCapacity = count;
+	}
+
+	Builder_Vertices = job->vertices;
+	Builder_RenderChunk(job->info);
+	job->verticesCount = count;
+
+#ifdef CC_BUILD_PACKEDVERTICES
+	if (!Builder_PackedVertices) return;
+	/* Packed vertices are smaller, so it is safe to convert them in place */
+	Builder_PackVertices(job->vertices, job->vertices, count - 1,
+						job->info->centreX - 8, job->info->centreY - 8, job->info->centreZ - 8);
+	Mem_Set((struct VertexPacked*)job->vertices + (count - 1), 0, SIZEOF_VERTEX_PACKED);
+#endif
+}
+
+static void StopWorkers(void) { WorkerPool_Stop(&builderPool); }
+
+static void FreeJobs(void) {
+	int i;
+	for (i = 0; i < jobsCapacity; i++)
+	{
+		Mem_Free(jobs[i].vertices);
+	}
+
+	Mem_Free(jobs);
+	jobs         = NULL;
+	jobsCount    = 0;
+	jobsCapacity = 0;
+}
+
+static void UploadJob(struct BuilderJob* job) {
+	struct ChunkInfo* info = job->info;
+	VertexFormat fmt = VERTEX_FORMAT_TEXTURED;
+	int stride       = SIZEOF_VERTEX_TEXTURED;
+	void* data;
+
+#ifdef CC_BUILD_PACKEDVERTICES
+	if (Builder_PackedVertices) { fmt = VERTEX_FORMAT_PACKED; stride = SIZEOF_VERTEX_PACKED; }
+#endif
+	data = Builder_LockChunkVb(info, fmt, job->verticesCount);
+	Mem_Copy(data, job->vertices, job->verticesCount * stride);
+	Builder_UnlockChunkVb(info);
+}
+
+cc_bool Builder_QueueChunk(struct ChunkInfo* info) {
+	struct BuilderJob* job;
+	cc_uint64 beg;
+	cc_bool read;
+	if (!Builder_WorkerThreads) { Builder_MakeChunk(info); return false; }
+
+	if (jobsCount == jobsCapacity) {
+		jobs = (struct BuilderJob*)Mem_Realloc(jobs, jobsCapacity + 8, sizeof(struct BuilderJob), "builder jobs");
+		Mem_Set(&jobs[jobsCapacity], 0, 8 * sizeof(struct BuilderJob));
+		jobsCapacity += 8;
+	}
+
+	job = &jobs[jobsCount];
+	job->info     = info;
+	Builder_Chunk = job->chunk;
+
+	/* Blocks are read and lighting is calculated on the main thread, */
+	/*  as worker threads must not access any other shared state */
+	beg  = Stopwatch_Measure();
+	read = Builder_ReadChunk(info);
+
+	Builder_BuildTime += Stopwatch_ElapsedMicroseconds(beg, Stopwatch_Measure());
+	if (!read) return false;
+
+	Builder_ChunksBuilt++;
+	jobsCount++;
+	return true;
+}
+
+void Builder_RunParallel(Builder_ParallelFunc func, int count) {
+	builderPool.threads = Builder_WorkerThreads;
+	WorkerPool_Run(&builderPool, func, count);
+}
+
+static void BuildQueuedJob(int index, int thread) { BuildJob(&jobs[index]); }
+
+void Builder_BuildQueued(Builder_ChunkBuilt built) {
+	cc_uint64 beg;
+	int i;
+	if (!jobsCount) return;
+
+	beg = Stopwatch_Measure();
+	Builder_RunParallel(BuildQueuedJob, jobsCount);
+
+	for (i = 0; i < jobsCount; i++)
+	{
+		if (jobs[i].verticesCount) UploadJob(&jobs[i]);
+	}
+	Builder_BuildTime += Stopwatch_ElapsedMicroseconds(beg, Stopwatch_Measure());
+
+	for (i = 0; i < jobsCount; i++)
+	{
+		built(jobs[i].info);
+	}
+	jobsCount = 0;
+}
+#else
+static void StopWorkers(void) { }
+static void FreeJobs(void)    { }
+
+cc_bool Builder_QueueChunk(struct ChunkInfo* info) {
+	Builder_MakeChunk(info); return false;
+}
+void Builder_BuildQueued(Builder_ChunkBuilt built) { }
+
+void Builder_RunParallel(Builder_ParallelFunc func, int count) {
+	int i;
+	for (i = 0; i < count; i++) func(i, 0);
+}
+#endif
+
+
 /*########################################################################################################################*
 *---------------------------------------------------Builder interface-----------------------------------------------------*
 *#########################################################################################################################*/
 cc_bool Builder_SmoothLighting;
+cc_bool Builder_GreedyMeshing;
 void Builder_ApplyActive(void) {
 	if (Builder_SmoothLighting) {
 		if (Lighting_Mode != LIGHTING_MODE_CLASSIC) {
@@ -1635,6 +2305,8 @@ void Builder_ApplyActive(void) {
 		else {
 			AdvBuilder_SetActive();
 		}
+	} else if (Builder_GreedyMeshing) {
+		GreedyBuilder_SetActive();
 	} else {
 		NormalBuilder_SetActive();
 	}
@@ -1649,7 +2321,22 @@ static void OnInit(void) {
 	Builder_Offsets[FACE_YMAX] =  EXTCHUNK_SIZE_2;
 
 	if (!Game_ClassicMode) Builder_SmoothLighting = Options_GetBool(OPT_SMOOTH_LIGHTING, false);
+	Builder_GreedyMeshing = Options_GetBool(OPT_GREEDY_MESHING, false);
 	Builder_ApplyActive();
+	Event_Register_(&TextureEvents.AtlasChanged, NULL, Greedy_OnAtlasChanged);
+
+#ifdef CC_BUILD_THREADEDBUILDER
+	Builder_WorkerThreads = Options_GetInt(OPT_BUILDER_THREADS, 0, BUILDER_MAX_THREADS, 0);
+#endif
+#ifdef CC_BUILD_PACKEDVERTICES
+	Builder_PackedVertices = Options_GetBool(OPT_PACKED_VERTICES, false);
+#endif
+}
+
+static void OnFree(void) {
+	StopWorkers();
+	FreeJobs();
+	FreePackScratch();
 }
 
 static void OnNewMapLoaded(void) {
@@ -1659,7 +2346,7 @@ static void OnNewMapLoaded(void) {
 
 struct IGameComponent Builder_Component = {
 	OnInit, /* Init */
-	NULL, /* Free */
+	OnFree, /* Free */
 	NULL, /* Reset */
 	NULL, /* OnNewMap */
 	OnNewMapLoaded /* OnNewMapLoaded */
@@ -18,10 +18,43 @@ extern struct IGameComponent Builder_Component;
 extern int Builder_SidesLevel, Builder_EdgeLevel;
 /* Whether smooth/advanced lighting mesh builder is used. */
 extern cc_bool Builder_SmoothLighting;
+/* Whether faces are merged into rectangles where possible, instead of just rows. */
+/* NOTE: Only used when smooth lighting is not used. */
+extern cc_bool Builder_GreedyMeshing;
+
+/* Whether chunk meshes use the smaller VERTEX_FORMAT_PACKED vertex format. */
+/* (only supported by some graphics backends, see CC_BUILD_PACKEDVERTICES) */
+extern cc_bool Builder_PackedVertices;
+
+/* Number of worker threads used to build chunk meshes and calculate lighting. */
+/* (0 means everything is done on main thread only) */
+extern int Builder_WorkerThreads;
+
+/* Number of chunk meshes built so far */
+extern int Builder_ChunksBuilt;
+/* Total time spent on the main thread building chunk meshes so far, in microseconds */
+/* (including the time spent calculating lighting for them) */
+extern cc_uint64 Builder_BuildTime;
+/* Total time spent calculating lighting for chunk meshes so far, in microseconds */
+extern cc_uint64 Builder_LightTime;
 
 /* Builds the mesh of vertices for the given chunk. */
 void Builder_MakeChunk(struct ChunkInfo* info);
 
+typedef void (*Builder_ChunkBuilt)(struct ChunkInfo* info);
+/* Queues the mesh of vertices for the given chunk to be built later by Builder_BuildQueued. */
+/* Returns false if the chunk was instead processed immediately. (e.g. because it is all air) */
+cc_bool Builder_QueueChunk(struct ChunkInfo* info);
+/* Builds the meshes of all queued chunks, in parallel on worker threads. */
+/* built is then called on the main thread for each queued chunk. */
+void Builder_BuildQueued(Builder_ChunkBuilt built);
+
+typedef void (*Builder_ParallelFunc)(int index, int thread);
+/* Calls func for every index from 0 to count - 1, spread across the worker threads and main thread. */
+/* thread is which thread func is being called on. (from 0 to Builder_WorkerThreads inclusive) */
+/* NOTE: Must only be called from the main thread. */
+void Builder_RunParallel(Builder_ParallelFunc func, int count);
+
 void Builder_ApplyActive(void);
 
 CC_END_HEADER
@@ -34,6 +34,7 @@ Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 		#define CC_VAR __declspec(dllexport)
 	#endif
 	
+	#define CC_THREADLOCAL __declspec(thread)
 	#define CC_HAS_TYPES
 	#define CC_HAS_MISC
 #elif __GNUC__
@@ -77,6 +78,11 @@ Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 	#endif
 	#endif
 	
+	/* Old Apple GCC versions don't support thread local storage */
+	#if !defined __APPLE__ || defined __clang__
+		#define CC_THREADLOCAL __thread
+	#endif
+
 	#define CC_HAS_MISC
 	#ifdef __BIG_ENDIAN__
 	#define CC_BIG_ENDIAN
@@ -590,6 +596,21 @@ typedef cc_uint8  cc_bool;
 	#define CC_BUILD_MAXSTACK (256 * 1024)
 #endif
 
+/* Chunk meshes can only be built on worker threads when each thread can have its own builder state */
+#if defined CC_THREADLOCAL && !defined CC_BUILD_COOPTHREADED && !defined CC_BUILD_CONSOLE && !defined CC_BUILD_GL11
+	#define CC_BUILD_THREADEDBUILDER
+#endif
+
+/* Map data received from servers is decompressed on worker threads, when threads can run in parallel */
+#if defined CC_BUILD_NETWORKING && !defined CC_BUILD_COOPTHREADED
+	#define CC_BUILD_ASYNCMAPLOAD
+#endif
+
+/* Files can only be memory mapped on desktop operating systems */
+#if (defined CC_BUILD_POSIX && !defined CC_BUILD_BEOS && !defined CC_BUILD_OS2) || (defined CC_BUILD_WIN && !defined CC_BUILD_UWP)
+	#define CC_BUILD_FILEMAP
+#endif
+
 #ifdef EXTENDED_BLOCKS
 typedef cc_uint16 BlockID;
 #else
@@ -6,6 +6,7 @@
 #include "Stream.h"
 #include "Errors.h"
 #include "Utils.h"
+#include "ExtMath.h"
 
 #define Header_ReadU8(value) if ((res = s->ReadU8(s, &value))) return res;
 /*########################################################################################################################*
@@ -152,7 +153,7 @@ enum INFLATE_STATE_ {
 };
 
 /* Insert next byte into the bit buffer */
-#define Inflate_GetByte(state) state->AvailIn--; state->Bits |= (cc_uint32)(*state->NextIn++) << state->NumBits; state->NumBits += 8;
+#define Inflate_GetByte(state) state->AvailIn--; state->Bits |= (cc_uint64)(*state->NextIn++) << state->NumBits; state->NumBits += 8;
 /* Retrieves bits from the bit buffer */
 #define Inflate_PeekBits(state, bits) (state->Bits & ((1UL << (bits)) - 1UL))
 /* Consumes/eats up bits from the bit buffer */
@@ -161,8 +162,6 @@ enum INFLATE_STATE_ {
 #define Inflate_AlignBits(state) cc_uint32 alignSkip = state->NumBits & 7; Inflate_ConsumeBits(state, alignSkip);
 /* Ensures there are 'bitsCount' bits, or returns if not */
 #define Inflate_EnsureBits(state, bitsCount) while (state->NumBits < bitsCount) { if (!state->AvailIn) return; Inflate_GetByte(state); }
-/* Ensures there are 'bitsCount' bits */
-#define Inflate_UNSAFE_EnsureBits(state, bitsCount) while (state->NumBits < bitsCount) { Inflate_GetByte(state); }
 /* Peeks then consumes given bits */
 #define Inflate_ReadBits(state, bitsCount) Inflate_PeekBits(state, bitsCount); Inflate_ConsumeBits(state, bitsCount);
 /* Sets to given result and sets state to DONE */
@@ -174,8 +173,23 @@ enum INFLATE_STATE_ {
 #define Inflate_NextCompressState(state) ((state->AvailIn >= INFLATE_FASTINF_IN && state->AvailOut >= INFLATE_FASTINF_OUT) ? INFLATE_STATE_FASTCOMPRESSED : INFLATE_STATE_COMPRESSED_LIT)
 /* The maximum amount of bytes that can be output is 258 */
 #define INFLATE_FASTINF_OUT 258
-/* The most input bytes required for huffman codes and extra data is 16 + 5 + 16 + 13 bits. Add 3 extra bytes to account for putting data into the bit buffer. */
-#define INFLATE_FASTINF_IN 10
+/* The bit buffer may be refilled twice per length + distance, and each refill reads up to 8 bytes at once */
+#define INFLATE_FASTINF_IN 16
+
+/* Whether 8 bytes can be efficiently read/written at once from any address, in little endian order */
+#if defined CC_BIG_ENDIAN
+	/* Bytes would need to be swapped */
+#elif defined __GNUC__ && (defined __i386__ || defined __x86_64__ || defined __aarch64__)
+	#define INFLATE_WORD_ACCESS
+	static CC_INLINE cc_uint64 Inflate_LoadWord(const cc_uint8* src) {
+		cc_uint64 word; __builtin_memcpy(&word, src, 8); return word;
+	}
+	#define Inflate_CopyWord(dst, src) __builtin_memcpy(dst, src, 8)
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64 || defined _M_ARM64)
+	#define INFLATE_WORD_ACCESS
+	#define Inflate_LoadWord(src)      (*(const cc_uint64*)(src))
+	#define Inflate_CopyWord(dst, src) *(cc_uint64*)(dst) = *(const cc_uint64*)(src)
+#endif
 
 static cc_uint32 Huffman_ReverseBits(cc_uint32 n, cc_uint8 bits) {
 	n = ((n & 0xAAAA) >> 1) | ((n & 0x5555) << 1);
@@ -306,44 +320,61 @@ static int Huffman_Decode(struct InflateState* state, struct HuffmanTable* table
 	return -1;
 }
 
-/* Inline the common <= 9 bits case */
-#define Huffman_UNSAFE_Decode(state, table, result) \
-{\
-	Inflate_UNSAFE_EnsureBits(state, INFLATE_MAX_BITS);\
-	packed = table.fast[Inflate_PeekBits(state, INFLATE_FAST_BITS)];\
-	if (packed >= 0) {\
-		consumedBits = packed >> INFLATE_FAST_BITS;\
-		Inflate_ConsumeBits(state, consumedBits);\
-		result = packed & 0x1FF;\
-	} else {\
-		result = Huffman_UNSAFE_Decode_Slow(state, &table);\
-	}\
-}
-
-static int Huffman_UNSAFE_Decode_Slow(struct InflateState* state, struct HuffmanTable* table) {
-	cc_uint32 i, j, codeword;
+/* Decodes a huffman codeword that is longer than INFLATE_FAST_BITS from the given bits */
+/* Returns length and value packed the same way as the fast table, or -1 if the codeword is invalid */
+static int Huffman_DecodeSlow(struct HuffmanTable* table, cc_uint32 bits) {
+	cc_uint32 i, codeword;
 	int offset;
 
 	/* Slow, bit by bit lookup. Need to reverse order for huffman. */
-	codeword = Inflate_PeekBits(state,       INFLATE_FAST_BITS);
-	codeword = Huffman_ReverseBits(codeword, INFLATE_FAST_BITS);
+	codeword = Huffman_ReverseBits(bits & ((1 << INFLATE_FAST_BITS) - 1), INFLATE_FAST_BITS);
 
-	for (i = INFLATE_FAST_BITS + 1, j = INFLATE_FAST_BITS; i < INFLATE_MAX_BITS; i++, j++) {
-		codeword = (codeword << 1) | ((state->Bits >> j) & 1);
+	for (i = INFLATE_FAST_BITS + 1; i < INFLATE_MAX_BITS; i++) {
+		codeword = (codeword << 1) | ((bits >> (i - 1)) & 1);
 
 		if (codeword < table->endCodewords[i]) {
 			offset = table->firstOffsets[i] + (codeword - table->firstCodewords[i]);
-			Inflate_ConsumeBits(state, i);
-			return table->values[offset];
+			return (i << INFLATE_FAST_LEN_SHIFT) | table->values[offset];
 		}
 	}
+	return -1;
+}
 
-	Inflate_Fail(state, INF_ERR_INVALID_CODE);
-	/* Need to exit the fast decode loop */
-	/* TODO: This means a few garbage bytes can get written */
-	/* to the output, but it probably doesn't matter */
-	state->AvailIn = 0;
-	return 0;
+/* Entries in the combined literal/length table are packed as [count:2][bits:6][value:24] */
+/*  count - 0 if codeword is too long for the table, 1 for single value, 2 for 2 literals */
+/*  value - first literal in lowest 8 bits and second literal in next 8 bits when count is 2 */
+#define MULTI_COUNT(entry) ((entry) >> 30)
+#define MULTI_BITS(entry)  (((entry) >> 24) & 0x3F)
+#define MULTI_VALUE(entry) ((entry) & 0xFFFFFF)
+#define MULTI_PACK(count, bits, value) (((cc_uint32)(count) << 30) | ((cc_uint32)(bits) << 24) | (value))
+#define INFLATE_MULTI_MASK ((1 << INFLATE_MULTI_BITS) - 1)
+
+/* Builds the combined literal/length lookup table from the literal/length huffman table */
+/* Runs of short literals are common (e.g. in map data), so where possible */
+/*  entries decode 2 literals in one lookup instead of just one */
+static void Inflate_BuildMulti(struct InflateState* s) {
+	struct HuffmanTable* table = &s->Table.Lits;
+	int packed, len1, len2, value1, value2;
+	int i;
+
+	for (i = 0; i < (1 << INFLATE_MULTI_BITS); i++) {
+		packed = table->fast[i & ((1 << INFLATE_FAST_BITS) - 1)];
+		if (packed < 0) { s->LitsMulti[i] = 0; continue; }
+
+		len1   = packed >> INFLATE_FAST_LEN_SHIFT;
+		value1 = packed &  INFLATE_FAST_VAL_MASK;
+		s->LitsMulti[i] = MULTI_PACK(1, len1, value1);
+		if (value1 >= 256) continue;
+
+		/* Check if remaining bits are also a complete literal codeword */
+		packed = table->fast[(i >> len1) & ((1 << INFLATE_FAST_BITS) - 1)];
+		if (packed < 0) continue;
+
+		len2   = packed >> INFLATE_FAST_LEN_SHIFT;
+		value2 = packed &  INFLATE_FAST_VAL_MASK;
+		if (value2 >= 256 || len1 + len2 > INFLATE_MULTI_BITS) continue;
+		s->LitsMulti[i] = MULTI_PACK(2, len1 + len2, value1 | (value2 << 8));
+	}
 }
 
 void Inflate_Init2(struct InflateState* state, struct Stream* source) {
@@ -399,67 +430,139 @@ static const cc_uint8 codelens_order[INFLATE_MAX_CODELENS] = {
 	16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 
 };
 
+/* Refills the local bit buffer to contain at least 56 bits */
+#ifdef INFLATE_WORD_ACCESS
+#define Inflate_FastRefill() \
+	bits |= Inflate_LoadWord(in) << numBits;\
+	in      += (63 - numBits) >> 3;\
+	availIn -= (63 - numBits) >> 3;\
+	numBits |= 56;
+#else
+#define Inflate_FastRefill() \
+	while (numBits < 56) { bits |= (cc_uint64)(*in++) << numBits; numBits += 8; availIn--; }
+#endif
+#define Inflate_FastConsume(count) bits >>= (count); numBits -= (count);
+
 static void Inflate_InflateFast(struct InflateState* s) {
+	/* bit buffer variables */
+	cc_uint64 bits;
+	cc_uint32 numBits, availIn, availOut;
+	cc_uint8* in;
+
 	/* huffman variables */
-	cc_uint32 lit, len, dist;
-	cc_uint32 bits, lenIdx, distIdx;
-	int packed, consumedBits;
+	cc_uint32 entry, lit, len, dist;
+	cc_uint32 extra, lenIdx, distIdx;
+	int packed;
 
 	/* window variables */
 	cc_uint8* window;
 	cc_uint32 i, curIdx, startIdx;
 	cc_uint32 copyStart, copyLen, partLen;
 
+	bits    = s->Bits;
+	numBits = s->NumBits;
+	in      = s->NextIn;
+	availIn = s->AvailIn;
+	availOut = s->AvailOut;
+
 	window = s->Window;
 	curIdx = s->WindowIndex;
 	copyStart = s->WindowIndex;
 	copyLen   = 0;
 
 #define INFLATE_FAST_COPY_MAX (INFLATE_WINDOW_SIZE - INFLATE_FASTINF_OUT)
-	while (s->AvailOut >= INFLATE_FASTINF_OUT && s->AvailIn >= INFLATE_FASTINF_IN && copyLen < INFLATE_FAST_COPY_MAX) {
-		Huffman_UNSAFE_Decode(s, s->Table.Lits, lit);
+	while (availOut >= INFLATE_FASTINF_OUT && availIn >= INFLATE_FASTINF_IN && copyLen < INFLATE_FAST_COPY_MAX) {
+		/* Longest possible length code + extra bits is 15 + 5 bits */
+		if (numBits < 20) { Inflate_FastRefill(); }
+		entry = s->LitsMulti[bits & INFLATE_MULTI_MASK];
+
+		if (MULTI_COUNT(entry) == 2) {
+			window[curIdx] = (cc_uint8)entry;
+			window[(curIdx + 1) & INFLATE_WINDOW_MASK] = (cc_uint8)(entry >> 8);
+			curIdx = (curIdx + 2) & INFLATE_WINDOW_MASK;
+
+			availOut -= 2; copyLen += 2;
+			Inflate_FastConsume(MULTI_BITS(entry));
+			continue;
+		} else if (entry) {
+			lit = MULTI_VALUE(entry);
+			Inflate_FastConsume(MULTI_BITS(entry));
+		} else {
+			packed = Huffman_DecodeSlow(&s->Table.Lits, (cc_uint32)bits);
+			if (packed < 0) { Inflate_Fail(s, INF_ERR_INVALID_CODE); break; }
 
-		if (lit <= 256) {
-			if (lit < 256) {
-				window[curIdx] = (cc_uint8)lit;
-				s->AvailOut--; copyLen++;
-				curIdx = (curIdx + 1) & INFLATE_WINDOW_MASK;
-			} else {
-				s->State = Inflate_NextBlockState(s);
-				break;
+			lit = packed & INFLATE_FAST_VAL_MASK;
+			Inflate_FastConsume(packed >> INFLATE_FAST_LEN_SHIFT);
+		}
+
+		if (lit < 256) {
+			window[curIdx] = (cc_uint8)lit;
+			availOut--; copyLen++;
+			curIdx = (curIdx + 1) & INFLATE_WINDOW_MASK;
+			continue;
+		} else if (lit == 256) {
+			s->State = Inflate_NextBlockState(s);
+			break;
+		}
+
+		lenIdx = lit - 257;
+		extra  = len_bits[lenIdx];
+		len    = len_base[lenIdx] + (cc_uint32)(bits & ((1UL << extra) - 1));
+		Inflate_FastConsume(extra);
+
+		/* Longest possible distance code + extra bits is 15 + 13 bits */
+		if (numBits < 28) { Inflate_FastRefill(); }
+		packed = s->TableDists.fast[bits & ((1 << INFLATE_FAST_BITS) - 1)];
+		if (packed < 0) {
+			packed = Huffman_DecodeSlow(&s->TableDists, (cc_uint32)bits);
+			if (packed < 0) { Inflate_Fail(s, INF_ERR_INVALID_CODE); break; }
+		}
+		distIdx = packed & INFLATE_FAST_VAL_MASK;
+		Inflate_FastConsume(packed >> INFLATE_FAST_LEN_SHIFT);
+
+		extra = dist_bits[distIdx];
+		dist  = dist_base[distIdx] + (cc_uint32)(bits & ((1UL << extra) - 1));
+		Inflate_FastConsume(extra);
+
+		/* Window infinitely repeats like ...xyz|uvwxyz|uvwxyz|uvw... */
+		/* If start and end don't cross a boundary, can avoid masking index */
+		startIdx = (curIdx - dist) & INFLATE_WINDOW_MASK;
+		if (curIdx >= startIdx && (curIdx + len) < INFLATE_WINDOW_SIZE) {
+			cc_uint8* src = &window[startIdx]; 
+			cc_uint8* dst = &window[curIdx];
+			i = 0;
+
+			if (dist == 1) {
+				/* Run of the same byte, very common in map data */
+				Mem_Set(dst, *src, len); i = len;
+			}
+#ifdef INFLATE_WORD_ACCESS
+			/* Source and destination only overlap within 8 bytes when distance < 8 */
+			else if (dist >= 8) {
+				for (; i + 8 <= len; i += 8) { Inflate_CopyWord(dst + i, src + i); }
 			}
+#endif
+
+			for (; i + 4 <= len; i += 4) {
+				dst[i] = src[i]; dst[i + 1] = src[i + 1]; dst[i + 2] = src[i + 2]; dst[i + 3] = src[i + 3];
+			}
+			for (; i < len; i++) { dst[i] = src[i]; }
 		} else {
-			lenIdx = lit - 257;
-			bits = len_bits[lenIdx];
-			Inflate_UNSAFE_EnsureBits(s, bits);
-			len  = len_base[lenIdx] + Inflate_ReadBits(s, bits);
-
-			Huffman_UNSAFE_Decode(s, s->TableDists, distIdx);
-			bits = dist_bits[distIdx];
-			Inflate_UNSAFE_EnsureBits(s, bits);
-			dist = dist_base[distIdx] + Inflate_ReadBits(s, bits);
-	
-			/* Window infinitely repeats like ...xyz|uvwxyz|uvwxyz|uvw... */
-			/* If start and end don't cross a boundary, can avoid masking index */
-			startIdx = (curIdx - dist) & INFLATE_WINDOW_MASK;
-			if (curIdx >= startIdx && (curIdx + len) < INFLATE_WINDOW_SIZE) {
-				cc_uint8* src = &window[startIdx]; 
-				cc_uint8* dst = &window[curIdx];
-
-				for (i = 0; i < (len & ~0x3); i += 4) {
-					*dst++ = *src++; *dst++ = *src++; *dst++ = *src++; *dst++ = *src++;
-				}
-				for (; i < len; i++) { *dst++ = *src++; }
-			} else {
-				for (i = 0; i < len; i++) {
-					window[(curIdx + i) & INFLATE_WINDOW_MASK] = window[(startIdx + i) & INFLATE_WINDOW_MASK];
-				}
+			for (i = 0; i < len; i++) {
+				window[(curIdx + i) & INFLATE_WINDOW_MASK] = window[(startIdx + i) & INFLATE_WINDOW_MASK];
 			}
-			curIdx = (curIdx + len) & INFLATE_WINDOW_MASK;
-			s->AvailOut -= len; copyLen += len;
 		}
+		curIdx = (curIdx + len) & INFLATE_WINDOW_MASK;
+		availOut -= len; copyLen += len;
 	}
 
+	/* Bits above numBits may have been read ahead from input, and would be read again later */
+	s->Bits    = bits & (((cc_uint64)1 << numBits) - 1);
+	s->NumBits = numBits;
+	s->NextIn  = in;
+	s->AvailIn = availIn;
+	s->AvailOut = availOut;
+
 	s->WindowIndex = curIdx;
 	if (!copyLen) return;
 
@@ -507,6 +610,7 @@ void Inflate_Process(struct InflateState* s) {
 			case 1: { /* Fixed/static huffman compressed */
 				(void)Huffman_Build(&s->Table.Lits, fixed_lits,  INFLATE_MAX_LITS);
 				(void)Huffman_Build(&s->TableDists, fixed_dists, INFLATE_MAX_DISTS);
+				Inflate_BuildMulti(s);
 				s->State = Inflate_NextCompressState(s);
 			} break;
 
@@ -619,6 +723,7 @@ void Inflate_Process(struct InflateState* s) {
 				if (res) { Inflate_Fail(s, res); return; }
 				res = Huffman_Build(&s->TableDists, s->Buffer + s->NumLits, s->NumDists);
 				if (res) { Inflate_Fail(s, res); return; }
+				Inflate_BuildMulti(s);
 			}
 			break;
 		}
@@ -805,11 +910,11 @@ static const cc_uint16 deflate_dist[31] = {
 };
 
 /* Pushes given bits, but does not write them */
-#define Deflate_PushBits(state, value, bits) state->Bits |= (value) << state->NumBits; state->NumBits += (bits);
-/* Pushes bits of the huffman codeword bits for the given literal, but does not write them */
-#define Deflate_PushLit(state, value) Deflate_PushBits(state, state->LitsCodewords[value], state->LitsLens[value])
-/* Pushes given bits (reversing for huffman code), but does not write them */
-#define Deflate_PushHuff(state, value, bits) Deflate_PushBits(state, Huffman_ReverseBits(value, bits), bits)
+#define Deflate_PushBits(state, value, bits) state->Bits |= (cc_uint32)(value) << state->NumBits; state->NumBits += (bits);
+/* Pushes bits of the huffman codeword bits for the given literal/length, but does not write them */
+#define Deflate_PushLit(state, value)  Deflate_PushBits(state, state->LitsCodewords[value],  state->LitsLens[value])
+/* Pushes bits of the huffman codeword bits for the given distance, but does not write them */
+#define Deflate_PushDist(state, value) Deflate_PushBits(state, state->DistsCodewords[value], state->DistsLens[value])
 /* Writes given byte to output */
 #define Deflate_WriteByte(state) *state->NextOut++ = state->Bits; state->AvailOut--; state->Bits >>= 8; state->NumBits -= 8;
 /* Flushes bits in buffer to output buffer */
@@ -817,44 +922,136 @@ static const cc_uint16 deflate_dist[31] = {
 
 #define MIN_MATCH_LEN 3
 #define MAX_MATCH_LEN 258
+/* Matches of minimum length that are further away than this usually take up more space than literals */
+#define MIN_MATCH_MAX_DIST 4096
+/* Number of literal/length and distance codes that can actually appear in compressed data */
+#define DEFLATE_NUM_LITS  286
+#define DEFLATE_NUM_DISTS 30
+
+/* Match finding configuration for each compression level (same as zlib's) */
+static const struct DeflateConfig {
+	cc_uint16 maxChain; /* Maximum number of previous positions to check for a match */
+	cc_uint16 goodLen;  /* Check fewer positions when the previous match is at least this long */
+	cc_uint16 lazyLen;  /* Check for longer match at next position if match is shorter than this (0 = greedy) */
+	cc_uint16 niceLen;  /* Stop checking previous positions once a match is at least this long */
+} deflate_configs[DEFLATE_LEVEL_BEST + 1] = {
+	{    0,  0,   0,   0 }, /* Stored only */
+	{    4,  4,   0,   8 },
+	{    8,  4,   0,  16 },
+	{   32,  4,   0,  32 },
+	{   16,  4,   4,  16 },
+	{   32,  8,  16,  32 },
+	{  128,  8,  16, 128 },
+	{  256,  8,  32, 128 },
+	{ 1024, 32, 128, 258 },
+	{ 4096, 32, 258, 258 },
+};
+
+/* Maps match lengths and distances to length and distance codes */
+static cc_uint8 deflate_lenCodes[MAX_MATCH_LEN + 1];
+static cc_uint8 deflate_distCodes[512];
+/* Distances above 256 are looked up in 128 byte granularity, as all codes above that are 128 byte aligned */
+#define Deflate_DistCode(dist) ((dist) <= 256 ? deflate_distCodes[(dist) - 1] : deflate_distCodes[256 + (((dist) - 1) >> 7)])
+
+static void Deflate_InitCodes(void) {
+	int i, j;
+	for (i = MIN_MATCH_LEN, j = 0; i <= MAX_MATCH_LEN; i++) {
+		while (i >= deflate_len[j + 1]) j++;
+		deflate_lenCodes[i] = j;
+	}
+
+	for (i = 1, j = 0; i <= 256; i++) {
+		while (i >= deflate_dist[j + 1]) j++;
+		deflate_distCodes[i - 1] = j;
+	}
+	for (i = 2; i < 256; i++) {
+		while ((i << 7) + 1 >= deflate_dist[j + 1]) j++;
+		deflate_distCodes[256 + i] = j;
+	}
+}
 
 /* Number of bytes that match (are the same) from a and b */
 static int Deflate_MatchLen(cc_uint8* a, cc_uint8* b, int maxLen) {
 	int i = 0;
-	while (i < maxLen && *a == *b) { i++; a++; b++; }
+#ifdef INFLATE_WORD_ACCESS
+	while (i + 8 <= maxLen && Inflate_LoadWord(a + i) == Inflate_LoadWord(b + i)) { i += 8; }
+#endif
+	while (i < maxLen && a[i] == b[i]) { i++; }
 	return i;
 }
 
 /* Hashes 3 bytes of data */
 static cc_uint32 Deflate_Hash(cc_uint8* src) {
-	return (cc_uint32)((src[0] << 8) ^ (src[1] << 4) ^ (src[2])) & DEFLATE_HASH_MASK;
+	cc_uint32 value = src[0] | (src[1] << 8) | (src[2] << 16);
+	return (cc_uint32)(value * 2654435761U) >> (32 - DEFLATE_HASH_BITS);
+}
+
+/* Inserts the given position into the hash chain for the data at that position */
+#define Deflate_Insert(state, hash, pos) state->Prev[pos] = state->Head[hash]; state->Head[hash] = pos;
+
+/* Inserts all positions in the given range that have enough data after them to be hashed */
+static void Deflate_InsertRange(struct DeflateState* state, int beg, int end, int dataEnd) {
+	end = min(end, dataEnd - (MIN_MATCH_LEN - 1));
+	for (; beg < end; beg++) {
+		Deflate_Insert(state, Deflate_Hash(state->Input + beg), beg);
+	}
+}
+
+/* Finds the longest previous match for the data at the given position that is longer than prevLen */
+/* Returns length of the match, or 0 if no such match was found */
+static int Deflate_FindMatch(struct DeflateState* state, cc_uint32 hash, int pos, int maxLen, int prevLen, int* bestDist) {
+	cc_uint8* input = state->Input;
+	cc_uint8* cur   = input + pos;
+	int chain   = state->MaxChain;
+	int niceLen = min(state->NiceLen, maxLen);
+	int bestLen = max(prevLen, MIN_MATCH_LEN - 1);
+	int cand, len, found = 0;
+
+	if (bestLen >= maxLen) return 0;
+	if (prevLen >= state->GoodLen) chain >>= 2;
+
+	for (cand = state->Head[hash]; cand && chain; cand = state->Prev[cand], chain--) {
+		/* Quickly skip positions that can't be longer than the current best match */
+		if (input[cand + bestLen] != cur[bestLen] || input[cand] != cur[0]) continue;
+
+		len = Deflate_MatchLen(input + cand, cur, maxLen);
+		if (len <= bestLen) continue;
+
+		bestLen   = len;
+		found     = len;
+		*bestDist = pos - cand;
+		if (len >= niceLen) break;
+	}
+
+	if (found == MIN_MATCH_LEN && *bestDist > MIN_MATCH_MAX_DIST) return 0;
+	return found;
 }
 
-/* Writes a literal to state->Output */
+/* Adds a literal to the symbols for the current block */
 static void Deflate_Lit(struct DeflateState* state, int lit) {
-	Deflate_PushLit(state, lit);
-	Deflate_FlushBits(state);
+	state->SymbolLits[state->NumSymbols]  = lit;
+	state->SymbolDists[state->NumSymbols] = 0;
+	state->NumSymbols++;
+	state->LitsFreqs[lit]++;
 }
 
-/* Writes a length-distance pair to state->Output */
+/* Adds a length-distance pair to the symbols for the current block */
 static void Deflate_LenDist(struct DeflateState* state, int len, int dist) {
-	int j;
-	/* TODO: Do we actually need the if (len_bits[j]) ????????? does writing 0 bits matter??? */
+	int lenCode  = deflate_lenCodes[len];
+	int distCode = Deflate_DistCode(dist);
 
-	for (j = 0; len >= deflate_len[j + 1]; j++);
-	Deflate_PushLit(state, j + 257);
-	if (len_bits[j]) { Deflate_PushBits(state, len - deflate_len[j], len_bits[j]); }
-	Deflate_FlushBits(state);
+	state->SymbolLits[state->NumSymbols]  = len - MIN_MATCH_LEN;
+	state->SymbolDists[state->NumSymbols] = dist;
+	state->NumSymbols++;
 
-	for (j = 0; dist >= deflate_dist[j + 1]; j++);
-	Deflate_PushHuff(state, j, 5);
-	if (dist_bits[j]) { Deflate_PushBits(state, dist - deflate_dist[j], dist_bits[j]); }
-	Deflate_FlushBits(state);
+	state->LitsFreqs[lenCode + 257]++;
+	state->DistsFreqs[distCode]++;
+	state->ExtraBits += len_bits[lenCode] + dist_bits[distCode];
 }
 
 /* Moves "current block" to "previous block", adjusting state if needed. */
 static void Deflate_MoveBlock(struct DeflateState* state) {
-	int i;
+	int i, prev;
 	Mem_Copy(state->Input, state->Input + DEFLATE_BLOCK_SIZE, DEFLATE_BLOCK_SIZE);
 	state->InputPosition = DEFLATE_BLOCK_SIZE;
 
@@ -862,95 +1059,382 @@ static void Deflate_MoveBlock(struct DeflateState* state) {
 	for (i = 0; i < Array_Elems(state->Head); i++) {
 		state->Head[i] = state->Head[i] < DEFLATE_BLOCK_SIZE ? 0 : (state->Head[i] - DEFLATE_BLOCK_SIZE);
 	}
-	for (i = 0; i < Array_Elems(state->Prev); i++) {
-		state->Prev[i] = state->Prev[i] < DEFLATE_BLOCK_SIZE ? 0 : (state->Prev[i] - DEFLATE_BLOCK_SIZE);
+	/* hash chain links for "current block" become the links for "previous block" */
+	for (i = 0; i < DEFLATE_BLOCK_SIZE; i++) {
+		prev = state->Prev[i + DEFLATE_BLOCK_SIZE];
+		state->Prev[i] = prev < DEFLATE_BLOCK_SIZE ? 0 : (prev - DEFLATE_BLOCK_SIZE);
 	}
 }
 
-/* Compresses current block of data */
-static cc_result Deflate_FlushBlock(struct DeflateState* state, int len) {
-	cc_uint32 hash, nextHash;
-	int bestLen, maxLen, matchLen, depth;
-	int bestPos, pos, nextPos;
-	cc_uint16 oldHead;
-	cc_uint8* input;
-	cc_uint8* cur;
-	cc_result res;
+/* Writes buffered output data to the destination stream */
+static cc_result Deflate_WriteOutput(struct DeflateState* state) {
+	cc_result res = Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
+	state->NextOut  = state->Output;
+	state->AvailOut = DEFLATE_OUT_SIZE;
+	return res;
+}
+/* Leave room in output buffer for a few symbols (and header entries) */
+#define Deflate_CheckOutput(state) if (state->AvailOut < 20 && (res = Deflate_WriteOutput(state))) return res;
+
+/* Computes length limited huffman codeword bit lengths for the given value frequencies */
+/* Based off tdefl_calculate_minimum_redundancy from https://github.com/richgel999/miniz */
+static void Deflate_ComputeLens(const cc_uint16* freqs, int count, int maxBits, cc_uint8* lens) {
+	struct DeflateNode { cc_uint32 key; int value; } nodes[INFLATE_MAX_LITS], tmp;
+	int numCodes[INFLATE_MAX_BITS];
+	int root, leaf, next, avail, used, depth;
+	int i, j, n, total;
+
+	for (i = 0, n = 0; i < count; i++) {
+		lens[i] = 0;
+		if (!freqs[i]) continue;
+		nodes[n].key = freqs[i]; nodes[n].value = i; n++;
+	}
+	if (n <= 1) {
+		if (n) lens[nodes[0].value] = 1;
+		return;
+	}
 
-	if (!state->WroteHeader) {
-		state->WroteHeader = true;
-		Deflate_PushBits(state, 3, 3); /* final block TRUE, block type FIXED */
+	/* Sort by frequency, lowest first (at most 286 values, so insertion sort is fine) */
+	for (i = 1; i < n; i++) {
+		tmp = nodes[i];
+		for (j = i; j > 0 && nodes[j - 1].key > tmp.key; j--) { nodes[j] = nodes[j - 1]; }
+		nodes[j] = tmp;
 	}
 
-	/* Based off descriptions from http://www.gzip.org/algorithm.txt and
-	https://github.com/nothings/stb/blob/master/stb_image_write.h */
-	input = state->Input;
-	cur   = input + DEFLATE_BLOCK_SIZE;
-
-	/* Compress current block of data */
-	/* Use > instead of >=, because also try match at one byte after current */
-	while (len > MIN_MATCH_LEN) {
-		hash   = Deflate_Hash(cur);
-		maxLen = min(len, MAX_MATCH_LEN);
-
-		bestLen = MIN_MATCH_LEN - 1; /* Match must be at least 3 bytes */
-		bestPos = 0;
-
-		/* Find longest match starting at this byte */
-		/* Only explore up to 5 previous matches, to avoid slow performance */
-		/* (i.e prefer quickly saving maps/screenshots to completely optimal filesize) */
-		pos = state->Head[hash];
-		for (depth = 0; pos != 0 && depth < 5; depth++) {
-			matchLen = Deflate_MatchLen(&input[pos], cur, maxLen);
-			if (matchLen > bestLen) { bestLen = matchLen; bestPos = pos; }
-			pos = state->Prev[pos];
+	/* In-place calculation of optimal codeword lengths, see Moffat & Katajainen 1995 */
+	nodes[0].key += nodes[1].key; root = 0; leaf = 2;
+	for (next = 1; next < n - 1; next++) {
+		if (leaf >= n || nodes[root].key < nodes[leaf].key) {
+			nodes[next].key = nodes[root].key; nodes[root++].key = next;
+		} else {
+			nodes[next].key = nodes[leaf++].key;
 		}
 
-		/* Insert this entry into the hash chain */
-		pos = (int)(cur - input);
-		oldHead = state->Head[hash];
-		state->Head[hash] = pos;
-		state->Prev[pos]  = oldHead;
-
-		/* Lazy evaluation: Find longest match starting at next byte */
-		/* If that's longer than the longest match at current byte, throwaway this match */
-		if (bestPos) {
-			nextHash = Deflate_Hash(cur + 1);
-			nextPos  = state->Head[nextHash];
-			maxLen   = min(len - 1, MAX_MATCH_LEN);
-
-			for (depth = 0; nextPos != 0 && depth < 5; depth++) {
-				matchLen = Deflate_MatchLen(&input[nextPos], cur + 1, maxLen);
-				if (matchLen > bestLen) { bestPos = 0; break; }
-				nextPos = state->Prev[nextPos];
-			}
+		if (leaf >= n || (root < next && nodes[root].key < nodes[leaf].key)) {
+			nodes[next].key += nodes[root].key; nodes[root++].key = next;
+		} else {
+			nodes[next].key += nodes[leaf++].key;
 		}
+	}
+
+	nodes[n - 2].key = 0;
+	for (next = n - 3; next >= 0; next--) {
+		nodes[next].key = nodes[nodes[next].key].key + 1;
+	}
+
+	avail = 1; used = depth = 0; root = n - 2; next = n - 1;
+	while (avail > 0) {
+		while (root >= 0 && (int)nodes[root].key == depth) { used++; root--; }
+		while (avail > used) { nodes[next--].key = depth; avail--; }
+		avail = 2 * used; depth++; used = 0;
+	}
 
-		if (bestPos) {
-			Deflate_LenDist(state, bestLen, pos - bestPos);
-			len -= bestLen; cur += bestLen;
+	/* Limit codeword lengths to maxBits, then lengthen shorter codewords until tree is complete again */
+	for (i = 0; i <= maxBits; i++) numCodes[i] = 0;
+	for (i = 0; i < n; i++) {
+		numCodes[min((int)nodes[i].key, maxBits)]++;
+	}
+
+	for (i = 1, total = 0; i <= maxBits; i++) {
+		total += numCodes[i] << (maxBits - i);
+	}
+	for (; total > (1 << maxBits); total--) {
+		numCodes[maxBits]--;
+		for (i = maxBits - 1; i > 0; i--) {
+			if (!numCodes[i]) continue;
+			numCodes[i]--; numCodes[i + 1] += 2; break;
+		}
+	}
+
+	/* Least frequent values get the longest codewords */
+	for (i = maxBits, j = 0; i > 0; i--) {
+		for (total = numCodes[i]; total > 0; total--) { lens[nodes[j++].value] = i; }
+	}
+}
+
+/* Constructs a huffman encoding table (for values to codewords) */
+static void Deflate_BuildTable(const cc_uint8* lens, int count, cc_uint16* codewords, cc_uint8* bitlens) {
+	int i, j, offset, codeword;
+	struct HuffmanTable table;
+
+	/* NOTE: Can ignore since lens table is not user controlled */
+	(void)Huffman_Build(&table, lens, count);
+	for (i = 0; i < INFLATE_MAX_BITS; i++) {
+		if (!table.endCodewords[i]) continue;
+		count = table.endCodewords[i] - table.firstCodewords[i];
+
+		for (j = 0; j < count; j++) {
+			offset   = table.values[table.firstOffsets[i] + j];
+			codeword = table.firstCodewords[i] + j;
+			bitlens[offset]   = i;
+			codewords[offset] = Huffman_ReverseBits(codeword, i);
+		}
+	}
+}
+
+/* Run length encoded codeword bit lengths for a dynamic huffman block header */
+struct DeflateCodeLens {
+	cc_uint8 lens[DEFLATE_NUM_LITS + DEFLATE_NUM_DISTS];
+	cc_uint8 symbols[DEFLATE_NUM_LITS + DEFLATE_NUM_DISTS];
+	cc_uint8 extra[DEFLATE_NUM_LITS + DEFLATE_NUM_DISTS];
+	int numSymbols, numLits, numDists, numCodeLens;
+	cc_uint16 freqs[INFLATE_MAX_CODELENS];
+	cc_uint16 codewords[INFLATE_MAX_CODELENS];
+	cc_uint8 bitlens[INFLATE_MAX_CODELENS];
+};
+
+static void Deflate_AddCodeLen(struct DeflateCodeLens* cl, int symbol, int extra) {
+	cl->symbols[cl->numSymbols] = symbol;
+	cl->extra[cl->numSymbols]   = extra;
+	cl->numSymbols++;
+	cl->freqs[symbol]++;
+}
+
+/* Number of extra bits for the repeat codeword bit lengths (16, 17, 18) */
+static const cc_uint8 codelen_extra[3] = { 2, 3, 7 };
+
+/* Computes huffman tables for the current block, then returns number of bits needed for dynamic block header */
+static cc_uint32 Deflate_BuildDynamic(struct DeflateState* state, struct DeflateCodeLens* cl) {
+	int i, run, total, len;
+	cc_uint32 bits;
+
+	/* Deflate decoders may reject huffman trees with less than 2 codewords */
+	if (!state->DistsFreqs[0]) state->DistsFreqs[0] = 1;
+	if (!state->DistsFreqs[1]) state->DistsFreqs[1] = 1;
+
+	Deflate_ComputeLens(state->LitsFreqs,  DEFLATE_NUM_LITS,  15, state->LitsLens);
+	Deflate_ComputeLens(state->DistsFreqs, DEFLATE_NUM_DISTS, 15, state->DistsLens);
+
+	for (cl->numLits  = DEFLATE_NUM_LITS;  !state->LitsLens[cl->numLits - 1];   cl->numLits--)  { }
+	for (cl->numDists = DEFLATE_NUM_DISTS; !state->DistsLens[cl->numDists - 1]; cl->numDists--) { }
+
+	Mem_Copy(cl->lens,                state->LitsLens,  cl->numLits);
+	Mem_Copy(cl->lens + cl->numLits,  state->DistsLens, cl->numDists);
+	total = cl->numLits + cl->numDists;
+
+	cl->numSymbols = 0;
+	Mem_Set(cl->freqs, 0, sizeof(cl->freqs));
+
+	/* Run length encode the bit lengths, using 16 (repeat previous), 17 and 18 (repeat zero) */
+	for (i = 0; i < total; i += run) {
+		len = cl->lens[i];
+		for (run = 1; i + run < total && cl->lens[i + run] == len; run++) { }
+
+		if (len == 0 && run >= 11) {
+			run = min(run, 138); Deflate_AddCodeLen(cl, 18, run - 11);
+		} else if (len == 0 && run >= 3) {
+			run = min(run, 10);  Deflate_AddCodeLen(cl, 17, run - 3);
+		} else if (len && run >= 4) {
+			run = min(run, 7);   Deflate_AddCodeLen(cl, len, 0);
+			Deflate_AddCodeLen(cl, 16, run - 4);
 		} else {
-			Deflate_Lit(state, *cur);
-			len--; cur++;
+			run = 1; Deflate_AddCodeLen(cl, len, 0);
 		}
+	}
 
-		/* leave room for a few bytes and literals at end */
-		if (state->AvailOut >= 20) continue;
-		res = Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
-		state->NextOut  = state->Output;
-		state->AvailOut = DEFLATE_OUT_SIZE;
-		if (res) return res;
+	Deflate_ComputeLens(cl->freqs, INFLATE_MAX_CODELENS, 7, cl->bitlens);
+	Deflate_BuildTable(cl->bitlens, INFLATE_MAX_CODELENS, cl->codewords, cl->bitlens);
+	for (cl->numCodeLens = INFLATE_MAX_CODELENS; !cl->bitlens[codelens_order[cl->numCodeLens - 1]]; cl->numCodeLens--) { }
+	cl->numCodeLens = max(cl->numCodeLens, 4);
+
+	bits = 3 + 5 + 5 + 4 + 3 * cl->numCodeLens;
+	for (i = 0; i < INFLATE_MAX_CODELENS; i++) {
+		bits += cl->freqs[i] * cl->bitlens[i];
+		if (i >= 16) bits += cl->freqs[i] * codelen_extra[i - 16];
+	}
+	return bits;
+}
+
+/* Writes the header of a dynamic huffman block */
+static cc_result Deflate_WriteDynamicHeader(struct DeflateState* state, struct DeflateCodeLens* cl) {
+	int i, symbol;
+	cc_result res;
+
+	Deflate_PushBits(state, cl->numLits - 257,   5);
+	Deflate_PushBits(state, cl->numDists - 1,    5);
+	Deflate_PushBits(state, cl->numCodeLens - 4, 4);
+	Deflate_FlushBits(state);
+
+	for (i = 0; i < cl->numCodeLens; i++) {
+		Deflate_PushBits(state, cl->bitlens[codelens_order[i]], 3);
+		Deflate_FlushBits(state);
 	}
 
-	/* literals for last few bytes */
+	for (i = 0; i < cl->numSymbols; i++) {
+		symbol = cl->symbols[i];
+		Deflate_PushBits(state, cl->codewords[symbol], cl->bitlens[symbol]);
+		if (symbol >= 16) { Deflate_PushBits(state, cl->extra[i], codelen_extra[symbol - 16]); }
+		Deflate_FlushBits(state);
+		Deflate_CheckOutput(state);
+	}
+	return 0;
+}
+
+/* Writes a stored/uncompressed block containing the given data */
+static cc_result Deflate_WriteStored(struct DeflateState* state, cc_uint8* data, int len) {
+	int count;
+	cc_result res;
+
+	/* Stored block data starts on a byte boundary */
+	Deflate_FlushBits(state);
+	if (state->NumBits) { Deflate_PushBits(state, 0, 8 - state->NumBits); }
+	Deflate_PushBits(state, len,          16); Deflate_FlushBits(state);
+	Deflate_PushBits(state, len ^ 0xFFFF, 16); Deflate_FlushBits(state);
+
 	while (len > 0) {
-		Deflate_Lit(state, *cur);
-		len--; cur++;
+		if (!state->AvailOut && (res = Deflate_WriteOutput(state))) return res;
+		count = min(len, (int)state->AvailOut);
+
+		Mem_Copy(state->NextOut, data, count);
+		state->NextOut  += count; state->AvailOut -= count;
+		data += count; len -= count;
 	}
+	Deflate_CheckOutput(state);
+	return 0;
+}
 
-	res = Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
-	state->NextOut  = state->Output;
-	state->AvailOut = DEFLATE_OUT_SIZE;
+/* Writes the huffman encoded symbols of the current block */
+static cc_result Deflate_WriteSymbols(struct DeflateState* state) {
+	int i, lit, dist, code;
+	cc_result res;
+
+	for (i = 0; i < state->NumSymbols; i++) {
+		lit  = state->SymbolLits[i];
+		dist = state->SymbolDists[i];
+
+		if (!dist) {
+			Deflate_PushLit(state, lit);
+			Deflate_FlushBits(state);
+		} else {
+			code = deflate_lenCodes[lit + MIN_MATCH_LEN];
+			Deflate_PushLit(state, code + 257);
+			Deflate_PushBits(state, lit + MIN_MATCH_LEN - deflate_len[code], len_bits[code]);
+			Deflate_FlushBits(state);
+
+			code = Deflate_DistCode(dist);
+			Deflate_PushDist(state, code);
+			Deflate_FlushBits(state);
+			Deflate_PushBits(state, dist - deflate_dist[code], dist_bits[code]);
+			Deflate_FlushBits(state);
+		}
+		Deflate_CheckOutput(state);
+	}
+
+	/* Write huffman encoded "literal 256" to terminate symbols */
+	Deflate_PushLit(state, 256);
+	Deflate_FlushBits(state);
+	return 0;
+}
+
+/* Writes a DEFLATE block containing the current symbols, which encode Input from beg to end */
+/* Uses whichever of stored, fixed huffman or dynamic huffman block encodings is smallest */
+static cc_result Deflate_WriteBlock(struct DeflateState* state, int beg, int end, cc_bool final) {
+	struct DeflateCodeLens cl;
+	cc_uint32 fixedBits, dynamicBits, storedBits;
+	cc_result res;
+	int i;
+
+	/* 'end of block' symbol */
+	state->LitsFreqs[256]++;
+	fixedBits   = 3 + state->ExtraBits;
+	dynamicBits = Deflate_BuildDynamic(state, &cl) + state->ExtraBits;
+	storedBits  = 3 + 7 + 32 + (end - beg) * 8;
+
+	for (i = 0; i < DEFLATE_NUM_LITS; i++) {
+		fixedBits   += state->LitsFreqs[i] * fixed_lits[i];
+		dynamicBits += state->LitsFreqs[i] * state->LitsLens[i];
+	}
+	for (i = 0; i < DEFLATE_NUM_DISTS; i++) {
+		fixedBits   += state->DistsFreqs[i] * fixed_dists[i];
+		dynamicBits += state->DistsFreqs[i] * state->DistsLens[i];
+	}
+
+	if (state->Level == DEFLATE_LEVEL_NONE || (storedBits <= fixedBits && storedBits <= dynamicBits)) {
+		Deflate_PushBits(state, final | (0 << 1), 3);
+		res = Deflate_WriteStored(state, state->Input + beg, end - beg);
+	} else if (fixedBits <= dynamicBits) {
+		Deflate_PushBits(state, final | (1 << 1), 3);
+		Deflate_BuildTable(fixed_lits,  INFLATE_MAX_LITS,  state->LitsCodewords,  state->LitsLens);
+		Deflate_BuildTable(fixed_dists, INFLATE_MAX_DISTS, state->DistsCodewords, state->DistsLens);
+		res = Deflate_WriteSymbols(state);
+	} else {
+		Deflate_PushBits(state, final | (2 << 1), 3);
+		Deflate_BuildTable(state->LitsLens,  DEFLATE_NUM_LITS,  state->LitsCodewords,  state->LitsLens);
+		Deflate_BuildTable(state->DistsLens, DEFLATE_NUM_DISTS, state->DistsCodewords, state->DistsLens);
+
+		res = Deflate_WriteDynamicHeader(state, &cl);
+		if (!res) res = Deflate_WriteSymbols(state);
+	}
+
+	state->NumSymbols = 0;
+	state->ExtraBits  = 0;
+	Mem_Set(state->LitsFreqs,  0, sizeof(state->LitsFreqs));
+	Mem_Set(state->DistsFreqs, 0, sizeof(state->DistsFreqs));
+	return res;
+}
+
+/* Compresses current block of data */
+static cc_result Deflate_FlushBlock(struct DeflateState* state, int len, cc_bool final) {
+	int pos, end, maxLen;
+	int bestLen, bestDist, prevLen, prevDist;
+	cc_bool pending;
+	cc_uint8* input;
+	cc_uint32 hash;
+	cc_result res;
+
+	/* Based off descriptions from http://www.gzip.org/algorithm.txt and
+	https://github.com/nothings/stb/blob/master/stb_image_write.h */
+	input = state->Input;
+	pos   = DEFLATE_BLOCK_SIZE;
+	end   = DEFLATE_BLOCK_SIZE + len;
+
+	/* pending means the decision for the byte before pos has been deferred */
+	/* (i.e. to check if there is a longer match at the next byte with lazy matching) */
+	pending = false;
+	prevLen = 0; prevDist = 0;
+	bestDist = 0;
+
+	if (state->Level == DEFLATE_LEVEL_NONE) pos = end;
+
+	while (pos < end) {
+		bestLen = 0;
+		maxLen  = min(end - pos, MAX_MATCH_LEN);
+
+		if (maxLen >= MIN_MATCH_LEN) {
+			hash = Deflate_Hash(input + pos);
+			if (!pending || prevLen < state->LazyLen) {
+				bestLen = Deflate_FindMatch(state, hash, pos, maxLen, pending ? prevLen : 0, &bestDist);
+			}
+			Deflate_Insert(state, hash, pos);
+		}
+
+		if (pending && prevLen >= MIN_MATCH_LEN && prevLen >= bestLen) {
+			/* Match at previous byte is at least as long as match at this byte */
+			Deflate_LenDist(state, prevLen, prevDist);
+			Deflate_InsertRange(state, pos + 1, pos - 1 + prevLen, end);
+			pos += prevLen - 1;
+			pending = false;
+		} else if (state->LazyLen) {
+			/* Defer using the match at this byte until match at next byte is known */
+			if (pending) Deflate_Lit(state, input[pos - 1]);
+			prevLen  = bestLen;
+			prevDist = bestDist;
+			pending  = true;
+			pos++;
+		} else if (bestLen) {
+			Deflate_LenDist(state, bestLen, bestDist);
+			Deflate_InsertRange(state, pos + 1, pos + bestLen, end);
+			pos += bestLen;
+		} else {
+			Deflate_Lit(state, input[pos]);
+			pos++;
+		}
+	}
+	if (pending) Deflate_Lit(state, input[pos - 1]);
+
+	res = Deflate_WriteBlock(state, DEFLATE_BLOCK_SIZE, end, final);
+	if (res) return res;
+	res = Deflate_WriteOutput(state);
 
 	Deflate_MoveBlock(state);
 	return res;
@@ -978,26 +1462,22 @@ static cc_result Deflate_StreamWrite(struct Stream* stream, const cc_uint8* data
 		data += len;
 
 		if (state->InputPosition == DEFLATE_BUFFER_SIZE) {
-			res = Deflate_FlushBlock(state, DEFLATE_BLOCK_SIZE);
+			res = Deflate_FlushBlock(state, DEFLATE_BLOCK_SIZE, false);
 			if (res) return res;
 		}
 	}
 	return 0;
 }
 
-/* Flushes any buffered data, then writes terminating symbol */
+/* Flushes any buffered data as the final block */
 static cc_result Deflate_StreamClose(struct Stream* stream) {
 	struct DeflateState* state;
 	cc_result res;
 
 	state = (struct DeflateState*)stream->meta.inflate;
-	res   = Deflate_FlushBlock(state, state->InputPosition - DEFLATE_BLOCK_SIZE);
+	res   = Deflate_FlushBlock(state, state->InputPosition - DEFLATE_BLOCK_SIZE, true);
 	if (res) return res;
 
-	/* Write huffman encoded "literal 256" to terminate symbols */
-	Deflate_PushLit(state, 256);
-	Deflate_FlushBits(state);
-
 	/* In case last byte still has a few extra bits */
 	if (state->NumBits) {
 		while (state->NumBits < 8) { Deflate_PushBits(state, 0, 1); }
@@ -1007,32 +1487,15 @@ static cc_result Deflate_StreamClose(struct Stream* stream) {
 	return Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
 }
 
-/* Constructs a huffman encoding table (for values to codewords) */
-static void Deflate_BuildTable(const cc_uint8* lens, int count, cc_uint16* codewords, cc_uint8* bitlens) {
-	int i, j, offset, codeword;
-	struct HuffmanTable table;
-
-	/* NOTE: Can ignore since lens table is not user controlled */
-	(void)Huffman_Build(&table, lens, count);
-	for (i = 0; i < INFLATE_MAX_BITS; i++) {
-		if (!table.endCodewords[i]) continue;
-		count = table.endCodewords[i] - table.firstCodewords[i];
-
-		for (j = 0; j < count; j++) {
-			offset   = table.values[table.firstOffsets[i] + j];
-			codeword = table.firstCodewords[i] + j;
-			bitlens[offset]   = i;
-			codewords[offset] = Huffman_ReverseBits(codeword, i);
-		}
-	}
-}
-
 void Deflate_MakeStream(struct Stream* stream, struct DeflateState* state, struct Stream* underlying) {
+	static cc_bool codesInited;
 	Stream_Init(stream);
 	stream->meta.inflate = state;
 	stream->Write = Deflate_StreamWrite;
 	stream->Close = Deflate_StreamClose;
 
+	if (!codesInited) { Deflate_InitCodes(); codesInited = true; }
+
 	/* First half of buffer is "previous block" */
 	state->InputPosition = DEFLATE_BLOCK_SIZE;
 	state->Bits    = 0;
@@ -1041,11 +1504,27 @@ void Deflate_MakeStream(struct Stream* stream, struct DeflateState* state, struc
 	state->NextOut  = state->Output;
 	state->AvailOut = DEFLATE_OUT_SIZE;
 	state->Dest     = underlying;
-	state->WroteHeader = false;
+
+	state->NumSymbols = 0;
+	state->ExtraBits  = 0;
+	Mem_Set(state->LitsFreqs,  0, sizeof(state->LitsFreqs));
+	Mem_Set(state->DistsFreqs, 0, sizeof(state->DistsFreqs));
 
 	Mem_Set(state->Head, 0, sizeof(state->Head));
 	Mem_Set(state->Prev, 0, sizeof(state->Prev));
-	Deflate_BuildTable(fixed_lits, INFLATE_MAX_LITS, state->LitsCodewords, state->LitsLens);
+	Deflate_SetLevel(state, DEFLATE_LEVEL_DEFAULT);
+}
+
+void Deflate_SetLevel(struct DeflateState* state, int level) {
+	const struct DeflateConfig* cfg;
+	Math_Clamp(level, DEFLATE_LEVEL_NONE, DEFLATE_LEVEL_BEST);
+	cfg = &deflate_configs[level];
+
+	state->Level    = level;
+	state->MaxChain = cfg->maxChain;
+	state->GoodLen  = cfg->goodLen;
+	state->LazyLen  = cfg->lazyLen;
+	state->NiceLen  = cfg->niceLen;
 }
 
 
@@ -23,7 +23,7 @@ void ZLibHeader_Init(struct ZLibHeader* header);
 cc_result ZLibHeader_Read(struct Stream* s, struct ZLibHeader* header);
 
 
-#define INFLATE_MAX_INPUT 8192
+#define INFLATE_MAX_INPUT 4096
 #define INFLATE_MAX_CODELENS 19
 #define INFLATE_MAX_LITS 288
 #define INFLATE_MAX_DISTS 32
@@ -33,6 +33,8 @@ cc_result ZLibHeader_Read(struct Stream* s, struct ZLibHeader* header);
 #define INFLATE_FAST_BITS 9
 #define INFLATE_FAST_LEN_SHIFT 9
 #define INFLATE_FAST_VAL_MASK  0x1FF
+/* Number of bits used to index the combined literal/length lookup table */
+#define INFLATE_MULTI_BITS 10
 
 #define INFLATE_WINDOW_SIZE 0x8000UL
 #define INFLATE_WINDOW_MASK 0x7FFFUL
@@ -48,7 +50,7 @@ struct HuffmanTable {
 struct InflateState {
 	cc_uint8 State;
 	cc_bool LastBlock; /* Whether the last DEFLATE block has been encounted in the stream */
-	cc_uint32 Bits;    /* Holds bits across byte boundaries */
+	cc_uint64 Bits;    /* Holds bits across byte boundaries */
 	cc_uint32 NumBits; /* Number of bits in Bits buffer */
 
 	cc_uint8* NextIn;   /* Pointer within Input buffer to next byte that can be read */
@@ -69,6 +71,7 @@ struct InflateState {
 		struct HuffmanTable Lits;           /* Values represent literal or lengths */
 	} Table; /* union to save on memory */
 	struct HuffmanTable TableDists;         /* Values represent distances back */
+	cc_uint32 LitsMulti[1 << INFLATE_MULTI_BITS]; /* Decodes up to 2 literals at once */
 	cc_uint8 Window[INFLATE_WINDOW_SIZE];    /* Holds circular buffer of recent output data, used for LZ77 */
 	cc_result result;
 };
@@ -87,8 +90,21 @@ CC_API void Inflate_MakeStream2(struct Stream* stream, struct InflateState* stat
 #define DEFLATE_BLOCK_SIZE  16384
 #define DEFLATE_BUFFER_SIZE 32768
 #define DEFLATE_OUT_SIZE 8192
+#define DEFLATE_HASH_BITS 12
 #define DEFLATE_HASH_SIZE 0x1000UL
 #define DEFLATE_HASH_MASK 0x0FFFUL
+/* A block never has more symbols than bytes of input, so symbols never need to be flushed early */
+#define DEFLATE_MAX_SYMBOLS DEFLATE_BLOCK_SIZE
+
+/* Stores data uncompressed (fastest, but largest output) */
+#define DEFLATE_LEVEL_NONE    0
+/* Greedy matching with short hash chains (fast) */
+#define DEFLATE_LEVEL_FAST    1
+/* Lazy matching with moderate hash chains (good balance of speed and size) */
+#define DEFLATE_LEVEL_DEFAULT 6
+/* Lazy matching with very long hash chains (slowest, but smallest output) */
+#define DEFLATE_LEVEL_BEST    9
+
 struct DeflateState {
 	cc_uint32 Bits;         /* Holds bits across byte boundaries */
 	cc_uint32 NumBits;      /* Number of bits in Bits buffer */
@@ -107,11 +123,29 @@ struct DeflateState {
 	cc_uint16 Prev[DEFLATE_BUFFER_SIZE];
 	/* NOTE: The largest possible value that can get */
 	/*  stored in Head/Prev is <= DEFLATE_BUFFER_SIZE */
-	cc_bool WroteHeader;
+	cc_bool WroteHeader; /* Unused, only kept so the fields above keep the same layout */
+
+	cc_uint16 DistsCodewords[INFLATE_MAX_DISTS]; /* Codewords for each distance */
+	cc_uint8 DistsLens[INFLATE_MAX_DISTS];       /* Bit lengths of each distance codeword */
+	cc_uint16 LitsFreqs[INFLATE_MAX_LITS];       /* Number of times each value is used in current block */
+	cc_uint16 DistsFreqs[INFLATE_MAX_DISTS];     /* Number of times each distance is used in current block */
+
+	cc_uint8 Level;     /* Compression level (see DEFLATE_LEVEL_ defines) */
+	cc_uint16 MaxChain; /* Maximum number of previous positions to check for a match */
+	cc_uint16 GoodLen, LazyLen, NiceLen;
+	cc_uint32 NumSymbols; /* Number of symbols in current block */
+	cc_uint32 ExtraBits;  /* Number of extra length/distance bits needed by symbols in current block */
+
+	cc_uint8  SymbolLits[DEFLATE_MAX_SYMBOLS];  /* Literal, or match length - 3 */
+	cc_uint16 SymbolDists[DEFLATE_MAX_SYMBOLS]; /* Match distance, or 0 for a literal */
 };
 /* Compresses input data using DEFLATE, then writes compressed output to another stream. Write only stream. */
 /* DEFLATE compression is pure compressed data, there is no header or footer. */
+/* NOTE: Uses DEFLATE_LEVEL_DEFAULT compression level, use Deflate_SetLevel to change this. */
 CC_API void Deflate_MakeStream(struct Stream* stream, struct DeflateState* state, struct Stream* underlying);
+/* Sets how much effort is spent on compressing data, from DEFLATE_LEVEL_NONE to DEFLATE_LEVEL_BEST */
+/* NOTE: Must be called before any data is written to the stream */
+CC_API void Deflate_SetLevel(struct DeflateState* state, int level);
 
 struct GZipState { struct DeflateState Base; cc_uint32 Crc32, Size; };
 /* Compresses input data using GZIP, then writes compressed output to another stream. Write only stream. */
@@ -138,5 +138,9 @@ enum CC_ERRORS {
 	SSL_ERR_CONTEXT_DEAD = 0xCCDED070UL, /* Server shutdown the SSL context and it must be recreated */
 	PNG_ERR_16BITSAMPLES = 0xCCDED071UL, /* Image uses 16 bit samples, which is unimplemented */
 	ERR_NO_NETWORKING    = 0xCCDED072UL, /* No working network connection */
+	SNAP_ERR_SIGNATURE   = 0xCCDED073UL, /* Snapshot map file doesn't start with the snapshot signature */
+	SNAP_ERR_VERSION     = 0xCCDED074UL, /* Snapshot map file uses an unsupported format version */
+	SNAP_ERR_TRUNCATED   = 0xCCDED075UL, /* Snapshot map file sections extend past the end of the file */
+	SNAP_ERR_DIMENSIONS  = 0xCCDED076UL, /* Snapshot map dimensions are invalid or differ from its metadata */
 };
 #endif
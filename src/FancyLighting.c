@@ -12,6 +12,7 @@
 #include "ExtMath.h"
 #include "Options.h"
 #include "Queue.h"
+#include "Builder.h"
 
 struct LightNode {
 	IVec3 coords; /* 12 bytes */
@@ -100,39 +101,6 @@ static void FreePalettes(void) {
 	}
 }
 
-static int chunksCount;
-static void AllocState(void) {
-	ClassicLighting_AllocState();
-	InitPalettes();
-	chunksCount = World.ChunksCount;
-
-	chunkLightingDataFlags = (cc_uint8*)Mem_AllocCleared(chunksCount, sizeof(cc_uint8), "light flags");
-	chunkLightingData = (LightingChunk*)Mem_AllocCleared(chunksCount, sizeof(LightingChunk), "light chunks");
-	Queue_Init(&lightQueue, sizeof(struct LightNode));
-	Queue_Init(&unlightQueue, sizeof(struct LightNode));
-}
-
-static void FreeState(void) {
-	int i;
-	ClassicLighting_FreeState();
-	
-	/* This function can be called multiple times without calling AllocState, so... */
-	if (!chunkLightingDataFlags) return;
-
-	FreePalettes();
-
-	for (i = 0; i < chunksCount; i++) {
-		Mem_Free(chunkLightingData[i]);
-	}
-
-	Mem_Free(chunkLightingDataFlags);
-	Mem_Free(chunkLightingData);
-	chunkLightingDataFlags = NULL;
-	chunkLightingData = NULL;
-	Queue_Clear(&lightQueue);
-	Queue_Clear(&unlightQueue);
-}
-
 /* Converts chunk x/y/z coordinates to the corresponding index in chunks array/list */
 #define ChunkCoordsToIndex(cx, cy, cz) (((cy) * World.ChunksZ + (cz)) * World.ChunksX + (cx))
 /* Converts local x/y/z coordinates to the corresponding index in a chunk */
@@ -269,95 +237,318 @@ cc_uint8 GetBlockBrightness(BlockID curBlock, cc_bool isLamp) {
 #define LightNode_Init(node, X, Y, Z, bright) \
 	node.coords.x = X; node.coords.y = Y; node.coords.z = Z; node.brightness = bright;
 
-static void CalculateChunkLightingSelf(int chunkIndex, int cx, int cy, int cz) {
-	int x, y, z;
-	/* Block coordinates */
-	int chunkStartX, chunkStartY, chunkStartZ, chunkEndX, chunkEndY, chunkEndZ;
+
+/*########################################################################################################################*
+*-------------------------------------------------Chunk light calculation-------------------------------------------------*
+*#########################################################################################################################*/
+/* Light from a block can spread at most (FANCY_LIGHTING_MAX_LEVEL - 1) blocks away from it */
+#define REGION_BORDER (FANCY_LIGHTING_MAX_LEVEL - 1)
+/* Size of the region that light from the blocks in a chunk can spread into */
+#define REGION_SIZE   (CHUNK_SIZE + REGION_BORDER * 2)
+#define REGION_SIZE_3 (REGION_SIZE * REGION_SIZE * REGION_SIZE)
+#define RegionIndex(x, y, z) ((((y) * REGION_SIZE) + (z)) * REGION_SIZE + (x))
+
+/* Nodes are packed into 32 bits as (x | z << 6 | y << 12), relative to the region */
+/*  with the brightness of the emitting block also stored in the upper 8 bits for seeds */
+#define RegionNode_Pack(x, y, z) ((cc_uint32)(x) | ((cc_uint32)(z) << 6) | ((cc_uint32)(y) << 12))
+#define RegionNode_X(node) ((int)((node)         & 0x3F))
+#define RegionNode_Z(node) ((int)(((node) >> 6)  & 0x3F))
+#define RegionNode_Y(node) ((int)(((node) >> 12) & 0x3F))
+#define RegionNode_Coords(node) ((node) & 0x3FFFF)
+#define RegionNode_Brightness(node) ((int)((node) >> 24))
+
+/* Light levels from all the light emitting blocks in a chunk, before being merged into the world */
+struct LightRegion {
+	int x, y, z;          /* World coordinates of minimum corner of the region */
+	int minX, minY, minZ; /* Bounds of the part of the region that is inside the world */
+	int maxX, maxY, maxZ; /* (maximum bounds are exclusive) */
+	int seedsCount;
+	cc_uint32 seeds[CHUNK_SIZE_3];
+	cc_uint32 nodes[REGION_SIZE_3];
+	cc_uint8 levels[REGION_SIZE_3];
+};
+
+/* Bit flags of which faces of each block light can pass through (see CanLightPass) */
+static cc_uint8 lightPassFaces[BLOCK_COUNT];
+static cc_bool lightPassDirty = true;
+
+static void CalcLightPassFaces(void) {
+	int block, face;
+	for (block = 0; block < BLOCK_COUNT; block++) 
+	{
+		lightPassFaces[block] = 0;
+		for (face = 0; face < FACE_COUNT; face++) 
+		{
+			if (CanLightPass((BlockID)block, (Face)face)) lightPassFaces[block] |= 1 << face;
+		}
+	}
+	lightPassDirty = false;
+}
+
+static cc_bool Region_FindEmitters(struct LightRegion* r, int cx, int cy, int cz) {
+	int x, y, z, baseX = cx * CHUNK_SIZE, baseY = cy * CHUNK_SIZE, baseZ = cz * CHUNK_SIZE;
+	int endX = min(baseX + CHUNK_SIZE, World.Width);
+	int endY = min(baseY + CHUNK_SIZE, World.Height);
+	int endZ = min(baseZ + CHUNK_SIZE, World.Length);
 	cc_uint8 brightness;
-	BlockID curBlock;
-	struct LightNode entry;
+	r->seedsCount = 0;
+
+	for (y = baseY; y < endY; y++) {
+		for (z = baseZ; z < endZ; z++) {
+			for (x = baseX; x < endX; x++) {
+				brightness = Blocks.Brightness[World_GetBlock(x, y, z)];
+				if (!brightness) continue;
+
+				r->seeds[r->seedsCount++] = RegionNode_Pack(x - baseX + REGION_BORDER, y - baseY + REGION_BORDER, 
+											z - baseZ + REGION_BORDER) | ((cc_uint32)brightness << 24);
+			}
+		}
+	}
+	return r->seedsCount > 0;
+}
+
+static void Region_Init(struct LightRegion* r, int cx, int cy, int cz) {
+	r->x = cx * CHUNK_SIZE - REGION_BORDER;
+	r->y = cy * CHUNK_SIZE - REGION_BORDER;
+	r->z = cz * CHUNK_SIZE - REGION_BORDER;
+
+	r->minX = max(0, -r->x); r->maxX = min(REGION_SIZE, World.Width  - r->x);
+	r->minY = max(0, -r->y); r->maxY = min(REGION_SIZE, World.Height - r->y);
+	r->minZ = max(0, -r->z); r->maxZ = min(REGION_SIZE, World.Length - r->z);
+	Mem_Set(r->levels, 0, REGION_SIZE_3);
+}
+
+/* Blocks emit lava light if they have any, otherwise they emit lamp light */
+static int Region_SeedBrightness(cc_uint32 node, int shift) {
+	int brightness = RegionNode_Brightness(node);
+	int lava       = brightness & FANCY_LIGHTING_MAX_LEVEL;
+
+	if (!shift) return lava;
+	return lava ? 0 : brightness >> FANCY_LIGHTING_LAMP_SHIFT;
+}
+
+#define Region_TrySpreadInto(cond, dx, dy, dz, face) \
+	if ((cond) && (thisFaces & (1 << ((face) ^ 1)))) { \
+		index = RegionIndex(x + dx, y + dy, z + dz); \
+		block = World_GetBlock(r->x + x + dx, r->y + y + dy, r->z + z + dz); \
+		if ((lightPassFaces[block] & (1 << (face))) && ((r->levels[index] >> shift) & FANCY_LIGHTING_MAX_LEVEL) < level) { \
+			r->levels[index] |= level << shift; \
+			r->nodes[tail++]  = RegionNode_Pack(x + dx, y + dy, z + dz); \
+		} \
+	}
+
+/* Spreads light from all the emitters in the region at once, brightest levels first. */
+/* Since a cell is always reached by its brightest light first, each cell is only visited once. */
+static void Region_Spread(struct LightRegion* r, int shift) {
+	int i, x, y, z, index, level, thisFaces, head = 0, tail = 0, end;
+	cc_uint32 node;
+	BlockID block;
+
+	for (level = FANCY_LIGHTING_MAX_LEVEL; level > 0; level--) 
+	{
+		/* Emitters of this brightness start spreading light from now on */
+		for (i = 0; i < r->seedsCount; i++) 
+		{
+			node = r->seeds[i];
+			if (Region_SeedBrightness(node, shift) != level) continue;
+
+			index = RegionIndex(RegionNode_X(node), RegionNode_Y(node), RegionNode_Z(node));
+			if (((r->levels[index] >> shift) & FANCY_LIGHTING_MAX_LEVEL) >= level) continue;
+
+			r->levels[index] |= level << shift;
+			r->nodes[tail++]  = RegionNode_Coords(node);
+		}
+
+		/* Light at level 1 cannot spread any further */
+		if (level == 1) break;
+		end = tail;
+
+		for (; head < end; head++) 
+		{
+			node = r->nodes[head];
+			x = RegionNode_X(node); y = RegionNode_Y(node); z = RegionNode_Z(node);
+
+			thisFaces = lightPassFaces[World_GetBlock(r->x + x, r->y + y, r->z + z)];
+			level--;
+
+			Region_TrySpreadInto(x > r->minX,     -1, 0, 0, FACE_XMIN)
+			Region_TrySpreadInto(x < r->maxX - 1,  1, 0, 0, FACE_XMAX)
+			Region_TrySpreadInto(y > r->minY,      0,-1, 0, FACE_YMIN)
+			Region_TrySpreadInto(y < r->maxY - 1,  0, 1, 0, FACE_YMAX)
+			Region_TrySpreadInto(z > r->minZ,      0, 0,-1, FACE_ZMIN)
+			Region_TrySpreadInto(z < r->maxZ - 1,  0, 0, 1, FACE_ZMAX)
+			level++;
+		}
+	}
+}
 
-	chunkStartX = cx * CHUNK_SIZE;
-	chunkStartY = cy * CHUNK_SIZE;
-	chunkStartZ = cz * CHUNK_SIZE;
-	chunkEndX = chunkStartX + CHUNK_SIZE;
-	chunkEndY = chunkStartY + CHUNK_SIZE;
-	chunkEndZ = chunkStartZ + CHUNK_SIZE;
-
-	if (chunkEndX > World.Width ) { chunkEndX = World.Width;  }
-	if (chunkEndY > World.Height) { chunkEndY = World.Height; }
-	if (chunkEndZ > World.Length) { chunkEndZ = World.Length; }
-
-	for (y = chunkStartY; y < chunkEndY; y++) {
-		for (z = chunkStartZ; z < chunkEndZ; z++) {
-			for (x = chunkStartX; x < chunkEndX; x++) {
-
-				curBlock = World_GetBlock(x, y, z);
-				
-				if (Blocks.Brightness[curBlock] > 0) {
-
-					brightness = GetBlockBrightness(curBlock, false);
-
-					if (brightness > 0) {
-						LightNode_Init(entry, x, y, z, brightness);
-						Queue_Enqueue(&lightQueue, &entry);
-						FlushLightQueue(false, false);
-					}
-					else {
-						/* If no lava brightness, it must use lamp brightness */
-						brightness = Blocks.Brightness[curBlock] >> FANCY_LIGHTING_LAMP_SHIFT;
-						LightNode_Init(entry, x, y, z, brightness);
-						Queue_Enqueue(&lightQueue, &entry);
-						FlushLightQueue(true, false);
-					}
+/* Merges the light levels in the region into the world's lighting, keeping the brightest light */
+static void Region_Merge(struct LightRegion* r) {
+	int x, y, z, worldX, worldY, worldZ, chunkIndex, localIndex;
+	cc_uint8 value, cur;
+	LightingChunk chunk;
+
+	for (y = r->minY; y < r->maxY; y++) {
+		for (z = r->minZ; z < r->maxZ; z++) {
+			for (x = r->minX; x < r->maxX; x++) {
+				value = r->levels[RegionIndex(x, y, z)];
+				if (!value) continue;
+
+				worldX = r->x + x; worldY = r->y + y; worldZ = r->z + z;
+				chunkIndex = ChunkCoordsToIndex(worldX >> CHUNK_SHIFT, worldY >> CHUNK_SHIFT, worldZ >> CHUNK_SHIFT);
+				chunk      = chunkLightingData[chunkIndex];
+
+				if (!chunk) {
+					chunk = (cc_uint8*)Mem_TryAllocCleared(CHUNK_SIZE_3, sizeof(cc_uint8));
+					if (!chunk) continue;
+					chunkLightingData[chunkIndex] = chunk;
 				}
 
-				/* Note: This code only deals with generating light from block sources.
-				Regular sun light is added on as a "post process" step when returning light color in the exposed API.
-				This has the added benefit of being able to skip allocating chunk lighting data in regions that have no light-casting blocks*/
+				localIndex = GlobalCoordsToChunkCoordsIndex(worldX, worldY, worldZ);
+				cur        = chunk[localIndex];
+				chunk[localIndex] = max(cur & FANCY_LIGHTING_MAX_LEVEL, value & FANCY_LIGHTING_MAX_LEVEL)
+								  | max(cur & FANCY_LIGHTING_LAMP_MASK, value & FANCY_LIGHTING_LAMP_MASK);
 			}
 		}
 	}
+}
+
+/* Chunks whose own lighting is calculated together, possibly in parallel */
+#define MAX_LIGHT_JOBS 64
+static IVec3 lightJobs[MAX_LIGHT_JOBS];
+static int lightJobsCount;
+/* Light region of each thread that can calculate chunk lighting */
+static struct LightRegion** lightRegions;
+static int lightRegionsCount;
+/* Regions of different chunks may overlap, so only one can be merged at a time */
+static void* lightMergeMutex;
+
+static void CalcChunkJob(int index, int thread) {
+	struct LightRegion* r = lightRegions[thread];
+	IVec3 coords = lightJobs[index];
+
+	if (!Region_FindEmitters(r, coords.x, coords.y, coords.z)) return;
+	Region_Init(r, coords.x, coords.y, coords.z);
+
+	Region_Spread(r, 0);
+	Region_Spread(r, FANCY_LIGHTING_LAMP_SHIFT);
+
+	if (lightMergeMutex) Mutex_Lock(lightMergeMutex);
+	Region_Merge(r);
+	if (lightMergeMutex) Mutex_Unlock(lightMergeMutex);
+}
+
+static void AllocRegions(void) {
+	int i;
+	lightRegionsCount = Builder_WorkerThreads + 1;
+	lightRegions      = (struct LightRegion**)Mem_Alloc(lightRegionsCount, sizeof(struct LightRegion*), "light regions");
+
+	for (i = 0; i < lightRegionsCount; i++) 
+	{
+		lightRegions[i] = (struct LightRegion*)Mem_Alloc(1, sizeof(struct LightRegion), "light region");
+	}
+	if (Builder_WorkerThreads) lightMergeMutex = Mutex_Create("Light merge");
+}
+
+static void FreeRegions(void) {
+	int i;
+	if (!lightRegions) return;
+
+	for (i = 0; i < lightRegionsCount; i++) 
+	{
+		Mem_Free(lightRegions[i]);
+	}
+	Mem_Free(lightRegions);
+	lightRegions = NULL;
 
+	if (lightMergeMutex) Mutex_Free(lightMergeMutex);
+	lightMergeMutex = NULL;
+}
+
+static void CalcQueuedChunks(void) {
+	if (!lightJobsCount) return;
+	if (lightPassDirty) CalcLightPassFaces();
+	if (!lightRegions)  AllocRegions();
+
+	Builder_RunParallel(CalcChunkJob, lightJobsCount);
+	lightJobsCount = 0;
+}
+
+/* Queues the light from blocks in the given chunk to be calculated by CalcQueuedChunks */
+static void QueueChunkSelf(int cx, int cy, int cz) {
+	int chunkIndex = ChunkCoordsToIndex(cx, cy, cz);
+	if (chunkLightingDataFlags[chunkIndex] != CHUNK_UNCALCULATED) return;
+	/* Lighting is always calculated before anything can read it */
 	chunkLightingDataFlags[chunkIndex] = CHUNK_SELF_CALCULATED;
+
+	/* Most chunks have no light emitting blocks at all */
+	if (!World_ChunkHasEmitters(cx, cy, cz)) return;
+	if (lightJobsCount == MAX_LIGHT_JOBS) CalcQueuedChunks();
+	lightJobs[lightJobsCount].x = cx;
+	lightJobs[lightJobsCount].y = cy;
+	lightJobs[lightJobsCount].z = cz;
+	lightJobsCount++;
 }
 
-static void CalculateChunkLightingAll(int chunkIndex, int cx, int cy, int cz) {
-	int x, y, z;
-	/* Chunk coordinates */
-	int chunkStartX, chunkStartY, chunkStartZ;
-	int chunkEndX, chunkEndY, chunkEndZ;
-	int curChunkIndex;
-
-	chunkStartX = cx - 1;
-	chunkStartY = cy - 1;
-	chunkStartZ = cz - 1;
-	chunkEndX = cx + 1;
-	chunkEndY = cy + 1;
-	chunkEndZ = cz + 1;
-
-	if (chunkStartX == -1) { chunkStartX++; }
-	if (chunkStartY == -1) { chunkStartY++; }
-	if (chunkStartZ == -1) { chunkStartZ++; }
-	if (chunkEndX == World.ChunksX) { chunkEndX--; }
-	if (chunkEndY == World.ChunksY) { chunkEndY--; }
-	if (chunkEndZ == World.ChunksZ) { chunkEndZ--; }
-
-	for (y = chunkStartY; y <= chunkEndY; y++) {
-		for (z = chunkStartZ; z <= chunkEndZ; z++) {
-			for (x = chunkStartX; x <= chunkEndX; x++) {
-				curChunkIndex = ChunkCoordsToIndex(x, y, z);
-
-				if (chunkLightingDataFlags[curChunkIndex] == CHUNK_UNCALCULATED) {
-					CalculateChunkLightingSelf(curChunkIndex, x, y, z);
-				}
+/* Queues the given range of chunks, plus all of their neighbours */
+static void QueueChunksAround(int minCX, int minCY, int minCZ, int maxCX, int maxCY, int maxCZ) {
+	int cx, cy, cz;
+	minCX = max(0, minCX - 1); maxCX = min(World.ChunksX - 1, maxCX + 1);
+	minCY = max(0, minCY - 1); maxCY = min(World.ChunksY - 1, maxCY + 1);
+	minCZ = max(0, minCZ - 1); maxCZ = min(World.ChunksZ - 1, maxCZ + 1);
+
+	for (cy = minCY; cy <= maxCY; cy++) {
+		for (cz = minCZ; cz <= maxCZ; cz++) {
+			for (cx = minCX; cx <= maxCX; cx++) {
+				QueueChunkSelf(cx, cy, cz);
 			}
 		}
 	}
+}
+
+static void CalculateChunkLightingAll(int chunkIndex, int cx, int cy, int cz) {
+	QueueChunksAround(cx, cy, cz, cx, cy, cz);
+	CalcQueuedChunks();
 	chunkLightingDataFlags[chunkIndex] = CHUNK_ALL_CALCULATED;
 }
 
 
+static int chunksCount;
+static void AllocState(void) {
+	ClassicLighting_AllocState();
+	InitPalettes();
+	chunksCount = World.ChunksCount;
+
+	chunkLightingDataFlags = (cc_uint8*)Mem_AllocCleared(chunksCount, sizeof(cc_uint8), "light flags");
+	chunkLightingData = (LightingChunk*)Mem_AllocCleared(chunksCount, sizeof(LightingChunk), "light chunks");
+	Queue_Init(&lightQueue, sizeof(struct LightNode));
+	Queue_Init(&unlightQueue, sizeof(struct LightNode));
+	lightPassDirty = true;
+}
+
+static void FreeState(void) {
+	int i;
+	ClassicLighting_FreeState();
+	
+	/* This function can be called multiple times without calling AllocState, so... */
+	if (!chunkLightingDataFlags) return;
+
+	FreePalettes();
+
+	for (i = 0; i < chunksCount; i++) {
+		Mem_Free(chunkLightingData[i]);
+	}
+	FreeRegions();
+
+	Mem_Free(chunkLightingDataFlags);
+	Mem_Free(chunkLightingData);
+	chunkLightingDataFlags = NULL;
+	chunkLightingData = NULL;
+	Queue_Clear(&lightQueue);
+	Queue_Clear(&unlightQueue);
+}
+
+
 #define Light_TryUnSpreadInto(axis, dir, limit, AXIS, thisFace, thatFace) \
 		if (neighborCoords.axis dir ## = limit && \
 			CanLightPass(thisBlock, FACE_ ## AXIS ## thisFace) && \
@@ -537,16 +728,42 @@ static PackedCol Color_ZSide(int x, int y, int z) {
 
 static void LightHint(int startX, int startY, int startZ) {
 	int cx, cy, cz, chunkIndex;
+	int minCX, minCY, minCZ, maxCX, maxCY, maxCZ;
+	cc_bool calculated = true;
 	ClassicLighting_LightHint(startX, startY, startZ);
-	/* Add 1 to startX/Z, as coordinates are for the extended chunk (18x18x18) */
-	startX++; startY++; startZ++;
 
-	cx = (startX + HALF_CHUNK_SIZE) >> CHUNK_SHIFT;
-	cy = (startY + HALF_CHUNK_SIZE) >> CHUNK_SHIFT;
-	cz = (startZ + HALF_CHUNK_SIZE) >> CHUNK_SHIFT;
+	/* Calculate lighting for every chunk the extended chunk (18x18x18) overlaps, */
+	/*  so that lighting is never lazily calculated while the chunk mesh is built */
+	/*  (chunk meshes may be built on worker threads, where that would be unsafe) */
+	minCX = max(0, startX) >> CHUNK_SHIFT;
+	minCY = max(0, startY) >> CHUNK_SHIFT;
+	minCZ = max(0, startZ) >> CHUNK_SHIFT;
+	maxCX = min(World.ChunksX - 1, (startX + EXTCHUNK_SIZE - 1) >> CHUNK_SHIFT);
+	maxCY = min(World.ChunksY - 1, (startY + EXTCHUNK_SIZE - 1) >> CHUNK_SHIFT);
+	maxCZ = min(World.ChunksZ - 1, (startZ + EXTCHUNK_SIZE - 1) >> CHUNK_SHIFT);
+
+	for (cy = minCY; cy <= maxCY; cy++) {
+		for (cz = minCZ; cz <= maxCZ; cz++) {
+			for (cx = minCX; cx <= maxCX; cx++) {
+				chunkIndex = ChunkCoordsToIndex(cx, cy, cz);
+				calculated &= chunkLightingDataFlags[chunkIndex] == CHUNK_ALL_CALCULATED;
+			}
+		}
+	}
+	if (calculated) return;
+
+	/* Calculate all the chunks at once, so that they can be calculated in parallel */
+	QueueChunksAround(minCX, minCY, minCZ, maxCX, maxCY, maxCZ);
+	CalcQueuedChunks();
 
-	chunkIndex = ChunkCoordsToIndex(cx, cy, cz);
-	CalcForChunkIfNeeded(cx, cy, cz, chunkIndex);
+	for (cy = minCY; cy <= maxCY; cy++) {
+		for (cz = minCZ; cz <= maxCZ; cz++) {
+			for (cx = minCX; cx <= maxCX; cx++) {
+				chunkIndex = ChunkCoordsToIndex(cx, cy, cz);
+				chunkLightingDataFlags[chunkIndex] = CHUNK_ALL_CALCULATED;
+			}
+		}
+	}
 }
 
 void FancyLighting_SetActive(void) {
@@ -578,6 +795,9 @@ static void OnEnvVariableChanged(void* obj, int envVar) {
 	if (envVar == ENV_VAR_LAVALIGHT_COLOR || envVar == ENV_VAR_LAMPLIGHT_COLOR) MapRenderer_Refresh();
 }
 
+static void OnBlockDefChanged(void* obj) { lightPassDirty = true; }
+
 void FancyLighting_OnInit(void) {
 	Event_Register_(&WorldEvents.EnvVarChanged, NULL, OnEnvVariableChanged);
+	Event_Register_(&BlockEvents.BlockDefChanged, NULL, OnBlockDefChanged);
 }
@@ -61,6 +61,10 @@ struct MapImporter* MapImporter_Find(const cc_string* path) {
 	return NULL;
 }
 
+/* Path of the file the current map was loaded from */
+static char loadedPathBuffer[FILENAME_SIZE];
+static cc_string loadedPath = String_FromArray(loadedPathBuffer);
+
 cc_result Map_LoadFrom(const cc_string* path) {
 	cc_string relPath, fileName, fileExt;
 	struct LocationUpdate update = { 0 };
@@ -68,6 +72,7 @@ cc_result Map_LoadFrom(const cc_string* path) {
 	struct Stream stream;
 	cc_result res;
 	Game_Reset();
+	String_Copy(&loadedPath, path);
 	
 	spawn_point = &update;
 	res = Stream_OpenFile(&stream, path);
@@ -96,6 +101,17 @@ cc_result Map_LoadFrom(const cc_string* path) {
 }
 
 
+cc_result Map_ReleaseFile(const cc_string* path) {
+#ifdef CC_BUILD_FILEMAP
+	/* Overwriting the file the map's blocks are memory mapped from would corrupt them */
+	/* NOTE: A truncated path is treated as matching, as it may be the same file */
+	if (loadedPath.length < loadedPath.capacity && !String_CaselessEquals(path, &loadedPath)) return 0;
+	if (!World_CopyMapped()) return ERR_OUT_OF_MEMORY;
+#endif
+	return 0;
+}
+
+
 /*########################################################################################################################*
 *--------------------------------------------------MCSharp level Format---------------------------------------------------*
 *#########################################################################################################################*/
@@ -515,18 +531,25 @@ static BlockRaw* Nbt_TakeArray(struct NbtTag* tag, const char* type) {
 	return ptr;
 }
 
+/* Reads uncompressed NBT data */
+static cc_result Nbt_ReadRaw(struct Stream* stream, Nbt_Callback callback) {
+	cc_result res;
+	cc_uint8 tag;
+
+	if ((res = stream->ReadU8(stream, &tag))) return res;
+	if (tag != NBT_DICT) return CW_ERR_ROOT_TAG;
+	return Nbt_ReadTag(NBT_DICT, true, stream, NULL, callback, 0);
+}
+
+/* Reads GZIP compressed NBT data */
 static cc_result Nbt_Read(struct Stream* stream, Nbt_Callback callback) {
 	struct Stream compStream;
 	struct InflateState state;
 	cc_result res;
-	cc_uint8 tag;
 
 	Inflate_MakeStream2(&compStream, &state, stream);
 	if ((res = Map_SkipGZipHeader(stream))) return res;
-	if ((res = compStream.ReadU8(&compStream, &tag))) return res;
-
-	if (tag != NBT_DICT) return CW_ERR_ROOT_TAG;
-	return Nbt_ReadTag(NBT_DICT, true, &compStream, NULL, callback, 0);
+	return Nbt_ReadRaw(&compStream, callback);
 }
 
 
@@ -878,6 +901,121 @@ static cc_result Cw_Load(struct Stream* stream) {
 }
 
 
+/*########################################################################################################################*
+*--------------------------------------------------Snapshot map format----------------------------------------------------*
+*#########################################################################################################################*/
+/* Snapshot is an uncompressed map format, designed so that maps can be loaded almost instantly.
+	U8[4] "Signature" ("CCSM")
+	U32   "Version"
+	U16   "Width", "Height", "Length"
+	U16   "Reserved"
+	U32   "MetadataOffset", "MetadataLength"
+	U32   "BlocksOffset"
+	U32   "Blocks2Offset" (0 when only 8 bit blocks are used)
+All values are little endian. Metadata is the same as in .cw maps, but uncompressed and without 
+the block arrays. Block arrays are page aligned so they can be memory mapped instead of read.
+*/
+#define SNAP_HEADER_SIZE 32
+#define SNAP_VERSION 1
+#define SNAP_ALIGNMENT 4096
+static const cc_uint8 snap_signature[4] = { 'C','C','S','M' };
+
+/* The dimensions and blocks of the map are only read from the header, */
+/*  so the metadata must not be able to change them */
+static void Snapshot_Callback(struct NbtTag* tag) {
+	if (tag->parent && !tag->parent->parent) {
+		if (IsTag(tag, "X")) { if (NbtTag_U16(tag) != World.Width)  tag->result = SNAP_ERR_DIMENSIONS; return; }
+		if (IsTag(tag, "Y")) { if (NbtTag_U16(tag) != World.Height) tag->result = SNAP_ERR_DIMENSIONS; return; }
+		if (IsTag(tag, "Z")) { if (NbtTag_U16(tag) != World.Length) tag->result = SNAP_ERR_DIMENSIONS; return; }
+		if (IsTag(tag, "BlockArray") || IsTag(tag, "BlockArray2")) return;
+	}
+	Cw_Callback(tag);
+}
+
+static cc_result Snapshot_ReadBlocks(struct Stream* stream, cc_uint32 metaOffset, cc_uint32 metaLength,
+									cc_uint32 blocksOffset, cc_uint32 blocks2Offset) {
+	cc_uint8 buffer[4096];
+	struct Stream portion, meta;
+	cc_result res;
+#ifdef EXTENDED_BLOCKS
+	BlockRaw* blocks2;
+#endif
+
+	if ((res = stream->Seek(stream, metaOffset))) return res;
+	Stream_ReadonlyPortion(&portion, stream, metaLength);
+	Stream_ReadonlyBuffered(&meta, &portion, buffer, sizeof(buffer));
+	if ((res = Nbt_ReadRaw(&meta, Snapshot_Callback))) return res;
+
+	if ((res = stream->Seek(stream, blocksOffset))) return res;
+	if ((res = Map_ReadBlocks(stream)))             return res;
+
+#ifdef EXTENDED_BLOCKS
+	if (!blocks2Offset) return 0;
+	if ((res = stream->Seek(stream, blocks2Offset))) return res;
+
+	blocks2 = (BlockRaw*)Mem_TryAlloc(World.Volume, 1);
+	if (!blocks2) return ERR_OUT_OF_MEMORY;
+
+	World_SetMapUpper(blocks2);
+	return Stream_Read(stream, blocks2, World.Volume);
+#else
+	return 0;
+#endif
+}
+
+static cc_result Snapshot_Load(struct Stream* stream) {
+	cc_uint32 metaOffset, metaLength, blocksOffset, blocks2Offset, length;
+	cc_uint64 volume, end;
+	cc_uint8 header[SNAP_HEADER_SIZE];
+	cc_result res;
+#ifdef CC_BUILD_FILEMAP
+	struct Stream meta;
+	cc_uint8* data;
+#endif
+
+	if ((res = Stream_Read(stream, header, SNAP_HEADER_SIZE))) return res;
+	if (!Mem_Equal(header, snap_signature, sizeof(snap_signature))) return SNAP_ERR_SIGNATURE;
+	if (Stream_GetU32_LE(&header[4]) != SNAP_VERSION) return SNAP_ERR_VERSION;
+
+	World.Width   = Stream_GetU16_LE(&header[8]);
+	World.Height  = Stream_GetU16_LE(&header[10]);
+	World.Length  = Stream_GetU16_LE(&header[12]);
+
+	volume = (cc_uint64)World.Width * World.Height * World.Length;
+	if (!volume || volume > Int32_MaxValue) return SNAP_ERR_DIMENSIONS;
+	World.Volume  = (int)volume;
+
+	metaOffset    = Stream_GetU32_LE(&header[16]);
+	metaLength    = Stream_GetU32_LE(&header[20]);
+	blocksOffset  = Stream_GetU32_LE(&header[24]);
+	blocks2Offset = Stream_GetU32_LE(&header[28]);
+
+	/* Section ends are calculated in 64 bits, so that offsets can't overflow past the end of the file */
+	if ((res = stream->Length(stream, &length))) return res;
+	if ((cc_uint64)metaOffset + metaLength > length) return SNAP_ERR_TRUNCATED;
+
+	end = (cc_uint64)blocksOffset + volume;
+	if (blocks2Offset) end = max(end, (cc_uint64)blocks2Offset + volume);
+	if (end > length) return SNAP_ERR_TRUNCATED;
+
+#ifdef CC_BUILD_FILEMAP
+	/* Memory mapping the file avoids having to read (or even allocate memory for) the blocks, */
+	/*  as the OS only loads each page of the blocks from the file when it is first accessed */
+	if (!Stream_MapFile(stream, (cc_uint32)end, (void**)&data)) {
+		World_SetMapped(data, (cc_uint32)end);
+		World.Blocks = data + blocksOffset;
+#ifdef EXTENDED_BLOCKS
+		if (blocks2Offset) World_SetMapUpper(data + blocks2Offset);
+#endif
+
+		Stream_ReadonlyMemory(&meta, data + metaOffset, metaLength);
+		return Nbt_ReadRaw(&meta, Snapshot_Callback);
+	}
+#endif
+	return Snapshot_ReadBlocks(stream, metaOffset, metaLength, blocksOffset, blocks2Offset);
+}
+
+
 /*########################################################################################################################*
 *-----------------------------------------------Java serialisation format-------------------------------------------------*
 *#########################################################################################################################*/
@@ -1482,6 +1620,18 @@ static cc_result MCLevel_Load(struct Stream* stream) {
 }
 
 
+/*########################################################################################################################*
+*-------------------------------------------------------Map export--------------------------------------------------------*
+*#########################################################################################################################*/
+/* Writes the lower (shift of 0) or upper (shift of 8) 8 bits of all the blocks in the world */
+static cc_result Map_WriteBlocks(struct Stream* stream, int shift) {
+#ifdef EXTENDED_BLOCKS
+	if (shift) return Stream_Write(stream, World.Blocks2, World.Volume);
+#endif
+	return Stream_Write(stream, World.Blocks, World.Volume);
+}
+
+
 /*########################################################################################################################*
 *--------------------------------------------------ClassicWorld export----------------------------------------------------*
 *#########################################################################################################################*/
@@ -1570,7 +1720,8 @@ static cc_result Cw_WriteBockDef(struct Stream* stream, int b) {
 	return Stream_Write(stream, buffer, (int)(cur - buffer));
 }
 
-cc_result Cw_Save(struct Stream* stream) {
+/* Writes the world as ClassicWorld NBT, optionally excluding the block arrays */
+static cc_result Cw_WriteWorld(struct Stream* stream, cc_bool withBlocks) {
 	struct LocalPlayer* p = Entities.CurPlayer;
 	cc_uint8 buffer[2048];
 	cc_uint8* cur;
@@ -1600,18 +1751,23 @@ cc_result Cw_Save(struct Stream* stream) {
 		cur  = Nbt_WriteUInt8(cur,  "H", Math_Deg2Packed(p->SpawnYaw));
 		cur  = Nbt_WriteUInt8(cur,  "P", Math_Deg2Packed(p->SpawnPitch));
 	} *cur++ = NBT_END;
-	cur = Nbt_WriteArray(cur, "BlockArray", World.Volume);
-
 	if ((res = Stream_Write(stream, buffer, (int)(cur - buffer)))) return res;
-	if ((res = Stream_Write(stream, World.Blocks, World.Volume)))  return res;
+
+	if (withBlocks) {
+		cur = buffer;
+		cur = Nbt_WriteArray(cur, "BlockArray", World.Volume);
+
+		if ((res = Stream_Write(stream, buffer, (int)(cur - buffer)))) return res;
+		if ((res = Map_WriteBlocks(stream, 0))) return res;
+	}
 
 #ifdef EXTENDED_BLOCKS
-	if (World.Blocks != World.Blocks2) {
+	if (withBlocks && World.IDMask > 0xFF) {
 		cur = buffer;
 		cur = Nbt_WriteArray(cur, "BlockArray2", World.Volume);
 
 		if ((res = Stream_Write(stream, buffer, (int)(cur - buffer)))) return res;
-		if ((res = Stream_Write(stream, World.Blocks2, World.Volume))) return res;
+		if ((res = Map_WriteBlocks(stream, 8))) return res;
 	}
 #endif
 
@@ -1677,6 +1833,60 @@ cc_result Cw_Save(struct Stream* stream) {
 	return Stream_Write(stream, cw_end, sizeof(cw_end));
 }
 
+cc_result Cw_Save(struct Stream* stream) {
+	return Cw_WriteWorld(stream, true);
+}
+
+
+/*########################################################################################################################*
+*----------------------------------------------------Snapshot export------------------------------------------------------*
+*#########################################################################################################################*/
+static const cc_uint8 snap_padding[SNAP_ALIGNMENT];
+
+/* Pads the stream so that the next data written is aligned to a page boundary */
+static cc_result Snapshot_Align(struct Stream* stream, cc_uint32* offset) {
+	cc_uint32 position;
+	cc_result res;
+	if ((res = stream->Position(stream, &position))) return res;
+
+	*offset = (position + (SNAP_ALIGNMENT - 1)) & ~(SNAP_ALIGNMENT - 1);
+	return Stream_Write(stream, snap_padding, *offset - position);
+}
+
+cc_result Snapshot_Save(struct Stream* stream) {
+	cc_uint8 header[SNAP_HEADER_SIZE] = { 0 };
+	cc_uint32 metaLength, blocksOffset, blocks2Offset = 0;
+	cc_result res;
+
+	/* Header is only written once the offsets of all the sections are known */
+	if ((res = Stream_Write(stream, header, SNAP_HEADER_SIZE))) return res;
+	if ((res = Cw_WriteWorld(stream, false)))                   return res;
+	if ((res = stream->Position(stream, &metaLength)))          return res;
+	metaLength -= SNAP_HEADER_SIZE;
+
+	if ((res = Snapshot_Align(stream, &blocksOffset))) return res;
+	if ((res = Map_WriteBlocks(stream, 0)))            return res;
+#ifdef EXTENDED_BLOCKS
+	if (World.IDMask > 0xFF) {
+		if ((res = Snapshot_Align(stream, &blocks2Offset))) return res;
+		if ((res = Map_WriteBlocks(stream, 8)))             return res;
+	}
+#endif
+
+	Mem_Copy(header, snap_signature, sizeof(snap_signature));
+	Stream_SetU32_LE(&header[4],  SNAP_VERSION);
+	Stream_SetU16_LE(&header[8],  World.Width);
+	Stream_SetU16_LE(&header[10], World.Height);
+	Stream_SetU16_LE(&header[12], World.Length);
+	Stream_SetU32_LE(&header[16], SNAP_HEADER_SIZE);
+	Stream_SetU32_LE(&header[20], metaLength);
+	Stream_SetU32_LE(&header[24], blocksOffset);
+	Stream_SetU32_LE(&header[28], blocks2Offset);
+
+	if ((res = stream->Seek(stream, 0))) return res;
+	return Stream_Write(stream, header, SNAP_HEADER_SIZE);
+}
+
 
 /*########################################################################################################################*
 *---------------------------------------------------Schematic export------------------------------------------------------*
@@ -1711,7 +1921,7 @@ cc_result Schematic_Save(struct Stream* stream) {
 		Stream_SetU32_BE(&tmp[74], World.Volume);
 	}
 	if ((res = Stream_Write(stream, tmp, sizeof(sc_begin)))) return res;
-	if ((res = Stream_Write(stream, World.Blocks, World.Volume))) return res;
+	if ((res = Map_WriteBlocks(stream, 0))) return res;
 
 	Mem_Copy(tmp, sc_data, sizeof(sc_data));
 	{
@@ -1865,6 +2075,7 @@ static struct MapImporter lvl_imp   = { ".lvl",     Lvl_Load };
 static struct MapImporter mine_imp  = { ".mine",    Dat_Load };
 static struct MapImporter fcm_imp   = { ".fcm",     Fcm_Load };
 static struct MapImporter mclvl_imp = { ".mclevel", MCLevel_Load };
+static struct MapImporter snap_imp  = { ".ccmap",   Snapshot_Load };
 
 static void OnInit(void) {
 	MapImporter_Register(&cw_imp);
@@ -1873,6 +2084,7 @@ static void OnInit(void) {
 	MapImporter_Register(&mine_imp);
 	MapImporter_Register(&fcm_imp);
 	MapImporter_Register(&mclvl_imp);
+	MapImporter_Register(&snap_imp);
 }
 
 static void OnFree(void) {
@@ -1882,10 +2094,12 @@ static void OnFree(void) {
 /* No point including map format code when can't save/load maps anyways */
 struct MapImporter* MapImporter_Find(const cc_string* path) { return NULL; }
 cc_result Map_LoadFrom(const cc_string* path) { return ERR_NOT_SUPPORTED; }
+cc_result Map_ReleaseFile(const cc_string* path) { return 0; }
 
 cc_result Cw_Save(struct Stream* stream)  { return ERR_NOT_SUPPORTED; }
 cc_result Dat_Save(struct Stream* stream) { return ERR_NOT_SUPPORTED; }
 cc_result Schematic_Save(struct Stream* stream) { return ERR_NOT_SUPPORTED; }
+cc_result Snapshot_Save(struct Stream* stream)  { return ERR_NOT_SUPPORTED; }
 
 static void OnInit(void) { }
 static void OnFree(void) { }
@@ -28,6 +28,9 @@ CC_API void MapImporter_Register(struct MapImporter* imp);
 CC_API struct MapImporter* MapImporter_Find(const cc_string* path);
 /* Attempts to import a map from the given file */
 CC_API cc_result Map_LoadFrom(const cc_string* path);
+/* Ensures the current map does not depend on the given file, so that it can be overwritten */
+/* (i.e. copies the blocks out of the file, if they were memory mapped from it) */
+cc_result Map_ReleaseFile(const cc_string* path);
 
 /* Exports a world to a .cw ClassicWorld map file. */
 /* Compatible with ClassiCube/ClassicalSharp */
@@ -38,6 +41,10 @@ cc_result Schematic_Save(struct Stream* stream);
 /* Exports a world to a .dat Classic map file */
 /* Used by MineCraft Classic */
 cc_result Dat_Save(struct Stream* stream);
+/* Exports a world to a .ccmap snapshot map file */
+/* Snapshots are uncompressed, so are larger but load much faster than .cw maps */
+/* NOTE: The stream must support seeking, and must NOT be compressed */
+cc_result Snapshot_Save(struct Stream* stream);
 
 CC_END_HEADER
 #endif
@@ -41,6 +41,7 @@
 #include "SystemFonts.h"
 #include "Formats.h"
 #include "EntityRenderers.h"
+#include "Benchmark.h"
 
 struct _GameData Game;
 static cc_uint64 frameStart;
@@ -464,6 +465,7 @@ static void Game_Load(void) {
 	Game_AddComponent(&AxisLinesRenderer_Component);
 	Game_AddComponent(&Formats_Component);
 	Game_AddComponent(&EntityRenderers_Component);
+	Game_AddComponent(&Benchmark_Component);
 
 	LoadPlugins();
 	for (comp = comps_head; comp; comp = comp->next) {
@@ -7,6 +7,15 @@
 #include "Utils.h"
 #include "Game.h"
 #include "Window.h"
+#include "Options.h"
+
+/* SSE2 is always available on x86_64, so rows of noise can be calculated 4 samples at a time */
+#if !defined GEN_DISABLE_SIMD
+	#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+		#define GEN_SIMD_SSE2
+		#include <emmintrin.h>
+	#endif
+#endif
 
 const struct MapGenerator* Gen_Active;
 BlockRaw* Gen_Blocks;
@@ -27,6 +36,14 @@ volatile cc_bool gen_done;
 /*   To avoid that, on these systems, map generation may be divided into */
 /*     a series of steps so that ClassiCube can periodically switch back */
 /*     to the game thread to ensure that the game itself still (slowly) runs. */
+
+/* Stages of map generation that only depend on each column can be divided into stripes, */
+/*   which may then be processed in parallel by a pool of worker threads. */
+/* NOTE: A stripe must never touch blocks that another stripe reads or writes, */
+/*   so that the generated map is identical regardless of how many threads are used */
+/* NOTE: Only the map gen thread may update Gen_CurrentProgress (see Gen_IsGenThread) */
+typedef void (*Gen_StripeFunc)(int stripe, int thread);
+
 #ifdef CC_BUILD_COOPTHREADED
 static int gen_step;
 static cc_uint64 lastRender;
@@ -57,6 +74,15 @@ cc_bool Gen_IsDone(void) {
 	if (!gen_done) Gen_Active->Generate();
 	return gen_done;
 }
+
+static void Gen_StopWorkers(void)  { }
+static int  Gen_ThreadsCount(void) { return 1; }
+static cc_bool Gen_IsGenThread(int thread) { return true; }
+
+static void Gen_RunStripes(Gen_StripeFunc func, int count) {
+	int i;
+	for (i = 0; i < count; i++) func(i, 0);
+}
 #else
 /* For systems supporting preemptive threading, there's no point */
 /* bothering with all the cooperative tasking shenanigans */
@@ -64,17 +90,36 @@ cc_bool Gen_IsDone(void) {
 #define GEN_COOP_STEP(index, step) step;
 #define GEN_COOP_END
 
+#define GEN_MAX_THREADS WORKERPOOL_MAX_THREADS
+static void Gen_WorkerMain(void);
+static struct WorkerPool genPool = { Gen_WorkerMain, "Map gen worker", 64 * 1024 };
+static void Gen_WorkerMain(void) { WorkerPool_WorkerMain(&genPool); }
+
 static void Gen_DoGen(void) {
 	Gen_Active->Generate();
 }
 
 static void Gen_Run(void) {
 	void* thread;
+	genPool.threads = Options_GetInt(OPT_GEN_THREADS, 0, GEN_MAX_THREADS, 0);
+
 	Thread_Run(&thread, Gen_DoGen, 128 * 1024, "Map gen");
 	Thread_Detach(thread);
 }
 
 cc_bool Gen_IsDone(void) { return gen_done; }
+
+static void Gen_StopWorkers(void) { WorkerPool_Stop(&genPool); }
+
+/* Number of threads (including the map gen thread) that process stripes */
+static int Gen_ThreadsCount(void) { return genPool.threads + 1; }
+/* Whether the given stripe thread is the map gen thread itself (rather than a worker) */
+static cc_bool Gen_IsGenThread(int thread) { return thread == genPool.count; }
+
+/* Calls func for every stripe from 0 to count, then waits for all of them to finish */
+static void Gen_RunStripes(Gen_StripeFunc func, int count) {
+	WorkerPool_Run(&genPool, func, count);
+}
 #endif
 
 static void Gen_Reset(void) {
@@ -226,9 +271,119 @@ static void CombinedNoise_Init(struct CombinedNoise* n, RNGState* rnd, int octav
 	OctaveNoise_Init(&n->noise2, rnd, octaves2);
 }
 
-static float CombinedNoise_Calc(const struct CombinedNoise* n, float x, float y) {
-	float offset = OctaveNoise_Calc(&n->noise2, x, y);
-	return OctaveNoise_Calc(&n->noise1, x + offset, y);
+
+/* Row versions of the noise functions calculate noise for up to NOISE_ROW_SIZE samples */
+/*  that share the same y coordinate, which avoids redundantly calculating the y terms */
+/* NOTE: These perform exactly the same floating point operations as the functions above */
+/*  (in the same order), so the results are always identical to calculating each sample */
+#if CC_BUILD_MAXSTACK <= (16 * 1024)
+	#define NOISE_ROW_SIZE 16
+#else
+	#define NOISE_ROW_SIZE 64
+#endif
+
+#ifdef GEN_SIMD_SSE2
+static float gradX[16], gradY[16];
+
+static void ImprovedNoise_InitGrads(void) {
+	int hash;
+	for (hash = 0; hash < 16; hash++) {
+		gradX[hash] = (float)(((X_FLAGS >> (hash << 1)) & 3) - 1);
+		gradY[hash] = (float)(((Y_FLAGS >> (hash << 1)) & 3) - 1);
+	}
+}
+
+#define Grad_SSE2(hashes, x, y) _mm_add_ps( \
+	_mm_mul_ps(_mm_setr_ps(gradX[hashes[0]], gradX[hashes[1]], gradX[hashes[2]], gradX[hashes[3]]), x), \
+	_mm_mul_ps(_mm_setr_ps(gradY[hashes[0]], gradY[hashes[1]], gradY[hashes[2]], gradY[hashes[3]]), y))
+
+/* Adds noise for 4 samples at xs * freq multiplied by amplitude to sums */
+static void ImprovedNoise_Calc4(const cc_uint8* p, const float* xs, float* sums,
+								__m128 freq, __m128 amplitude, int Y, float yFrac, float v) {
+	int xFloors[4];
+	int h22[4], h12[4], h21[4], h11[4];
+	__m128 x, u, y0, y1, x1;
+	__m128 g22, g12, g21, g11, c1, c2, res;
+	__m128i xFloor;
+	int i, X, A, B;
+
+	x      = _mm_mul_ps(_mm_loadu_ps(xs), freq);
+	/* xFloor = x >= 0 ? (int)x : (int)x - 1 (comparison mask is -1 for x < 0) */
+	xFloor = _mm_cvttps_epi32(x);
+	xFloor = _mm_add_epi32(xFloor, _mm_castps_si128(_mm_cmplt_ps(x, _mm_setzero_ps())));
+	x      = _mm_sub_ps(x, _mm_cvtepi32_ps(xFloor));
+
+	/* Fade(x) */
+	u = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(x, x), x), 
+		_mm_add_ps(_mm_mul_ps(x, _mm_sub_ps(_mm_mul_ps(x, _mm_set1_ps(6)), _mm_set1_ps(15))), _mm_set1_ps(10)));
+
+	/* Permutation table lookups can't be vectorised with SSE2 */
+	_mm_storeu_si128((__m128i*)xFloors, xFloor);
+	for (i = 0; i < 4; i++) {
+		X = xFloors[i] & 0xFF;
+		A = p[X] + Y; B = p[X + 1] + Y;
+
+		h22[i] = p[p[A]]     & 0xF;
+		h12[i] = p[p[B]]     & 0xF;
+		h21[i] = p[p[A + 1]] & 0xF;
+		h11[i] = p[p[B + 1]] & 0xF;
+	}
+
+	y0 = _mm_set1_ps(yFrac);
+	y1 = _mm_set1_ps(yFrac - 1);
+	x1 = _mm_sub_ps(x, _mm_set1_ps(1));
+
+	g22 = Grad_SSE2(h22, x,  y0);
+	g12 = Grad_SSE2(h12, x1, y0);
+	c1  = _mm_add_ps(g22, _mm_mul_ps(u, _mm_sub_ps(g12, g22)));
+
+	g21 = Grad_SSE2(h21, x,  y1);
+	g11 = Grad_SSE2(h11, x1, y1);
+	c2  = _mm_add_ps(g21, _mm_mul_ps(u, _mm_sub_ps(g11, g21)));
+
+	res = _mm_add_ps(c1, _mm_mul_ps(_mm_set1_ps(v), _mm_sub_ps(c2, c1)));
+	_mm_storeu_ps(sums, _mm_add_ps(_mm_loadu_ps(sums), _mm_mul_ps(res, amplitude)));
+}
+#endif
+
+/* Adds noise for each sample at (xs[i] * freq, y) multiplied by amplitude to sums[i] */
+static void ImprovedNoise_CalcRow(const cc_uint8* p, const float* xs, float freq, float y,
+								float amplitude, float* sums, int count) {
+	int i = 0;
+#ifdef GEN_SIMD_SSE2
+	int yFloor = y >= 0 ? (int)y : (int)y - 1;
+	float yFrac = y - yFloor;
+	float v     = yFrac * yFrac * yFrac * (yFrac * (yFrac * 6 - 15) + 10); /* Fade(y) */
+	__m128 freq4 = _mm_set1_ps(freq), amp4 = _mm_set1_ps(amplitude);
+
+	for (; i + 4 <= count; i += 4) {
+		ImprovedNoise_Calc4(p, xs + i, sums + i, freq4, amp4, yFloor & 0xFF, yFrac, v);
+	}
+#endif
+	for (; i < count; i++) {
+		sums[i] += ImprovedNoise_Calc(p, xs[i] * freq, y) * amplitude;
+	}
+}
+
+static void OctaveNoise_CalcRow(const struct OctaveNoise* n, const float* xs, float y, float* sums, int count) {
+	float amplitude = 1, freq = 1;
+	int i;
+	for (i = 0; i < count; i++) sums[i] = 0;
+
+	for (i = 0; i < n->octaves; i++) {
+		ImprovedNoise_CalcRow(n->p[i], xs, freq, y * freq, amplitude, sums, count);
+		amplitude *= 2.0f;
+		freq *= 0.5f;
+	}
+}
+
+static void CombinedNoise_CalcRow(const struct CombinedNoise* n, const float* xs, float y, float* values, int count) {
+	float offsets[NOISE_ROW_SIZE];
+	int i;
+	OctaveNoise_CalcRow(&n->noise2, xs, y, offsets, count);
+
+	for (i = 0; i < count; i++) offsets[i] += xs[i];
+	OctaveNoise_CalcRow(&n->noise1, offsets, y, values, count);
 }
 
 
@@ -239,6 +394,10 @@ static int waterLevel, minHeight;
 static cc_int16* heightmap;
 static RNGState rnd;
 
+/* Column stages process the map in stripes of this many rows along the Z axis */
+#define GEN_STRIPE_ROWS 16
+#define GEN_STRIPES_COUNT ((World.Length + (GEN_STRIPE_ROWS - 1)) / GEN_STRIPE_ROWS)
+
 static void NotchyGen_FillOblateSpheroid(int x, int y, int z, float radius, BlockRaw block) {
 	int xBeg = Math_Floor(max(x - radius, 0));
 	int xEnd = Math_Floor(min(x + radius, World.MaxX));
@@ -271,46 +430,162 @@ static void NotchyGen_FillOblateSpheroid(int x, int y, int z, float radius, Bloc
 	#define STACK_FAST 8192
 #endif
 
-static void NotchyGen_FloodFill(int index, BlockRaw block) {
-	int* stack;
-	int stack_default[STACK_FAST]; /* avoid allocating memory if possible */
-	int count = 0, limit = STACK_FAST;
-	int x, y, z;
+/* Flood fill works on runs of air along the X axis. Each run is filled all at once, */
+/*  then only the start of each run of air in the neighbouring rows is pushed to the stack */
+/* NOTE: Flooding spreads horizontally and downwards, but never upwards */
+struct FloodFill {
+	int stack[STACK_FAST];
+	int count;
+	cc_bool overflowed;
+	int minY, maxY, minZ, maxZ; /* Bounds of the rows that have been filled */
+	BlockRaw block;
+};
 
-	stack = stack_default;
-	if (index < 0) return; /* y below map, don't bother starting */
-	stack[count++] = index;
+/* Pushes the start of each run of air in the given row between x1 and x2 */
+static void FloodFill_PushRuns(struct FloodFill* f, int row, int x1, int x2) {
+	int x;
+	for (x = x1; x <= x2; x++) {
+		if (Gen_Blocks[row + x] != BLOCK_AIR) continue;
+		if (x > x1 && Gen_Blocks[row + x - 1] == BLOCK_AIR) continue;
 
-	while (count) {
-		index = stack[--count];
+		/* Rather than allocating more memory, remember to search for the run later */
+		if (f->count == STACK_FAST) { f->overflowed = true; continue; }
+		f->stack[f->count++] = row + x;
+	}
+}
 
+static void FloodFill_Run(struct FloodFill* f, int index) {
+	int width = World.Width, oneY = World.OneY;
+	int x, y, z, x1, x2, row, rem;
+	f->stack[f->count++] = index;
+
+	while (f->count) {
+		index = f->stack[--f->count];
 		if (Gen_Blocks[index] != BLOCK_AIR) continue;
-		Gen_Blocks[index] = block;
 
-		x = index  % World.Width;
-		y = index  / World.OneY;
-		z = (index / World.Width) % World.Length;
+		y   = index / oneY;
+		rem = index - y * oneY;
+		z   = rem / width;
+		x   = rem - z * width;
+		row = index - x;
 
-		/* need to increase stack */
-		if (count >= limit - FACE_COUNT) {
-			Utils_Resize((void**)&stack, &limit, 4, STACK_FAST, STACK_FAST);
-		}
+		for (x1 = x; x1 > 0          && Gen_Blocks[row + x1 - 1] == BLOCK_AIR; x1--) { }
+		for (x2 = x; x2 < World.MaxX && Gen_Blocks[row + x2 + 1] == BLOCK_AIR; x2++) { }
+		Mem_Set(Gen_Blocks + row + x1, f->block, x2 - x1 + 1);
+
+		f->minY = min(f->minY, y); f->maxY = max(f->maxY, y);
+		f->minZ = min(f->minZ, z); f->maxZ = max(f->maxZ, z);
+
+		if (z > 0)          FloodFill_PushRuns(f, row - width, x1, x2);
+		if (z < World.MaxZ) FloodFill_PushRuns(f, row + width, x1, x2);
+		if (y > 0)          FloodFill_PushRuns(f, row - oneY,  x1, x2);
+	}
+}
+
+/* Whether air at the given coordinates would be flooded by a neighbouring block */
+static cc_bool FloodFill_IsFlooded(struct FloodFill* f, int index, int x, int y, int z) {
+	BlockRaw block = f->block;
+	return 
+		(x > 0          && Gen_Blocks[index - 1]           == block) ||
+		(x < World.MaxX && Gen_Blocks[index + 1]           == block) ||
+		(z > 0          && Gen_Blocks[index - World.Width] == block) ||
+		(z < World.MaxZ && Gen_Blocks[index + World.Width] == block) ||
+		(y < World.MaxY && Gen_Blocks[index + World.OneY]  == block);
+}
+
+/* Searches the filled area for any air that would have been flooded */
+/* NOTE: Every other area of the same block was completely flooded, so any */
+/*  air that would be flooded must be next to this flood fill's blocks */
+static void FloodFill_Search(struct FloodFill* f) {
+	int yBeg = max(f->minY - 1, 0), yEnd = f->maxY;
+	int zBeg = max(f->minZ - 1, 0), zEnd = min(f->maxZ + 1, World.MaxZ);
+	int x, y, z, index;
+	f->overflowed = false;
 
-		if (x > 0)          { stack[count++] = index - 1; }
-		if (x < World.MaxX) { stack[count++] = index + 1; }
-		if (z > 0)          { stack[count++] = index - World.Width; }
-		if (z < World.MaxZ) { stack[count++] = index + World.Width; }
-		if (y > 0)          { stack[count++] = index - World.OneY; }
+	for (y = yBeg; y <= yEnd; y++) {
+		for (z = zBeg; z <= zEnd; z++) {
+			index = World_Pack(0, y, z);
+
+			for (x = 0; x < World.Width; x++, index++) {
+				if (Gen_Blocks[index] != BLOCK_AIR) continue;
+				if (FloodFill_IsFlooded(f, index, x, y, z)) FloodFill_Run(f, index);
+			}
+		}
 	}
-	if (limit > STACK_FAST) Mem_Free(stack);
 }
 
+static void NotchyGen_FloodFill(int index, BlockRaw block) {
+	struct FloodFill f;
+	if (index < 0) return; /* y below map, don't bother starting */
 
-static void NotchyGen_CreateHeightmap(void) {
+	f.count = 0;
+	f.overflowed = false;
+	f.minY  = World.Height; f.maxY = -1;
+	f.minZ  = World.Length; f.maxZ = -1;
+	f.block = block;
+
+	FloodFill_Run(&f, index);
+	while (f.overflowed) FloodFill_Search(&f);
+}
+
+
+static const struct CombinedNoise* heightNoise1;
+static const struct CombinedNoise* heightNoise2;
+static const struct OctaveNoise*   heightNoise3;
+
+/* Calculates the heights of a row of up to NOISE_ROW_SIZE columns */
+static void NotchyGen_HeightmapRow(int x1, int z, int count) {
+	/* Zeroed only to stop compilers warning about possibly uninitialised use */
+	float xs[NOISE_ROW_SIZE] = { 0 }, cols[NOISE_ROW_SIZE] = { 0 }, highXs[NOISE_ROW_SIZE] = { 0 };
+	float lows[NOISE_ROW_SIZE], highs[NOISE_ROW_SIZE], selects[NOISE_ROW_SIZE];
 	float hLow, hHigh, height;
-	int hIndex = 0, adjHeight;
+	int hIndex = z * World.Width + x1;
+	int i, j, highCount = 0;
+
+	for (i = 0; i < count; i++) {
+		xs[i]   = (x1 + i) * 1.3f;
+		cols[i] = (float)(x1 + i);
+	}
+	CombinedNoise_CalcRow(heightNoise1, xs,   z * 1.3f, lows,    count);
+	OctaveNoise_CalcRow(heightNoise3,   cols, (float)z, selects, count);
+
+	/* High noise is only needed by some columns */
+	for (i = 0; i < count; i++) {
+		if (selects[i] <= 0) highXs[highCount++] = xs[i];
+	}
+	CombinedNoise_CalcRow(heightNoise2, highXs, z * 1.3f, highs, highCount);
+
+	for (i = 0, j = 0; i < count; i++) {
+		hLow   = lows[i] / 6 - 4;
+		height = hLow;
+
+		if (selects[i] <= 0) {
+			hHigh  = highs[j++] / 5 + 6;
+			height = max(hLow, hHigh);
+		}
+
+		height *= 0.5f;
+		if (height < 0) height *= 0.8f;
+		heightmap[hIndex++] = (int)(height + waterLevel);
+	}
+}
+
+static void NotchyGen_HeightmapStripe(int stripe, int thread) {
+	int zBeg = stripe * GEN_STRIPE_ROWS;
+	int zEnd = min(zBeg + GEN_STRIPE_ROWS, World.Length);
 	int x, z;
 
+	if (Gen_IsGenThread(thread)) Gen_CurrentProgress = (float)zBeg / World.Length;
+	for (z = zBeg; z < zEnd; z++) {
+		for (x = 0; x < World.Width; x += NOISE_ROW_SIZE) {
+			NotchyGen_HeightmapRow(x, z, min(NOISE_ROW_SIZE, World.Width - x));
+		}
+	}
+}
+
+static void NotchyGen_CreateHeightmap(void) {
+	int i, count = World.Width * World.Length;
+
 #if CC_BUILD_MAXSTACK <= (16 * 1024)
 	struct NoiseBuffer { 
 		struct CombinedNoise n1, n2;
@@ -330,26 +605,13 @@ static void NotchyGen_CreateHeightmap(void) {
 	CombinedNoise_Init(n2, &rnd, 8, 8);	
 	OctaveNoise_Init(n3,   &rnd, 6);
 
-	Gen_CurrentState = "Building heightmap";
-	for (z = 0; z < World.Length; z++) {
-		Gen_CurrentProgress = (float)z / World.Length;
-
-		for (x = 0; x < World.Width; x++) {
-			hLow   = CombinedNoise_Calc(n1, x * 1.3f, z * 1.3f) / 6 - 4;
-			height = hLow;
-
-			if (OctaveNoise_Calc(n3, (float)x, (float)z) <= 0) {
-				hHigh = CombinedNoise_Calc(n2, x * 1.3f, z * 1.3f) / 5 + 6;
-				height = max(hLow, hHigh);
-			}
+	heightNoise1 = n1; heightNoise2 = n2; heightNoise3 = n3;
 
-			height *= 0.5f;
-			if (height < 0) height *= 0.8f;
+	Gen_CurrentState = "Building heightmap";
+	Gen_RunStripes(NotchyGen_HeightmapStripe, GEN_STRIPES_COUNT);
 
-			adjHeight = (int)(height + waterLevel);
-			minHeight = min(adjHeight, minHeight);
-			heightmap[hIndex++] = adjHeight;
-		}
+	for (i = 0; i < count; i++) {
+		minHeight = min(heightmap[i], minHeight);
 	}
 }
 
@@ -382,23 +644,30 @@ static int NotchyGen_CreateStrataFast(void) {
 	return max(stoneHeight, 1);
 }
 
-static void NotchyGen_CreateStrata(void) {
-	int dirtThickness, dirtHeight;
-	int minStoneY, stoneHeight;
-	int hIndex = 0, maxY = World.MaxY, index = 0;
-	int x, y, z;
-	struct OctaveNoise n;
-
-	/* Try to bulk fill bottom of the map if possible */
-	minStoneY = NotchyGen_CreateStrataFast();
-	OctaveNoise_Init(&n, &rnd, 8);
-
-	Gen_CurrentState = "Creating strata";
-	for (z = 0; z < World.Length; z++) {
-		Gen_CurrentProgress = (float)z / World.Length;
+static const struct OctaveNoise* strataNoise;
+static int strataMinY;
 
+static void NotchyGen_StrataStripe(int stripe, int thread) {
+	int dirtThickness, dirtHeight;
+	int minStoneY = strataMinY, stoneHeight;
+	int zBeg = stripe * GEN_STRIPE_ROWS;
+	int zEnd = min(zBeg + GEN_STRIPE_ROWS, World.Length);
+	int hIndex = zBeg * World.Width, maxY = World.MaxY, index = 0;
+	float cols[NOISE_ROW_SIZE], noise[NOISE_ROW_SIZE];
+	int i, j, count, x, y, z;
+
+	if (Gen_IsGenThread(thread)) Gen_CurrentProgress = (float)zBeg / World.Length;
+	for (z = zBeg; z < zEnd; z++) {
 		for (x = 0; x < World.Width; x++) {
-			dirtThickness = (int)(OctaveNoise_Calc(&n, (float)x, (float)z) / 24 - 4);
+			/* Calculate the noise for the next row of columns */
+			i = x % NOISE_ROW_SIZE;
+			if (i == 0) {
+				count = min(NOISE_ROW_SIZE, World.Width - x);
+				for (j = 0; j < count; j++) cols[j] = (float)(x + j);
+				OctaveNoise_CalcRow(strataNoise, cols, (float)z, noise, count);
+			}
+
+			dirtThickness = (int)(noise[i] / 24 - 4);
 			dirtHeight    = heightmap[hIndex++];
 			stoneHeight   = dirtHeight + dirtThickness;
 
@@ -419,6 +688,18 @@ static void NotchyGen_CreateStrata(void) {
 	}
 }
 
+static void NotchyGen_CreateStrata(void) {
+	struct OctaveNoise n;
+
+	/* Try to bulk fill bottom of the map if possible */
+	strataMinY = NotchyGen_CreateStrataFast();
+	OctaveNoise_Init(&n, &rnd, 8);
+	strataNoise = &n;
+
+	Gen_CurrentState = "Creating strata";
+	Gen_RunStripes(NotchyGen_StrataStripe, GEN_STRIPES_COUNT);
+}
+
 static void NotchyGen_CarveCaves(void) {
 	int cavesCount, caveLen;
 	float caveX, caveY, caveZ;
@@ -559,19 +840,18 @@ static void NotchyGen_FloodFillLava(void) {
 	}
 }
 
-static void NotchyGen_CreateSurfaceLayer(void) {	
-	int hIndex = 0, index;
+static const struct OctaveNoise* surfaceNoise1;
+static const struct OctaveNoise* surfaceNoise2;
+
+static void NotchyGen_SurfaceStripe(int stripe, int thread) {
+	int zBeg = stripe * GEN_STRIPE_ROWS;
+	int zEnd = min(zBeg + GEN_STRIPE_ROWS, World.Length);
+	int hIndex = zBeg * World.Width, index;
 	BlockRaw above;
 	int x, y, z;
-	struct OctaveNoise n1, n2;
-
-	OctaveNoise_Init(&n1, &rnd, 8);
-	OctaveNoise_Init(&n2, &rnd, 8);
-
-	Gen_CurrentState = "Creating surface";
-	for (z = 0; z < World.Length; z++) {
-		Gen_CurrentProgress = (float)z / World.Length;
 
+	if (Gen_IsGenThread(thread)) Gen_CurrentProgress = (float)zBeg / World.Length;
+	for (z = zBeg; z < zEnd; z++) {
 		for (x = 0; x < World.Width; x++) {
 			y = heightmap[hIndex++];
 			if (y < 0 || y >= World.Height) continue;
@@ -580,15 +860,83 @@ static void NotchyGen_CreateSurfaceLayer(void) {
 			above = y >= World.MaxY ? BLOCK_AIR : Gen_Blocks[index + World.OneY];
 
 			/* TODO: update heightmap */
-			if (above == BLOCK_STILL_WATER && (OctaveNoise_Calc(&n2, (float)x, (float)z) > 12)) {
+			if (above == BLOCK_STILL_WATER && (OctaveNoise_Calc(surfaceNoise2, (float)x, (float)z) > 12)) {
 				Gen_Blocks[index] = BLOCK_GRAVEL;
 			} else if (above == BLOCK_AIR) {
-				Gen_Blocks[index] = (y <= waterLevel && (OctaveNoise_Calc(&n1, (float)x, (float)z) > 8)) ? BLOCK_SAND : BLOCK_GRASS;
+				Gen_Blocks[index] = (y <= waterLevel && (OctaveNoise_Calc(surfaceNoise1, (float)x, (float)z) > 8)) ? BLOCK_SAND : BLOCK_GRASS;
 			}
 		}
 	}
 }
 
+static void NotchyGen_CreateSurfaceLayer(void) {
+	struct OctaveNoise n1, n2;
+
+	OctaveNoise_Init(&n1, &rnd, 8);
+	OctaveNoise_Init(&n2, &rnd, 8);
+	surfaceNoise1 = &n1; surfaceNoise2 = &n2;
+
+	Gen_CurrentState = "Creating surface";
+	Gen_RunStripes(NotchyGen_SurfaceStripe, GEN_STRIPES_COUNT);
+}
+
+/* Flowers and mushrooms are planted in batches. Plant positions are randomly generated */
+/*  in order on the map gen thread, and then the plants are placed in parallel, */
+/*  with each stripe only placing plants within its own range of the map */
+/* NOTE: Plants never change the ground blocks, so only the order of plants in the same */
+/*  position matters - which is preserved since a position always belongs to one stripe */
+#define GEN_PLANTS_BATCH 16384
+static int* plantIndices;
+static BlockRaw* plantBlocks;
+static int plantsCount;
+static BlockRaw plantGround;
+
+static void NotchyGen_PlantsStripe(int stripe, int thread) {
+	int threads = Gen_ThreadsCount();
+	int beg = (int)((cc_uint64)World.Volume *  stripe      / threads);
+	int end = (int)((cc_uint64)World.Volume * (stripe + 1) / threads);
+	int i, index;
+
+	for (i = 0; i < plantsCount; i++) {
+		index = plantIndices[i];
+		if (index < beg || index >= end) continue;
+
+		if (Gen_Blocks[index] == BLOCK_AIR && Gen_Blocks[index - World.OneY] == plantGround)
+			Gen_Blocks[index] = plantBlocks[i];
+	}
+}
+
+static void NotchyGen_FlushPlants(void) {
+	if (plantsCount) Gen_RunStripes(NotchyGen_PlantsStripe, Gen_ThreadsCount());
+	plantsCount = 0;
+}
+
+static void NotchyGen_BeginPlants(BlockRaw ground) {
+	plantGround = ground;
+	plantsCount = 0;
+	if (Gen_ThreadsCount() == 1 || plantIndices) return;
+
+	plantIndices = (int*)Mem_TryAlloc(GEN_PLANTS_BATCH, 4);
+	plantBlocks  = (BlockRaw*)Mem_TryAlloc(GEN_PLANTS_BATCH, 1);
+	if (plantIndices && plantBlocks) return;
+
+	/* Just place plants immediately if out of memory */
+	Mem_Free(plantIndices); plantIndices = NULL;
+	Mem_Free(plantBlocks);  plantBlocks  = NULL;
+}
+
+static void NotchyGen_Plant(int index, BlockRaw block) {
+	if (!plantIndices) {
+		if (Gen_Blocks[index] == BLOCK_AIR && Gen_Blocks[index - World.OneY] == plantGround)
+			Gen_Blocks[index] = block;
+		return;
+	}
+
+	plantIndices[plantsCount] = index;
+	plantBlocks[plantsCount]  = block;
+	if (++plantsCount == GEN_PLANTS_BATCH) NotchyGen_FlushPlants();
+}
+
 static void NotchyGen_PlantFlowers(void) {
 	int numPatches;
 	BlockRaw block;
@@ -599,6 +947,7 @@ static void NotchyGen_PlantFlowers(void) {
 	if (Game_Version.Version < VERSION_0023) return;
 	numPatches       = World.Width * World.Length / 3000;
 	Gen_CurrentState = "Planting flowers";
+	NotchyGen_BeginPlants(BLOCK_GRASS);
 
 	for (i = 0; i < numPatches; i++) {
 		Gen_CurrentProgress = (float)i / numPatches;
@@ -618,11 +967,11 @@ static void NotchyGen_PlantFlowers(void) {
 				if (flowerY <= 0 || flowerY >= World.Height) continue;
 
 				index = World_Pack(flowerX, flowerY, flowerZ);
-				if (Gen_Blocks[index] == BLOCK_AIR && Gen_Blocks[index - World.OneY] == BLOCK_GRASS)
-					Gen_Blocks[index] = block;
+				NotchyGen_Plant(index, block);
 			}
 		}
 	}
+	NotchyGen_FlushPlants();
 }
 
 static void NotchyGen_PlantMushrooms(void) {
@@ -635,6 +984,7 @@ static void NotchyGen_PlantMushrooms(void) {
 	if (Game_Version.Version < VERSION_0023) return;
 	numPatches       = World.Volume / 2000;
 	Gen_CurrentState = "Planting mushrooms";
+	NotchyGen_BeginPlants(BLOCK_STONE);
 
 	for (i = 0; i < numPatches; i++) {
 		Gen_CurrentProgress = (float)i / numPatches;
@@ -655,11 +1005,11 @@ static void NotchyGen_PlantMushrooms(void) {
 				if (mushY >= (groundHeight - 1)) continue;
 
 				index = World_Pack(mushX, mushY, mushZ);
-				if (Gen_Blocks[index] == BLOCK_AIR && Gen_Blocks[index - World.OneY] == BLOCK_STONE)
-					Gen_Blocks[index] = block;
+				NotchyGen_Plant(index, block);
 			}
 		}
 	}
+	NotchyGen_FlushPlants();
 }
 
 static void NotchyGen_PlantTrees(void) {
@@ -717,6 +1067,9 @@ static cc_bool NotchyGen_Prepare(void) {
 	minHeight  = World.Height;
 
 	heightmap  = (cc_int16*)Mem_TryAlloc(World.Width * World.Length, 2);
+#ifdef GEN_SIMD_SSE2
+	ImprovedNoise_InitGrads();
+#endif
 	return heightmap != NULL;
 }
 
@@ -739,6 +1092,10 @@ static void NotchyGen_Generate(void) {
 		GEN_COOP_STEP(12, NotchyGen_PlantTrees() );
 	GEN_COOP_END
 
+	Gen_StopWorkers();
+	Mem_Free(plantIndices); plantIndices = NULL;
+	Mem_Free(plantBlocks);  plantBlocks  = NULL;
+
 	Mem_Free(heightmap);
 	heightmap = NULL;
 	gen_done  = true;
@@ -28,11 +28,21 @@ struct MenuOptionsScreen;
 extern struct IGameComponent Gfx_Component;
 
 typedef enum VertexFormat_ {
-	VERTEX_FORMAT_COLOURED, VERTEX_FORMAT_TEXTURED
+	VERTEX_FORMAT_COLOURED, VERTEX_FORMAT_TEXTURED, VERTEX_FORMAT_PACKED
 } VertexFormat;
 
 #define SIZEOF_VERTEX_COLOURED 16
 #define SIZEOF_VERTEX_TEXTURED 24
+#define SIZEOF_VERTEX_PACKED   16
+
+/* Whether the graphics backend supports VERTEX_FORMAT_PACKED (see Gfx_SetVertexOrigin) */
+#if CC_GFX_BACKEND == CC_GFX_BACKEND_GL2 || CC_GFX_BACKEND == CC_GFX_BACKEND_SOFTGPU
+	#define CC_BUILD_PACKEDVERTICES
+#endif
+/* Packed vertex X/Y/Z are in 1/512ths of a block, relative to the vertex origin */
+#define VERTEX_PACKED_POS_SCALE 512
+/* Packed vertex U is in 1/1024ths of a texture */
+#define VERTEX_PACKED_U_SCALE  1024
 
 #if defined CC_BUILD_PSP
 /* 3 floats for position (XYZ), 4 bytes for colour */
@@ -45,6 +55,9 @@ struct VertexColoured { float x, y, z; PackedCol Col; };
 /* 3 floats for position (XYZ), 2 floats for texture coordinates (UV), 4 bytes for colour */
 struct VertexTextured { float x, y, z; PackedCol Col; float U, V; };
 #endif
+/* 3 fixed point shorts for position (XYZ) and 1 for texture U, 4 bytes for colour, 1 float for texture V */
+/* NOTE: V is kept as a float, as 1D texture atlases may have too many rows for 16 bit precision */
+struct VertexPacked { cc_int16 x, y, z, U; PackedCol Col; float V; };
 
 void Gfx_Create(void);
 void Gfx_Free(void);
@@ -310,6 +323,12 @@ CC_API void  Gfx_UnlockVb(GfxResourceID vb);
 /* Special case of Gfx_Create/LockVb for building chunks in Builder.c */
 GfxResourceID Gfx_CreateVb2(void* vertices, VertexFormat fmt, int count);
 #endif
+#ifdef CC_BUILD_PACKEDVERTICES
+/* Sets the world coordinates that the positions of VERTEX_FORMAT_PACKED vertices are relative to */
+void Gfx_SetVertexOrigin(int x, int y, int z);
+#else
+#define Gfx_SetVertexOrigin(x, y, z)
+#endif
 #if CC_GFX_BACKEND == CC_GFX_BACKEND_GL2
 /* Special case Gfx_BindVb for use with Gfx_DrawIndexedTris_T2fC4b */
 void Gfx_BindVb_Textured(GfxResourceID vb);
@@ -331,6 +350,43 @@ CC_API void  Gfx_UnlockDynamicVb(GfxResourceID vb);
 /* Updates the data of a dynamic vertex buffer */
 CC_API void Gfx_SetDynamicVbData(GfxResourceID vb, void* vertices, int vCount);
 
+/* Whether the graphics backend supports the vertex buffer arena (see Gfx_AllocArenaVb) */
+#if CC_GFX_BACKEND == CC_GFX_BACKEND_GL2 || CC_GFX_BACKEND == CC_GFX_BACKEND_SOFTGPU
+	#define CC_BUILD_VBARENA
+#endif
+#ifdef CC_BUILD_VBARENA
+/*
+SUMMARY:
+	The vertex buffer arena suballocates many small static meshes (e.g. chunks) from a few large buffers
+IMPLEMENTATION NOTES:
+	Each large buffer ("page") holds GFX_ARENA_PAGE_VERTICES vertices, and is split into equal
+	 size slots of one size class. (powers of two from 128 to GFX_ARENA_PAGE_VERTICES vertices)
+	Freed slots are reused by later allocations, and empty pages are deleted.
+USAGE NOTES:
+	Since a page never has more than 65536 vertices, slots can always be drawn using the default index buffer
+*/
+#define GFX_ARENA_PAGE_VERTICES 65536
+typedef void (*Gfx_ArenaEvictFunc)(void* owner);
+
+/* Allocates a slot with room for at least count vertices, returning a handle to it */
+/* Returns 0 if count is too large for a slot, or if a page could not be allocated */
+int  Gfx_AllocArenaVb(VertexFormat fmt, int count, void* owner);
+/* Frees the given slot, then sets it to 0 */
+void Gfx_FreeArenaVb(int* slot);
+/* Returns the page of the given slot, and the index of the slot's first vertex in that page */
+GfxResourceID Gfx_GetArenaVb(int slot, int* offset);
+/* Acquires temp memory for changing the vertices of the given slot */
+void* Gfx_LockArenaVb(int slot, int count);
+/* Submits the changed vertices of the given slot */
+void  Gfx_UnlockArenaVb(int slot);
+/* Reclaims space wasted by mostly empty pages, by moving their slots into other pages. */
+/* evict is called with the owner of each slot to move, and must free that slot either straight away */
+/*  (e.g. by deleting it) or later on (e.g. by rebuilding it) */
+void Gfx_CompactArena(Gfx_ArenaEvictFunc evict);
+/* Deletes all pages that have no slots allocated from them */
+void Gfx_ReleaseArena(void);
+#endif
+
 
 /*########################################################################################################################*
 *------------------------------------------------------Vertex drawing-----------------------------------------------------*
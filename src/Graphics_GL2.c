@@ -152,6 +152,17 @@ void Gfx_SetDynamicVbData(GfxResourceID vb, void* vertices, int vCount) {
 	glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices);
 }
 
+static cc_uint32 rangeOffset;
+static void* Gfx_LockVbRange(GfxResourceID vb, VertexFormat fmt, int offset, int count) {
+	rangeOffset = offset * strideSizes[fmt];
+	return FastAllocTempMem(count * strideSizes[fmt]);
+}
+
+static void Gfx_UnlockVbRange(GfxResourceID vb) {
+	glBindBuffer(GL_ARRAY_BUFFER, ptr_to_uint(vb));
+	glBufferSubData(GL_ARRAY_BUFFER, rangeOffset, tmpSize, tmpData);
+}
+
 
 /*########################################################################################################################*
 *------------------------------------------------------OpenGL modern------------------------------------------------------*
@@ -162,6 +173,7 @@ void Gfx_SetDynamicVbData(GfxResourceID vb, void* vertices, int vCount) {
 #define FTR_LINEAR_FOG (1 << 3)
 #define FTR_DENSIT_FOG (1 << 4)
 #define FTR_HASANY_FOG (FTR_LINEAR_FOG | FTR_DENSIT_FOG)
+#define FTR_PACKED_POS (1 << 5)
 #define FTR_FS_MEDIUMP (1 << 7)
 
 #define UNI_MVP_MATRIX (1 << 0)
@@ -169,7 +181,8 @@ void Gfx_SetDynamicVbData(GfxResourceID vb, void* vertices, int vCount) {
 #define UNI_FOG_COL    (1 << 2)
 #define UNI_FOG_END    (1 << 3)
 #define UNI_FOG_DENS   (1 << 4)
-#define UNI_MASK_ALL   0x1F
+#define UNI_VB_ORIGIN  (1 << 5)
+#define UNI_MASK_ALL   0x3F
 
 /* cached uniforms (cached for multiple programs */
 static struct Matrix _view, _proj, _mvp;
@@ -178,14 +191,15 @@ static float _texX, _texY;
 static PackedCol gfx_fogColor;
 static float gfx_fogEnd = -1.0f, gfx_fogDensity = -1.0f;
 static int gfx_fogMode = -1;
+static int _originX, _originY, _originZ;
 
 /* shader programs (emulate fixed function) */
 static struct GLShader {
 	int features;     /* what features are enabled for this shader */
 	int uniforms;     /* which associated uniforms need to be resent to GPU */
 	GLuint program;   /* OpenGL program ID (0 if not yet compiled) */
-	int locations[5]; /* location of uniforms (not constant) */
-} shaders[6 * 3] = {
+	int locations[6]; /* location of uniforms (not constant) */
+} shaders[6 * 3 + 2 * 3] = {
 	/* no fog */
 	{ 0              },
 	{ 0              | FTR_ALPHA_TEST },
@@ -207,6 +221,13 @@ static struct GLShader {
 	{ FTR_DENSIT_FOG | FTR_TEXTURE_UV | FTR_ALPHA_TEST },
 	{ FTR_DENSIT_FOG | FTR_TEXTURE_UV | FTR_TEX_OFFSET },
 	{ FTR_DENSIT_FOG | FTR_TEXTURE_UV | FTR_TEX_OFFSET | FTR_ALPHA_TEST },
+	/* packed vertices */
+	{ FTR_PACKED_POS | FTR_TEXTURE_UV },
+	{ FTR_PACKED_POS | FTR_TEXTURE_UV | FTR_ALPHA_TEST },
+	{ FTR_PACKED_POS | FTR_TEXTURE_UV | FTR_LINEAR_FOG },
+	{ FTR_PACKED_POS | FTR_TEXTURE_UV | FTR_LINEAR_FOG | FTR_ALPHA_TEST },
+	{ FTR_PACKED_POS | FTR_TEXTURE_UV | FTR_DENSIT_FOG },
+	{ FTR_PACKED_POS | FTR_TEXTURE_UV | FTR_DENSIT_FOG | FTR_ALPHA_TEST },
 };
 static struct GLShader* gfx_activeShader;
 
@@ -215,6 +236,25 @@ static void GenVertexShader(const struct GLShader* shader, cc_string* dst) {
 	int uv = shader->features & FTR_TEXTURE_UV;
 	int tm = shader->features & FTR_TEX_OFFSET;
 
+	/* Packed vertices have fixed point XYZ and U in in_pos, and V in in_uv */
+	if (shader->features & FTR_PACKED_POS) {
+		String_AppendConst(dst, "attribute vec4 in_pos;\n");
+		String_AppendConst(dst, "attribute vec4 in_col;\n");
+		String_AppendConst(dst, "attribute float in_uv;\n");
+		String_AppendConst(dst, "varying vec4 out_col;\n");
+		String_AppendConst(dst, "varying vec2 out_uv;\n");
+		String_AppendConst(dst, "uniform mat4 mvp;\n");
+		String_AppendConst(dst, "uniform vec3 origin;\n");
+
+		String_AppendConst(dst, "void main() {\n");
+		String_AppendConst(dst, "  vec3 pos = in_pos.xyz * (1.0 / 512.0) + origin;\n");
+		String_AppendConst(dst, "  gl_Position = mvp * vec4(pos, 1.0);\n");
+		String_AppendConst(dst, "  out_col = in_col;\n");
+		String_AppendConst(dst, "  out_uv  = vec2(in_pos.w * (1.0 / 1024.0), in_uv);\n");
+		String_AppendConst(dst, "}");
+		return;
+	}
+
 	String_AppendConst(dst,         "attribute vec3 in_pos;\n");
 	String_AppendConst(dst,         "attribute vec4 in_col;\n");
 	if (uv) String_AppendConst(dst, "attribute vec2 in_uv;\n");
@@ -362,6 +402,7 @@ static void CompileProgram(struct GLShader* shader) {
 		shader->locations[2] = glGetUniformLocation(program, "fogCol");
 		shader->locations[3] = glGetUniformLocation(program, "fogEnd");
 		shader->locations[4] = glGetUniformLocation(program, "fogDensity");
+		shader->locations[5] = glGetUniformLocation(program, "origin");
 		return;
 	}
 	temp = 0;
@@ -411,6 +452,10 @@ static void ReloadUniforms(void) {
 		glUniform1f(s->locations[4], -gfx_fogDensity);
 		s->uniforms &= ~UNI_FOG_DENS;
 	}
+	if ((s->uniforms & UNI_VB_ORIGIN) && (s->features & FTR_PACKED_POS)) {
+		glUniform3f(s->locations[5], (float)_originX, (float)_originY, (float)_originZ);
+		s->uniforms &= ~UNI_VB_ORIGIN;
+	}
 }
 
 /* Switches program to one that duplicates current fixed function state */
@@ -419,14 +464,22 @@ static void SwitchProgram(void) {
 	struct GLShader* shader;
 	int index = 0;
 
-	if (gfx_fogEnabled) {
-		index += 6;                       /* linear fog */
-		if (gfx_fogMode >= 1) index += 6; /* exp fog */
-	}
+	if (gfx_format == VERTEX_FORMAT_PACKED) {
+		index = 6 * 3;
+		if (gfx_fogEnabled) {
+			index += 2;                       /* linear fog */
+			if (gfx_fogMode >= 1) index += 2; /* exp fog */
+		}
+	} else {
+		if (gfx_fogEnabled) {
+			index += 6;                       /* linear fog */
+			if (gfx_fogMode >= 1) index += 6; /* exp fog */
+		}
 
-	if (gfx_format == VERTEX_FORMAT_TEXTURED) index += 2;
-	if (gfx_texTransform) index += 2;
-	if (gfx_alphaTest)    index += 1;
+		if (gfx_format == VERTEX_FORMAT_TEXTURED) index += 2;
+		if (gfx_texTransform) index += 2;
+	}
+	if (gfx_alphaTest) index += 1;
 
 	shader = &shaders[index];
 	if (shader == gfx_activeShader) { ReloadUniforms(); return; }
@@ -647,6 +700,12 @@ static void GL_SetupVbTextured(void) {
 	glVertexAttribPointer(2, 2, GL_FLOAT,         false, SIZEOF_VERTEX_TEXTURED, uint_to_ptr(16));
 }
 
+static void GL_SetupVbPacked(void) {
+	glVertexAttribPointer(0, 4, GL_SHORT,         false, SIZEOF_VERTEX_PACKED, uint_to_ptr( 0));
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, true,  SIZEOF_VERTEX_PACKED, uint_to_ptr( 8));
+	glVertexAttribPointer(2, 1, GL_FLOAT,         false, SIZEOF_VERTEX_PACKED, uint_to_ptr(12));
+}
+
 static void GL_SetupVbColoured_Range(int startVertex) {
 	cc_uint32 offset = startVertex * SIZEOF_VERTEX_COLOURED;
 	glVertexAttribPointer(0, 3, GL_FLOAT,         false, SIZEOF_VERTEX_COLOURED, uint_to_ptr(offset     ));
@@ -660,6 +719,13 @@ static void GL_SetupVbTextured_Range(int startVertex) {
 	glVertexAttribPointer(2, 2, GL_FLOAT,         false, SIZEOF_VERTEX_TEXTURED, uint_to_ptr(offset + 16));
 }
 
+static void GL_SetupVbPacked_Range(int startVertex) {
+	cc_uint32 offset = startVertex * SIZEOF_VERTEX_PACKED;
+	glVertexAttribPointer(0, 4, GL_SHORT,         false, SIZEOF_VERTEX_PACKED, uint_to_ptr(offset     ));
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, true,  SIZEOF_VERTEX_PACKED, uint_to_ptr(offset +  8));
+	glVertexAttribPointer(2, 1, GL_FLOAT,         false, SIZEOF_VERTEX_PACKED, uint_to_ptr(offset + 12));
+}
+
 void Gfx_SetVertexFormat(VertexFormat fmt) {
 	if (fmt == gfx_format) return;
 	gfx_format = fmt;
@@ -669,6 +735,10 @@ void Gfx_SetVertexFormat(VertexFormat fmt) {
 		glEnableVertexAttribArray(2);
 		gfx_setupVBFunc      = GL_SetupVbTextured;
 		gfx_setupVBRangeFunc = GL_SetupVbTextured_Range;
+	} else if (fmt == VERTEX_FORMAT_PACKED) {
+		glEnableVertexAttribArray(2);
+		gfx_setupVBFunc      = GL_SetupVbPacked;
+		gfx_setupVBRangeFunc = GL_SetupVbPacked_Range;
 	} else {
 		glDisableVertexAttribArray(2);
 		gfx_setupVBFunc      = GL_SetupVbColoured;
@@ -694,14 +764,20 @@ void Gfx_DrawVb_IndexedTris(int verticesCount) {
 
 void Gfx_BindVb_Textured(GfxResourceID vb) {
 	Gfx_BindVb(vb);
-	GL_SetupVbTextured();
+	gfx_setupVBFunc();
+}
+
+void Gfx_SetVertexOrigin(int x, int y, int z) {
+	_originX = x; _originY = y; _originZ = z;
+	DirtyUniform(UNI_VB_ORIGIN);
+	ReloadUniforms();
 }
 
 void Gfx_DrawIndexedTris_T2fC4b(int verticesCount, int startVertex) {
 	if (startVertex + verticesCount > GFX_MAX_VERTICES) {
-		GL_SetupVbTextured_Range(startVertex);
+		gfx_setupVBRangeFunc(startVertex);
 		glDrawElements(GL_TRIANGLES, ICOUNT(verticesCount), GL_UNSIGNED_SHORT, NULL);
-		GL_SetupVbTextured();
+		gfx_setupVBFunc();
 	} else {
 		/* ICOUNT(startVertex) * 2 = startVertex * 3  */
 		glDrawElements(GL_TRIANGLES, ICOUNT(verticesCount), GL_UNSIGNED_SHORT, uint_to_ptr(startVertex * 3));
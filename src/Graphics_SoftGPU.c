@@ -3,6 +3,16 @@
 #include "_GraphicsBase.h"
 #include "Errors.h"
 #include "Window.h"
+#include "Options.h"
+#include "Utils.h"
+
+// SSE2 is always available on x86_64, so 3D triangles can be rasterised 4 pixels at a time
+#if !defined SOFTGPU_DISABLE_SIMD && !defined SOFTGPU_DISABLE_ZBUFFER && !defined BITMAP_16BPP
+	#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+		#define SOFTGPU_SIMD_SSE2
+		#include <emmintrin.h>
+	#endif
+#endif
 
 static cc_bool faceCulling;
 static int fb_width, fb_height; 
@@ -23,6 +33,15 @@ static int db_stride;
 static void* gfx_vertices;
 static GfxResourceID white_square;
 
+// Tile binning requires proper multithreading support
+#if !defined CC_BUILD_COOPTHREADED && !defined CC_BUILD_CONSOLE
+	#define SOFTGPU_BINNING
+	#define SOFTGPU_MAX_THREADS WORKERPOOL_MAX_THREADS
+	static int binThreads;
+#endif
+static void FlushBins(void);
+static void FreeBins(void);
+
 void Gfx_RestoreState(void) {
 	InitDefaultResources();
 
@@ -49,6 +68,9 @@ void Gfx_Create(void) {
 
 	Gfx.Created      = true;
 	Gfx.BackendType  = CC_GFX_BACKEND_SOFTGPU;
+#ifdef SOFTGPU_BINNING
+	binThreads = Options_GetInt(OPT_SOFTGPU_THREADS, 0, SOFTGPU_MAX_THREADS, 0);
+#endif
 	
 	Gfx_RestoreState();
 }
@@ -60,6 +82,7 @@ static void DestroyBuffers(void) {
 }
 
 void Gfx_Free(void) { 
+	FreeBins();
 	Gfx_FreeState();
 	DestroyBuffers();
 }
@@ -92,7 +115,11 @@ void Gfx_BindTexture(GfxResourceID texId) {
 		
 void Gfx_DeleteTexture(GfxResourceID* texId) {
 	GfxResourceID data = *texId;
-	if (data) Mem_Free(data);
+	if (!data) return;
+
+	// Binned triangles may still be using the texture
+	FlushBins();
+	Mem_Free(data);
 	*texId = NULL;
 }
 		
@@ -109,6 +136,8 @@ GfxResourceID Gfx_AllocTexture(struct Bitmap* bmp, int rowWidth, cc_uint8 flags,
 void Gfx_UpdateTexture(GfxResourceID texId, int x, int y, struct Bitmap* part, int rowWidth, cc_bool mipmaps) {
 	CCTexture* tex = (CCTexture*)texId;
 	BitmapCol* dst = (tex->pixels + x) + y * tex->width;
+	// Binned triangles must be rasterised with the old texture data
+	FlushBins();
 
 	CopyTextureData(dst, tex->width * BITMAPCOLOR_SIZE,
 					part, rowWidth  * BITMAPCOLOR_SIZE);
@@ -165,6 +194,7 @@ static void ClearDepthBuffer(void) {
 }
 
 void Gfx_ClearBuffers(GfxBuffers buffers) {
+	FlushBins();
 	if (buffers & GFX_BUFFER_COLOR) ClearColorBuffer();
 	if (buffers & GFX_BUFFER_DEPTH) ClearDepthBuffer();
 }
@@ -246,18 +276,42 @@ void Gfx_UnlockDynamicVb(GfxResourceID vb) {
 
 void Gfx_DeleteDynamicVb(GfxResourceID* vb) { Gfx_DeleteVb(vb); }
 
+static void* Gfx_LockVbRange(GfxResourceID vb, VertexFormat fmt, int offset, int count) {
+	return (char*)vb + offset * strideSizes[fmt];
+}
+
+static void Gfx_UnlockVbRange(GfxResourceID vb) { }
+
 
 /*########################################################################################################################*
 *---------------------------------------------------------Matrices--------------------------------------------------------*
 *#########################################################################################################################*/
 static float texOffsetX, texOffsetY;
 static struct Matrix _view, _proj, _mvp;
+// MVP with the fixed point scale and vertex origin of packed vertices folded in
+static struct Matrix _packedMvp;
+static int originX, originY, originZ;
+
+static void CalcPackedMVP(void) {
+	float scale = 1.0f / VERTEX_PACKED_POS_SCALE;
+	struct Matrix* m = &_packedMvp;
+
+	m->row1.x = _mvp.row1.x * scale; m->row1.y = _mvp.row1.y * scale; m->row1.z = _mvp.row1.z * scale; m->row1.w = _mvp.row1.w * scale;
+	m->row2.x = _mvp.row2.x * scale; m->row2.y = _mvp.row2.y * scale; m->row2.z = _mvp.row2.z * scale; m->row2.w = _mvp.row2.w * scale;
+	m->row3.x = _mvp.row3.x * scale; m->row3.y = _mvp.row3.y * scale; m->row3.z = _mvp.row3.z * scale; m->row3.w = _mvp.row3.w * scale;
+
+	m->row4.x = originX * _mvp.row1.x + originY * _mvp.row2.x + originZ * _mvp.row3.x + _mvp.row4.x;
+	m->row4.y = originX * _mvp.row1.y + originY * _mvp.row2.y + originZ * _mvp.row3.y + _mvp.row4.y;
+	m->row4.z = originX * _mvp.row1.z + originY * _mvp.row2.z + originZ * _mvp.row3.z + _mvp.row4.z;
+	m->row4.w = originX * _mvp.row1.w + originY * _mvp.row2.w + originZ * _mvp.row3.w + _mvp.row4.w;
+}
 
 void Gfx_LoadMatrix(MatrixType type, const struct Matrix* matrix) {
 	if (type == MATRIX_VIEW) _view = *matrix;
 	if (type == MATRIX_PROJ) _proj = *matrix;
 
 	Matrix_Mul(&_mvp, &_view, &_proj);
+	CalcPackedMVP();
 }
 
 void Gfx_LoadMVP(const struct Matrix* view, const struct Matrix* proj, struct Matrix* mvp) {
@@ -266,6 +320,12 @@ void Gfx_LoadMVP(const struct Matrix* view, const struct Matrix* proj, struct Ma
 
 	Matrix_Mul(mvp, view, proj);
 	_mvp  = *mvp;
+	CalcPackedMVP();
+}
+
+void Gfx_SetVertexOrigin(int x, int y, int z) {
+	originX = x; originY = y; originZ = z;
+	CalcPackedMVP();
 }
 
 void Gfx_EnableTextureOffset(float x, float y) {
@@ -342,10 +402,27 @@ static void TransformVertex2D(int index, Vertex* vertex) {
 	}
 }
 
+static int TransformPackedVertex(char* ptr, Vertex* vertex) {
+	struct VertexPacked* v = (struct VertexPacked*)ptr;
+	const struct Matrix* m = &_packedMvp;
+	float x = v->x, y = v->y, z = v->z;
+
+	vertex->x = x * m->row1.x + y * m->row2.x + z * m->row3.x + m->row4.x;
+	vertex->y = x * m->row1.y + y * m->row2.y + z * m->row3.y + m->row4.y;
+	vertex->z = x * m->row1.z + y * m->row2.z + z * m->row3.z + m->row4.z;
+	vertex->w = x * m->row1.w + y * m->row2.w + z * m->row3.w + m->row4.w;
+
+	vertex->u = v->U * (1.0f / VERTEX_PACKED_U_SCALE) + texOffsetX;
+	vertex->v = v->V + texOffsetY;
+	vertex->c = v->Col;
+	return vertex->z >= 0.0f;
+}
+
 static int TransformVertex3D(int index, Vertex* vertex) {
 	// TODO: avoid the multiply, just add down in DrawTriangles
 	char* ptr = (char*)gfx_vertices + index * gfx_stride;
 	Vector3* pos = (Vector3*)ptr;
+	if (gfx_format == VERTEX_FORMAT_PACKED) return TransformPackedVertex(ptr, vertex);
 
 	vertex->x = pos->x * _mvp.row1.x + pos->y * _mvp.row2.x + pos->z * _mvp.row3.x + _mvp.row4.x;
 	vertex->y = pos->x * _mvp.row1.y + pos->y * _mvp.row2.y + pos->z * _mvp.row3.y + _mvp.row4.y;
@@ -378,13 +455,53 @@ static void ViewportVertex3D(Vertex* vertex) {
 	vertex->v *= invW;
 }
 
+// State used when rasterising triangles
+// NOTE: Triangles may be rasterised long after they were drawn when tile binning is enabled,
+//  so rasterisers must only ever use this state instead of the current global state
+struct RasterState {
+	BitmapCol* texPixels;
+	int texWidth, texHeight;
+	int texWidthMask, texHeightMask;
+	cc_bool texSinglePixel, texturing;
+	cc_bool alphaTest, alphaBlend, faceCulling;
+	cc_bool depthTest, depthWrite, colWrite;
+	int scissorMaxX, scissorMaxY;
+};
+// Rectangle that triangles are rasterised within (inclusive)
+struct RasterClip { int minX, minY, maxX, maxY; };
+
+static struct RasterState curState;
+static struct RasterClip  screenClip;
+
+static void CaptureState(void) {
+	curState.texPixels      = curTexPixels;
+	curState.texWidth       = curTexWidth;
+	curState.texHeight      = curTexHeight;
+	curState.texWidthMask   = texWidthMask;
+	curState.texHeightMask  = texHeightMask;
+	curState.texSinglePixel = texSinglePixel;
+	curState.texturing      = gfx_format != VERTEX_FORMAT_COLOURED;
+
+	curState.alphaTest   = gfx_alphaTest;
+	curState.alphaBlend  = gfx_alphaBlend;
+	curState.faceCulling = faceCulling;
+	curState.depthTest   = depthTest;
+	curState.depthWrite  = depthWrite;
+	curState.colWrite    = colWrite;
+	curState.scissorMaxX = fb_maxX;
+	curState.scissorMaxY = fb_maxY;
+
+	screenClip.minX = 0; screenClip.maxX = fb_maxX;
+	screenClip.minY = 0; screenClip.maxY = fb_maxY;
+}
+
 // Ensure it's inlined, whereas Math_FloorF might not be
 static CC_INLINE int FastFloor(float value) {
 	int valueI = (int)value;
 	return valueI > value ? valueI - 1 : valueI;
 }
 
-static void DrawSprite2D(Vertex* V0, Vertex* V1, Vertex* V2) {
+static void DrawSprite2D(const struct RasterState* st, const struct RasterClip* clip, Vertex* V0, Vertex* V1, Vertex* V2) {
 	PackedCol vColor = V0->c;
 	int minX = (int)V0->x;
 	int minY = (int)V0->y;
@@ -392,40 +509,42 @@ static void DrawSprite2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 	int maxY = (int)V2->y;
 
 	// Reject triangles completely outside
-	if (maxX < 0 || minX > fb_maxX) return;
-	if (maxY < 0 || minY > fb_maxY) return;
+	if (maxX < clip->minX || minX > clip->maxX) return;
+	if (maxY < clip->minY || minY > clip->maxY) return;
 
-	int begTX = (int)(V0->u * curTexWidth);
-	int begTY = (int)(V0->v * curTexHeight);
-	int delTX = (int)(V1->u * curTexWidth)  - begTX;
-	int delTY = (int)(V2->v * curTexHeight) - begTY;
+	int begTX = (int)(V0->u * st->texWidth);
+	int begTY = (int)(V0->v * st->texHeight);
+	int delTX = (int)(V1->u * st->texWidth)  - begTX;
+	int delTY = (int)(V2->v * st->texHeight) - begTY;
 
 	int width = maxX - minX, height = maxY - minY;
 
 	int fast =  delTX == width && delTY == height && 
-				(begTX + delTX < curTexWidth ) && 
-				(begTY + delTY < curTexHeight);
+				(begTX + delTX < st->texWidth ) && 
+				(begTY + delTY < st->texHeight);
+	// Texture coordinates are relative to the unscissored origin
+	int origX = minX, origY = minY;
 
 	// Perform scissoring
-	minX = max(minX, 0); maxX = min(maxX, fb_maxX);
-	minY = max(minY, 0); maxY = min(maxY, fb_maxY);
+	minX = max(minX, clip->minX); maxX = min(maxX, clip->maxX);
+	minY = max(minY, clip->minY); maxY = min(maxY, clip->maxY);
 
 	for (int y = minY; y <= maxY; y++) 
 	{
-		int texY = fast ? (begTY + (y - minY)) : (((begTY + delTY * (y - minY) / height)) & texHeightMask);
+		int texY = fast ? (begTY + (y - origY)) : (((begTY + delTY * (y - origY) / height)) & st->texHeightMask);
 		for (int x = minX; x <= maxX; x++) 
 		{
-			int texX = fast ? (begTX + (x - minX)) : (((begTX + delTX * (x - minX) / width)) & texWidthMask);
-			int texIndex = texY * curTexWidth + texX;
+			int texX = fast ? (begTX + (x - origX)) : (((begTX + delTX * (x - origX) / width)) & st->texWidthMask);
+			int texIndex = texY * st->texWidth + texX;
 
-			BitmapCol color = curTexPixels[texIndex];
+			BitmapCol color = st->texPixels[texIndex];
 			int R, G, B, A;
 
 			A = BitmapCol_A(color);
-			if (gfx_alphaBlend && A == 0) continue;
+			if (st->alphaBlend && A == 0) continue;
 			int cb_index = y * cb_stride + x;
 
-			if (gfx_alphaBlend && A != 255) {
+			if (st->alphaBlend && A != 255) {
 				BitmapCol dst = colorBuffer[cb_index];
 				int dstR = BitmapCol_R(dst);
 				int dstG = BitmapCol_G(dst);
@@ -459,7 +578,7 @@ static void DrawSprite2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 
 #define edgeFunction(ax,ay, bx,by, cx,cy) (((bx) - (ax)) * ((cy) - (ay)) - ((by) - (ay)) * ((cx) - (ax)))
 
-static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
+static void DrawTriangle2D(const struct RasterState* st, const struct RasterClip* clip, Vertex* V0, Vertex* V1, Vertex* V2) {
 	int x0 = (int)V0->x, y0 = (int)V0->y;
 	int x1 = (int)V1->x, y1 = (int)V1->y;
 	int x2 = (int)V2->x, y2 = (int)V2->y;
@@ -470,16 +589,16 @@ static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 
 	int area = edgeFunction(x0,y0, x1,y1, x2,y2);
 	// Reject triangles completely outside
-	if (maxX < 0 || minX > fb_maxX) return;
-	if (maxY < 0 || minY > fb_maxY) return;
+	if (maxX < clip->minX || minX > clip->maxX) return;
+	if (maxY < clip->minY || minY > clip->maxY) return;
 
 	// Perform scissoring
-	minX = max(minX, 0); maxX = min(maxX, fb_maxX);
-	minY = max(minY, 0); maxY = min(maxY, fb_maxY);
+	minX = max(minX, clip->minX); maxX = min(maxX, clip->maxX);
+	minY = max(minY, clip->minY); maxY = min(maxY, clip->maxY);
 	float factor = 1.0f / area;
 
-	float u0 = V0->u * curTexWidth,  u1 = V1->u * curTexWidth,  u2 = V2->u * curTexWidth;
-	float v0 = V0->v * curTexHeight, v1 = V1->v * curTexHeight, v2 = V2->v * curTexHeight;
+	float u0 = V0->u * st->texWidth,  u1 = V1->u * st->texWidth,  u2 = V2->u * st->texWidth;
+	float v0 = V0->v * st->texHeight, v1 = V1->v * st->texHeight, v2 = V2->v * st->texHeight;
 	PackedCol color = V0->c;
 	
 	// https://fgiesen.wordpress.com/2013/02/10/optimizing-the-basic-rasterizer/
@@ -508,14 +627,14 @@ static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 			int cb_index = y * cb_stride + x;
 
 			int R, G, B, A;
-			if (gfx_format == VERTEX_FORMAT_TEXTURED) {
+			if (st->texturing) {
 				float u = ic0 * u0 + ic1 * u1 + ic2 * u2;
 				float v = ic0 * v0 + ic1 * v1 + ic2 * v2;
-				int texX = ((int)u) & texWidthMask;
-				int texY = ((int)v) & texHeightMask;
-				int texIndex = texY * curTexWidth + texX;
+				int texX = ((int)u) & st->texWidthMask;
+				int texY = ((int)v) & st->texHeightMask;
+				int texIndex = texY * st->texWidth + texX;
 
-				BitmapCol tColor = curTexPixels[texIndex];
+				BitmapCol tColor = st->texPixels[texIndex];
 				int a1 = PackedCol_A(color), a2 = BitmapCol_A(tColor);
 				A = ( a1 * a2 ) >> 8;
 				int r1 = PackedCol_R(color), r2 = BitmapCol_R(tColor);
@@ -531,10 +650,10 @@ static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 				A = PackedCol_A(color);
 			}
 
-			if (gfx_alphaTest && A < 0x80) continue;
-			if (gfx_alphaBlend && A == 0)  continue;
+			if (st->alphaTest && A < 0x80) continue;
+			if (st->alphaBlend && A == 0)  continue;
 
-			if (gfx_alphaBlend && A != 255) {
+			if (st->alphaBlend && A != 255) {
 				BitmapCol dst = colorBuffer[cb_index];
 				int dstR = BitmapCol_R(dst);
 				int dstG = BitmapCol_G(dst);
@@ -567,7 +686,214 @@ static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 	b2 = BitmapCol_B(tColor); \
 	B  = ( b1 * b2 ) >> 8;    \
 
-static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
+#ifdef SOFTGPU_SIMD_SSE2
+// Triangles are rasterised in 8x8 pixel blocks, with each row of a block processed 4 pixels at a time
+#define SIMD_BLOCK_SIZE 8
+// Edge functions are evaluated at twice resolution so that pixel centres have integer coordinates,
+//  so coordinates must be limited to ensure that the fixed point edge functions never overflow 32 bits
+#define SIMD_MAX_COORD 8192
+#define SIMD_ALPHA_WORD (BITMAPCOLOR_A_SHIFT / 8)
+
+static CC_INLINE cc_bool CanDrawSIMD(int x0, int y0, int x1, int y1, int x2, int y2) {
+	return  x0 > -SIMD_MAX_COORD && x0 < SIMD_MAX_COORD && y0 > -SIMD_MAX_COORD && y0 < SIMD_MAX_COORD &&
+			x1 > -SIMD_MAX_COORD && x1 < SIMD_MAX_COORD && y1 > -SIMD_MAX_COORD && y1 < SIMD_MAX_COORD &&
+			x2 > -SIMD_MAX_COORD && x2 < SIMD_MAX_COORD && y2 > -SIMD_MAX_COORD && y2 < SIMD_MAX_COORD &&
+			fb_maxX < SIMD_MAX_COORD && fb_maxY < SIMD_MAX_COORD;
+}
+
+// Multiplies each 8 bit component of the given colours by the corresponding component of col16
+static CC_INLINE __m128i MultiplyColors_SSE2(__m128i colors, __m128i col16) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i lo   = _mm_unpacklo_epi8(colors, zero);
+	__m128i hi   = _mm_unpackhi_epi8(colors, zero);
+
+	lo = _mm_srli_epi16(_mm_mullo_epi16(lo, col16), 8);
+	hi = _mm_srli_epi16(_mm_mullo_epi16(hi, col16), 8);
+	return _mm_packus_epi16(lo, hi);
+}
+
+// Blends each 8 bit component as (src * A + dst * (255 - A)) >> 8
+static CC_INLINE __m128i BlendColors_SSE2(__m128i src, __m128i dst) {
+	__m128i zero  = _mm_setzero_si128();
+	__m128i max16 = _mm_set1_epi16(255);
+	__m128i srcLo = _mm_unpacklo_epi8(src, zero), srcHi = _mm_unpackhi_epi8(src, zero);
+	__m128i dstLo = _mm_unpacklo_epi8(dst, zero), dstHi = _mm_unpackhi_epi8(dst, zero);
+	__m128i aLo, aHi;
+
+	// Broadcast alpha to all 4 components of each pixel
+	aLo = _mm_shufflelo_epi16(srcLo, _MM_SHUFFLE(SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD));
+	aLo = _mm_shufflehi_epi16(aLo,   _MM_SHUFFLE(SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD));
+	aHi = _mm_shufflelo_epi16(srcHi, _MM_SHUFFLE(SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD));
+	aHi = _mm_shufflehi_epi16(aHi,   _MM_SHUFFLE(SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD, SIMD_ALPHA_WORD));
+
+	srcLo = _mm_add_epi16(_mm_mullo_epi16(srcLo, aLo), _mm_mullo_epi16(dstLo, _mm_sub_epi16(max16, aLo)));
+	srcHi = _mm_add_epi16(_mm_mullo_epi16(srcHi, aHi), _mm_mullo_epi16(dstHi, _mm_sub_epi16(max16, aHi)));
+	return _mm_packus_epi16(_mm_srli_epi16(srcLo, 8), _mm_srli_epi16(srcHi, 8));
+}
+
+static void DrawTriangle3D_SSE2(const struct RasterState* st, Vertex* V0, Vertex* V1, Vertex* V2, int area,
+								int minX, int minY, int maxX, int maxY) {
+	int x0 = (int)V0->x, y0 = (int)V0->y;
+	int x1 = (int)V1->x, y1 = (int)V1->y;
+	int x2 = (int)V2->x, y2 = (int)V2->y;
+	// Flip edge functions of back facing triangles, so that inside is always >= 0
+	int sign = area < 0 ? -1 : 1;
+
+	// Edge function steps for one pixel in X/Y (doubled, same as edge function values)
+	int sx0 = sign * 2 * (y1 - y2), sy0 = sign * 2 * (x2 - x1);
+	int sx1 = sign * 2 * (y2 - y0), sy1 = sign * 2 * (x0 - x2);
+	int sx2 = sign * 2 * (y0 - y1), sy2 = sign * 2 * (x1 - x0);
+
+	// Edge functions at centre of pixel (minX, minY)
+	int e0 = sign * ((x2 - x1) * (2 * minY + 1 - 2 * y1) - (y2 - y1) * (2 * minX + 1 - 2 * x1));
+	int e1 = sign * ((x0 - x2) * (2 * minY + 1 - 2 * y2) - (y0 - y2) * (2 * minX + 1 - 2 * x2));
+	int e2 = sign * ((x1 - x0) * (2 * minY + 1 - 2 * y0) - (y1 - y0) * (2 * minX + 1 - 2 * x0));
+
+	__m128 factor = _mm_set1_ps(0.5f / (sign * area));
+	__m128 w0 = _mm_set1_ps(V0->w), w1 = _mm_set1_ps(V1->w), w2 = _mm_set1_ps(V2->w);
+	__m128 z0 = _mm_set1_ps(V0->z), z1 = _mm_set1_ps(V1->z), z2 = _mm_set1_ps(V2->z);
+	__m128 u0 = _mm_set1_ps(V0->u * st->texWidth),  u1 = _mm_set1_ps(V1->u * st->texWidth),  u2 = _mm_set1_ps(V2->u * st->texWidth);
+	__m128 v0 = _mm_set1_ps(V0->v * st->texHeight), v1 = _mm_set1_ps(V1->v * st->texHeight), v2 = _mm_set1_ps(V2->v * st->texHeight);
+
+	__m128i step0 = _mm_setr_epi32(0, sx0, sx0 * 2, sx0 * 3);
+	__m128i step1 = _mm_setr_epi32(0, sx1, sx1 * 2, sx1 * 3);
+	__m128i step2 = _mm_setr_epi32(0, sx2, sx2 * 2, sx2 * 3);
+	__m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i texWMask  = _mm_set1_epi32(st->texWidthMask);
+	__m128i texHMask  = _mm_set1_epi32(st->texHeightMask);
+	__m128i alphaBits = _mm_set1_epi32(BitmapColor_A_Bits(0xFF));
+	__m128i alphaHalf = _mm_set1_epi32(0x7F);
+	__m128 zeroF = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+
+	PackedCol color = V0->c;
+	BitmapCol vColor = BitmapCol_Make(PackedCol_R(color), PackedCol_G(color), PackedCol_B(color), PackedCol_A(color));
+	__m128i vColor16 = _mm_unpacklo_epi8(_mm_set1_epi32(vColor), _mm_setzero_si128());
+	__m128i srcColor = _mm_set1_epi32(vColor);
+	cc_bool texturing = st->texturing;
+
+	if (texturing && st->texSinglePixel) {
+		/* Don't need to calculate complicated texturing in this case */
+		srcColor  = MultiplyColors_SSE2(_mm_set1_epi32(st->texPixels[0]), vColor16);
+		texturing = false;
+	}
+
+	for (int by = minY; by <= maxY; by += SIMD_BLOCK_SIZE)
+	{
+		int blockH = min(SIMD_BLOCK_SIZE, maxY - by + 1);
+
+		for (int bx = minX; bx <= maxX; bx += SIMD_BLOCK_SIZE)
+		{
+			int blockW = min(SIMD_BLOCK_SIZE, maxX - bx + 1);
+			int dx = bx - minX, dy = by - minY;
+			int b0 = e0 + dx * sx0 + dy * sy0;
+			int b1 = e1 + dx * sx1 + dy * sy1;
+			int b2 = e2 + dx * sx2 + dy * sy2;
+
+			// Edge functions are linear, so their max/min across the block is at one of the corners
+			int max0 = b0 + max(sx0, 0) * (blockW - 1) + max(sy0, 0) * (blockH - 1);
+			int max1 = b1 + max(sx1, 0) * (blockW - 1) + max(sy1, 0) * (blockH - 1);
+			int max2 = b2 + max(sx2, 0) * (blockW - 1) + max(sy2, 0) * (blockH - 1);
+			if (max0 < 0 || max1 < 0 || max2 < 0) continue;
+
+			for (int y = by; y < by + blockH; y++, b0 += sy0, b1 += sy1, b2 += sy2)
+			{
+				for (int gx = 0; gx < blockW; gx += 4)
+				{
+					int x = bx + gx, count = min(4, blockW - gx);
+					__m128i bc0 = _mm_add_epi32(_mm_set1_epi32(b0 + gx * sx0), step0);
+					__m128i bc1 = _mm_add_epi32(_mm_set1_epi32(b1 + gx * sx1), step1);
+					__m128i bc2 = _mm_add_epi32(_mm_set1_epi32(b2 + gx * sx2), step2);
+
+					// Pixel is inside when no edge function is negative
+					__m128i mask = _mm_srai_epi32(_mm_or_si128(_mm_or_si128(bc0, bc1), bc2), 31);
+					mask = _mm_andnot_si128(mask, _mm_cmplt_epi32(lanes, _mm_set1_epi32(count)));
+					if (!_mm_movemask_epi8(mask)) continue;
+
+					__m128 ic0 = _mm_mul_ps(_mm_cvtepi32_ps(bc0), factor);
+					__m128 ic1 = _mm_mul_ps(_mm_cvtepi32_ps(bc1), factor);
+					__m128 ic2 = _mm_mul_ps(_mm_cvtepi32_ps(bc2), factor);
+
+					// NOTE: A reciprocal estimate would be faster, but then output would differ from the scalar path
+					__m128 invW = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ic0, w0), _mm_mul_ps(ic1, w1)), _mm_mul_ps(ic2, w2));
+					__m128 w    = _mm_div_ps(one, invW);
+					__m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ic0, z0), _mm_mul_ps(ic1, z1)), _mm_mul_ps(ic2, z2)), w);
+
+					int db_index = y * db_stride + x;
+					int cb_index = y * cb_stride + x;
+					float depths[4];
+					BitmapCol colors[4];
+					__m128 depth;
+					int i;
+
+					if (count == 4) {
+						depth = _mm_loadu_ps(&depthBuffer[db_index]);
+					} else {
+						for (i = 0; i < count; i++) depths[i] = depthBuffer[db_index + i];
+						depth = _mm_loadu_ps(depths);
+					}
+
+					if (st->depthTest) {
+						__m128 pass = _mm_and_ps(_mm_cmpge_ps(z, zeroF), _mm_cmple_ps(z, depth));
+						mask = _mm_and_si128(mask, _mm_castps_si128(pass));
+						if (!_mm_movemask_epi8(mask)) continue;
+					}
+
+					__m128i src = srcColor;
+					if (st->colWrite && texturing) {
+						int texX[4], texY[4];
+						__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ic0, u0), _mm_mul_ps(ic1, u1)), _mm_mul_ps(ic2, u2)), w);
+						__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ic0, v0), _mm_mul_ps(ic1, v1)), _mm_mul_ps(ic2, v2)), w);
+						_mm_storeu_si128((__m128i*)texX, _mm_and_si128(_mm_cvttps_epi32(u), texWMask));
+						_mm_storeu_si128((__m128i*)texY, _mm_and_si128(_mm_cvttps_epi32(v), texHMask));
+
+						src = _mm_setr_epi32(st->texPixels[texY[0] * st->texWidth + texX[0]], st->texPixels[texY[1] * st->texWidth + texX[1]],
+											 st->texPixels[texY[2] * st->texWidth + texX[2]], st->texPixels[texY[3] * st->texWidth + texX[3]]);
+						src = MultiplyColors_SSE2(src, vColor16);
+					}
+
+					if (st->colWrite && st->alphaTest) {
+						__m128i alpha = _mm_srli_epi32(_mm_and_si128(src, alphaBits), BITMAPCOLOR_A_SHIFT);
+						mask = _mm_and_si128(mask, _mm_cmpgt_epi32(alpha, alphaHalf));
+						if (!_mm_movemask_epi8(mask)) continue;
+					}
+
+					if (st->depthWrite) {
+						depth = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(mask), z), _mm_andnot_ps(_mm_castsi128_ps(mask), depth));
+						if (count == 4) {
+							_mm_storeu_ps(&depthBuffer[db_index], depth);
+						} else {
+							_mm_storeu_ps(depths, depth);
+							for (i = 0; i < count; i++) depthBuffer[db_index + i] = depths[i];
+						}
+					}
+					if (!st->colWrite) continue;
+
+					__m128i dst;
+					if (count == 4) {
+						dst = _mm_loadu_si128((__m128i*)&colorBuffer[cb_index]);
+					} else {
+						for (i = 0; i < count; i++) colors[i] = colorBuffer[cb_index + i];
+						dst = _mm_loadu_si128((__m128i*)colors);
+					}
+
+					if (st->alphaBlend) src = BlendColors_SSE2(src, dst);
+					src = _mm_or_si128(src, alphaBits);
+					src = _mm_or_si128(_mm_and_si128(mask, src), _mm_andnot_si128(mask, dst));
+
+					if (count == 4) {
+						_mm_storeu_si128((__m128i*)&colorBuffer[cb_index], src);
+					} else {
+						_mm_storeu_si128((__m128i*)colors, src);
+						for (i = 0; i < count; i++) colorBuffer[cb_index + i] = colors[i];
+					}
+				}
+			}
+		}
+	}
+}
+#endif
+
+static void DrawTriangle3D(const struct RasterState* st, const struct RasterClip* clip, Vertex* V0, Vertex* V1, Vertex* V2) {
 	int x0 = (int)V0->x, y0 = (int)V0->y;
 	int x1 = (int)V1->x, y1 = (int)V1->y;
 	int x2 = (int)V2->x, y2 = (int)V2->y;
@@ -577,18 +903,18 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 	int maxY = max(y0, max(y1, y2));
 
 	int area = edgeFunction(x0,y0, x1,y1, x2,y2);
-	if (faceCulling) {
+	if (st->faceCulling) {
 		// https://gamedev.stackexchange.com/questions/203694/how-to-make-backface-culling-work-correctly-in-both-orthographic-and-perspective
 		if (area < 0) return;
 	}
 
 	// Reject triangles completely outside
-	if (maxX < 0 || minX > fb_maxX) return;
-	if (maxY < 0 || minY > fb_maxY) return;
+	if (maxX < clip->minX || minX > clip->maxX) return;
+	if (maxY < clip->minY || minY > clip->maxY) return;
 
 	// Perform scissoring
-	minX = max(minX, 0); maxX = min(maxX, fb_maxX);
-	minY = max(minY, 0); maxY = min(maxY, fb_maxY);
+	minX = max(minX, clip->minX); maxX = min(maxX, clip->maxX);
+	minY = max(minY, clip->minY); maxY = min(maxY, clip->maxY);
 
 	// NOTE: W in frag variables below is actually 1/W 
 	float factor = 1.0f / area;
@@ -599,11 +925,18 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 		return;
 	}
 
+#ifdef SOFTGPU_SIMD_SSE2
+	if (area && CanDrawSIMD(x0, y0, x1, y1, x2, y2)) {
+		DrawTriangle3D_SSE2(st, V0, V1, V2, area, minX, minY, maxX, maxY);
+		return;
+	}
+#endif
+
 	float z0 = V0->z, z1 = V1->z, z2 = V2->z;
 	PackedCol color = V0->c;
 
-	float u0 = V0->u * curTexWidth,  u1 = V1->u * curTexWidth,  u2 = V2->u * curTexWidth;
-	float v0 = V0->v * curTexHeight, v1 = V1->v * curTexHeight, v2 = V2->v * curTexHeight;
+	float u0 = V0->u * st->texWidth,  u1 = V1->u * st->texWidth,  u2 = V2->u * st->texWidth;
+	float v0 = V0->v * st->texHeight, v1 = V1->v * st->texHeight, v2 = V2->v * st->texHeight;
 	
 	// https://fgiesen.wordpress.com/2013/02/10/optimizing-the-basic-rasterizer/
 	// Essentially these are the deltas of edge functions between X/Y and X/Y + 1 (i.e. one X/Y step)
@@ -618,16 +951,16 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 	int R, G, B, A;
 	int a1, r1, g1, b1;
 	int a2, r2, g2, b2;
-	cc_bool texturing = gfx_format == VERTEX_FORMAT_TEXTURED;
+	cc_bool texturing = st->texturing;
 
 	if (!texturing) {
 		R = PackedCol_R(color);
 		G = PackedCol_G(color);
 		B = PackedCol_B(color);
 		A = PackedCol_A(color);
-	} else if (texSinglePixel) {
+	} else if (st->texSinglePixel) {
 		/* Don't need to calculate complicated texturing in this case */
-		MultiplyColors(color, curTexPixels[0]);
+		MultiplyColors(color, st->texPixels[0]);
 		texturing = false;
 	}
 
@@ -649,34 +982,34 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 			float z = (ic0 * z0 + ic1 * z1 + ic2 * z2) * w;
 
 #ifndef SOFTGPU_DISABLE_ZBUFFER
-			if (depthTest && (z < 0 || z > depthBuffer[db_index])) continue;
-			if (!colWrite) {
-				if (depthWrite) depthBuffer[db_index] = z;
+			if (st->depthTest && (z < 0 || z > depthBuffer[db_index])) continue;
+			if (!st->colWrite) {
+				if (st->depthWrite) depthBuffer[db_index] = z;
 				continue;
 			}
 #else
-			if (!colWrite) continue;
+			if (!st->colWrite) continue;
 #endif
 
 			if (texturing) {
 				float u = (ic0 * u0 + ic1 * u1 + ic2 * u2) * w;
 				float v = (ic0 * v0 + ic1 * v1 + ic2 * v2) * w;
-				int texX = ((int)u) & texWidthMask;
-				int texY = ((int)v) & texHeightMask;
+				int texX = ((int)u) & st->texWidthMask;
+				int texY = ((int)v) & st->texHeightMask;
 
-				int texIndex = texY * curTexWidth + texX;
-				BitmapCol tColor = curTexPixels[texIndex];
+				int texIndex = texY * st->texWidth + texX;
+				BitmapCol tColor = st->texPixels[texIndex];
 
 				MultiplyColors(color, tColor);
 			}
 
-			if (gfx_alphaTest && A < 0x80) continue;
+			if (st->alphaTest && A < 0x80) continue;
 #ifndef SOFTGPU_DISABLE_ZBUFFER
-			if (depthWrite) depthBuffer[db_index] = z;
+			if (st->depthWrite) depthBuffer[db_index] = z;
 #endif
 			int cb_index = y * cb_stride + x;
 			
-			if (!gfx_alphaBlend) {
+			if (!st->alphaBlend) {
 				colorBuffer[cb_index] = BitmapCol_Make(R, G, B, 0xFF);
 				continue;
 			}
@@ -694,6 +1027,173 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 	}
 }
 
+enum TriangleType { TRI_SPRITE_2D, TRI_2D, TRI_3D };
+
+static void RasterTriangle(int type, const struct RasterState* st, const struct RasterClip* clip,
+							Vertex* V0, Vertex* V1, Vertex* V2) {
+	switch (type)
+	{
+	case TRI_SPRITE_2D: DrawSprite2D(st, clip, V0, V1, V2);   break;
+	case TRI_2D:        DrawTriangle2D(st, clip, V0, V1, V2); break;
+	case TRI_3D:        DrawTriangle3D(st, clip, V0, V1, V2); break;
+	}
+}
+
+
+/*########################################################################################################################*
+*--------------------------------------------------------Tile binning-----------------------------------------------------*
+*#########################################################################################################################*/
+#ifdef SOFTGPU_BINNING
+// When enabled, triangles are only sorted into the screen tiles they overlap when drawn,
+//  and then all the tiles are rasterised in parallel by worker threads at the end of the frame
+#define TILE_SHIFT 6
+#define TILE_SIZE  (1 << TILE_SHIFT)
+
+struct BinnedTriangle {
+	Vertex v[3];
+	int type, state;
+};
+struct TileBin { int* tris; int count, capacity; };
+
+static struct BinnedTriangle* binTris;
+static int binTrisCount, binTrisCapacity;
+static struct RasterState* binStates;
+static int binStatesCount, binStatesCapacity;
+
+static struct TileBin* tileBins;
+static int tilesX, tilesY, tilesCount;
+
+static void BinWorkerMain(void);
+static struct WorkerPool binPool = { BinWorkerMain, "SoftGPU rasteriser", 64 * 1024 };
+static void BinWorkerMain(void) { WorkerPool_WorkerMain(&binPool); }
+
+static void AllocTileBins(void) {
+	tilesX     = (fb_width  + TILE_SIZE - 1) >> TILE_SHIFT;
+	tilesY     = (fb_height + TILE_SIZE - 1) >> TILE_SHIFT;
+	tilesCount = tilesX * tilesY;
+	tileBins   = (struct TileBin*)Mem_AllocCleared(tilesCount, sizeof(struct TileBin), "tile bins");
+}
+
+static void FreeTileBins(void) {
+	for (int i = 0; i < tilesCount; i++)
+	{
+		Mem_Free(tileBins[i].tris);
+	}
+	Mem_Free(tileBins);
+	tileBins   = NULL;
+	tilesCount = 0;
+}
+
+static void BinState(void) {
+	// Consecutive triangles usually share the same state
+	if (binStatesCount && Mem_Equal(&binStates[binStatesCount - 1], &curState, sizeof(curState))) return;
+
+	if (binStatesCount == binStatesCapacity) {
+		binStatesCapacity = max(64, binStatesCapacity * 2);
+		binStates = (struct RasterState*)Mem_Realloc(binStates, binStatesCapacity, sizeof(struct RasterState), "binned states");
+	}
+	binStates[binStatesCount++] = curState;
+}
+
+static void BinTriangle(int type, Vertex* V0, Vertex* V1, Vertex* V2) {
+	int minX, minY, maxX, maxY;
+	if (type == TRI_SPRITE_2D) {
+		minX = (int)V0->x; maxX = (int)V1->x;
+		minY = (int)V0->y; maxY = (int)V2->y;
+	} else {
+		int x0 = (int)V0->x, y0 = (int)V0->y;
+		int x1 = (int)V1->x, y1 = (int)V1->y;
+		int x2 = (int)V2->x, y2 = (int)V2->y;
+		minX = min(x0, min(x1, x2)); maxX = max(x0, max(x1, x2));
+		minY = min(y0, min(y1, y2)); maxY = max(y0, max(y1, y2));
+	}
+
+	minX = max(minX, 0); maxX = min(maxX, curState.scissorMaxX);
+	minY = max(minY, 0); maxY = min(maxY, curState.scissorMaxY);
+	if (minX > maxX || minY > maxY) return;
+
+	if (binTrisCount == binTrisCapacity) {
+		binTrisCapacity = max(1024, binTrisCapacity * 2);
+		binTris = (struct BinnedTriangle*)Mem_Realloc(binTris, binTrisCapacity, sizeof(struct BinnedTriangle), "binned triangles");
+	}
+	struct BinnedTriangle* tri = &binTris[binTrisCount];
+	tri->v[0]  = *V0; tri->v[1] = *V1; tri->v[2] = *V2;
+	tri->type  = type;
+	tri->state = binStatesCount - 1;
+
+	for (int ty = minY >> TILE_SHIFT; ty <= (maxY >> TILE_SHIFT); ty++)
+	{
+		for (int tx = minX >> TILE_SHIFT; tx <= (maxX >> TILE_SHIFT); tx++)
+		{
+			struct TileBin* bin = &tileBins[ty * tilesX + tx];
+			if (bin->count == bin->capacity) {
+				bin->capacity = max(64, bin->capacity * 2);
+				bin->tris = (int*)Mem_Realloc(bin->tris, bin->capacity, sizeof(int), "tile bin");
+			}
+			bin->tris[bin->count++] = binTrisCount;
+		}
+	}
+	binTrisCount++;
+}
+
+static void RasterTile(int index) {
+	struct TileBin* bin = &tileBins[index];
+	struct RasterClip clip;
+	int tileX = (index % tilesX) << TILE_SHIFT;
+	int tileY = (index / tilesX) << TILE_SHIFT;
+
+	for (int i = 0; i < bin->count; i++)
+	{
+		struct BinnedTriangle* tri = &binTris[bin->tris[i]];
+		struct RasterState* st     = &binStates[tri->state];
+
+		clip.minX = tileX; clip.maxX = min(tileX + TILE_SIZE - 1, st->scissorMaxX);
+		clip.minY = tileY; clip.maxY = min(tileY + TILE_SIZE - 1, st->scissorMaxY);
+		if (clip.minX > clip.maxX || clip.minY > clip.maxY) continue;
+
+		RasterTriangle(tri->type, st, &clip, &tri->v[0], &tri->v[1], &tri->v[2]);
+	}
+	bin->count = 0;
+}
+
+static void RasterTileJob(int index, int thread) { RasterTile(index); }
+
+// Rasterises all binned triangles
+static void FlushBins(void) {
+	if (!binTrisCount) return;
+	binPool.threads = binThreads;
+	WorkerPool_Run(&binPool, RasterTileJob, tilesCount);
+
+	binTrisCount   = 0;
+	binStatesCount = 0;
+}
+
+static void FreeBins(void) {
+	WorkerPool_Stop(&binPool);
+	FreeTileBins();
+
+	Mem_Free(binTris);
+	Mem_Free(binStates);
+	binTris   = NULL;
+	binStates = NULL;
+	binTrisCount   = 0; binTrisCapacity   = 0;
+	binStatesCount = 0; binStatesCapacity = 0;
+}
+#else
+static void FlushBins(void) { }
+static void FreeBins(void)  { }
+#endif
+
+static void SubmitTriangle(int type, Vertex* V0, Vertex* V1, Vertex* V2) {
+#ifdef SOFTGPU_BINNING
+	if (tileBins) { BinTriangle(type, V0, V1, V2); return; }
+#endif
+	RasterTriangle(type, &curState, &screenClip, V0, V1, V2);
+}
+#define SubmitSprite2D(V0, V1, V2)   SubmitTriangle(TRI_SPRITE_2D, V0, V1, V2)
+#define SubmitTriangle2D(V0, V1, V2) SubmitTriangle(TRI_2D, V0, V1, V2)
+#define SubmitTriangle3D(V0, V1, V2) SubmitTriangle(TRI_3D, V0, V1, V2)
+
 #define V0_VIS (1 << 0)
 #define V1_VIS (1 << 1)
 #define V2_VIS (1 << 2)
@@ -737,7 +1237,7 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(v0, a, b);
+		SubmitTriangle3D(v0, a, b);
 	}
     break;
 	case V1_VIS:
@@ -755,7 +1255,7 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(a, b, v1);
+		SubmitTriangle3D(a, b, v1);
 	} break;
 	case V2_VIS:
 	{
@@ -772,7 +1272,7 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(a, b, v2);
+		SubmitTriangle3D(a, b, v2);
 	} break;
 	case V3_VIS:
 	{
@@ -789,7 +1289,7 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 		
-		DrawTriangle3D(b, v3, a);
+		SubmitTriangle3D(b, v3, a);
 	}
 	break;
 	case V0_VIS | V1_VIS:
@@ -807,8 +1307,8 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(v1, v0,  a);
-		DrawTriangle3D(a,  v0,  b);
+		SubmitTriangle3D(v1, v0,  a);
+		SubmitTriangle3D(a,  v0,  b);
 	} break;
 	// case V0_VIS | V2_VIS: degenerate case that should never happen
 	case V0_VIS | V3_VIS:
@@ -826,8 +1326,8 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(a, v0,  b);
-		DrawTriangle3D(b, v0, v3);
+		SubmitTriangle3D(a, v0,  b);
+		SubmitTriangle3D(b, v0, v3);
 	} break;
 	case V1_VIS | V2_VIS:
 	{
@@ -844,8 +1344,8 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(v1,  b, v2);
-		DrawTriangle3D(v2,  b,  a);
+		SubmitTriangle3D(v1,  b, v2);
+		SubmitTriangle3D(v2,  b,  a);
 	} break;
 	// case V1_VIS | V3_VIS: degenerate case that should never happen
 	case V2_VIS | V3_VIS:
@@ -863,8 +1363,8 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D( b,  a, v2);
-		DrawTriangle3D(v2,  a, v3);
+		SubmitTriangle3D( b,  a, v2);
+		SubmitTriangle3D(v2,  a, v3);
 	} break;
 	case V0_VIS | V1_VIS | V2_VIS:
 	{
@@ -884,9 +1384,9 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(v1, v0, v2);
-		DrawTriangle3D(v2, v0,  a);
-		DrawTriangle3D(v0,  b,  a);
+		SubmitTriangle3D(v1, v0, v2);
+		SubmitTriangle3D(v2, v0,  a);
+		SubmitTriangle3D(v0,  b,  a);
 	} break;
 	case V0_VIS | V1_VIS | V3_VIS:
 	{
@@ -906,9 +1406,9 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(v0, v3, v1);
-		DrawTriangle3D(v1, v3,  a);
-		DrawTriangle3D(v3,  b,  a);
+		SubmitTriangle3D(v0, v3, v1);
+		SubmitTriangle3D(v1, v3,  a);
+		SubmitTriangle3D(v3,  b,  a);
 	} break;
 	case V0_VIS | V2_VIS | V3_VIS:
 	{
@@ -928,9 +1428,9 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(v3, v2, v0);
-		DrawTriangle3D(v0, v2,  a);
-		DrawTriangle3D(v2,  b,  a);
+		SubmitTriangle3D(v3, v2, v0);
+		SubmitTriangle3D(v0, v2,  a);
+		SubmitTriangle3D(v2,  b,  a);
 	} break;
 	case V1_VIS | V2_VIS | V3_VIS:
 	{
@@ -950,9 +1450,9 @@ static void DrawClipped(int mask, Vertex* v0, Vertex* v1, Vertex* v2, Vertex* v3
 		ViewportVertex3D(a);
 		ViewportVertex3D(b);
 
-		DrawTriangle3D(v2, v1, v3);
-		DrawTriangle3D(v3, v1,  a);
-		DrawTriangle3D(v1,  b,  a);
+		SubmitTriangle3D(v2, v1, v3);
+		SubmitTriangle3D(v3, v1,  a);
+		SubmitTriangle3D(v1,  b,  a);
 	} break;
 	}
 }
@@ -961,6 +1461,11 @@ void DrawQuads(int startVertex, int verticesCount, DrawHints hints) {
 	Vertex vertices[4];
 	int j = startVertex;
 
+	CaptureState();
+#ifdef SOFTGPU_BINNING
+	if (tileBins) BinState();
+#endif
+
 	if (gfx_rendering2D && (hints & (DRAW_HINT_SPRITE|DRAW_HINT_RECT))) {
 		// 4 vertices = 1 quad = 2 triangles
 		for (int i = 0; i < verticesCount / 4; i++, j += 4)
@@ -969,7 +1474,7 @@ void DrawQuads(int startVertex, int verticesCount, DrawHints hints) {
 			TransformVertex2D(j + 1, &vertices[1]);
 			TransformVertex2D(j + 2, &vertices[2]);
 
-			DrawSprite2D(&vertices[0], &vertices[1], &vertices[2]);
+			SubmitSprite2D(&vertices[0], &vertices[1], &vertices[2]);
 		}
 	} else if (gfx_rendering2D) {
 		// 4 vertices = 1 quad = 2 triangles
@@ -980,8 +1485,8 @@ void DrawQuads(int startVertex, int verticesCount, DrawHints hints) {
 			TransformVertex2D(j + 2, &vertices[2]);
 			TransformVertex2D(j + 3, &vertices[3]);
 
-			DrawTriangle2D(&vertices[0], &vertices[2], &vertices[1]);
-			DrawTriangle2D(&vertices[2], &vertices[0], &vertices[3]);
+			SubmitTriangle2D(&vertices[0], &vertices[2], &vertices[1]);
+			SubmitTriangle2D(&vertices[2], &vertices[0], &vertices[3]);
 		}
 	} else {
 		// 4 vertices = 1 quad = 2 triangles
@@ -1001,8 +1506,8 @@ void DrawQuads(int startVertex, int verticesCount, DrawHints hints) {
 				ViewportVertex3D(&vertices[2]);
 				ViewportVertex3D(&vertices[3]);
 
-				DrawTriangle3D(&vertices[0], &vertices[2], &vertices[1]);
-				DrawTriangle3D(&vertices[2], &vertices[0], &vertices[3]);
+				SubmitTriangle3D(&vertices[0], &vertices[2], &vertices[1]);
+				SubmitTriangle3D(&vertices[2], &vertices[0], &vertices[3]);
 			} else {
 				// Quad partially visible
 				DrawClipped(clip, &vertices[0], &vertices[1], &vertices[2], &vertices[3]);
@@ -1040,6 +1545,7 @@ static BitmapCol* CB_GetRow(struct Bitmap* bmp, int y, void* ctx) {
 
 cc_result Gfx_TakeScreenshot(struct Stream* output) {
 	struct Bitmap bmp;
+	FlushBins();
 	Bitmap_Init(bmp, fb_width, fb_height, NULL);
 	return Png_Encode(&bmp, output, CB_GetRow, false, NULL);
 }
@@ -1050,6 +1556,7 @@ cc_bool Gfx_GetUIOptions(struct MenuOptionsScreen* s) { return false; }
 void Gfx_BeginFrame(void) { }
 
 void Gfx_EndFrame(void) {
+	FlushBins();
 	Rect2D r = { 0, 0, fb_width, fb_height };
 	Window_DrawFramebuffer(r, &fb_bmp);
 }
@@ -1059,6 +1566,7 @@ void Gfx_SetVSync(cc_bool vsync) {
 }
 
 void Gfx_OnWindowResize(void) {
+	FlushBins();
 	if (depthBuffer) DestroyBuffers();
 
 	fb_width   = Game.Width;
@@ -1075,6 +1583,11 @@ void Gfx_OnWindowResize(void) {
 
 	Gfx_SetViewport(0, 0, Game.Width, Game.Height);
 	Gfx_SetScissor (0, 0, Game.Width, Game.Height);
+
+#ifdef SOFTGPU_BINNING
+	FreeTileBins();
+	if (binThreads) AllocTileBins();
+#endif
 }
 
 void Gfx_SetViewport(int x, int y, int w, int h) {
@@ -118,6 +118,11 @@ static const char* GetCCErrorDesc(cc_result res) {
 	case HTTP_ERR_NO_SSL: return "HTTPS URLs are not currently supported";
 	case SOCK_ERR_UNKNOWN_HOST: return "Host could not be resolved to an IP address";
 	case ERR_NO_NETWORKING: return "No working network access";
+
+	case SNAP_ERR_SIGNATURE: return "Not a snapshot map file";
+	case SNAP_ERR_VERSION:   return "Unsupported snapshot map version";
+	case SNAP_ERR_TRUNCATED: return "Incomplete snapshot map file";
+	case SNAP_ERR_DIMENSIONS: return "Invalid snapshot map dimensions";
 	}
 	return NULL;
 }
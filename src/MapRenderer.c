@@ -16,6 +16,7 @@
 #include "Options.h"
 
 int MapRenderer_1DUsedCount;
+cc_bool MapRenderer_OcclusionCulling;
 struct ChunkPartInfo* MapRenderer_PartsNormal;
 struct ChunkPartInfo* MapRenderer_PartsTranslucent;
 
@@ -33,25 +34,46 @@ static cc_bool checkNormParts[ATLAS1D_MAX_ATLASES], checkTranParts[ATLAS1D_MAX_A
 
 /* Render info for all chunks in the world. Unsorted. */
 static struct ChunkInfo* mapChunks;
-/* Pointers to render info for all chunks in the world, sorted by distance from the camera. */
+/* Pointers to render info for chunks near the camera, sorted by distance from the camera. */
+/* Chunks too far away to be built or rendered are not included in this. */
 static struct ChunkInfo** sortedChunks;
+/* Number of actually used pointers in the sortedChunks array. */
+static int sortedChunksCount;
 /* Pointers to render info for all chunks in the world, sorted by distance from the camera. */
 /* Only chunks that can be rendered (i.e. not empty and are visible) are included in this.  */
 static struct ChunkInfo** renderChunks;
 /* Number of actually used pointers in the renderChunks array. Entries past this are ignored and skipped. */
 static int renderChunksCount;
-/* Distance of each chunk from the camera. */
+/* Distance of each chunk in sortedChunks from the camera. */
 static cc_uint32* distances;
+/* Offset (in chunks) from the camera's chunk, with each axis mirrored to give up to 8 chunks. */
+struct ChunkOffset { cc_uint16 x, y, z; };
+/* Offsets of all chunks close enough to the camera to be in sortedChunks, sorted by distance. */
+/* Avoids having to sort every chunk in the world whenever the camera moves into another chunk. */
+static struct ChunkOffset* sortOffsets;
+static int sortOffsetsCount;
 /* Maximum number of chunk updates that can be performed in one frame. */
 static int maxChunkUpdates;
+/* Time that can be spent building chunks each frame, in microseconds */
+static int chunkBuildBudget;
 /* Cached number of chunks in the world */
 static int chunksCount;
+/* Occlusion culling state of each chunk. (faces entered through, faces processed, whether queued) */
+static cc_uint16* occlusionFlags;
+/* Queue of chunks to visit when calculating which chunks are occluded. */
+static int* occlusionQueue;
+/* Connectivity of each chunk when it was last built. */
+static cc_uint32* builtConnectivity;
+/* Whether which chunks are occluded needs to be recalculated. (e.g. camera moved or chunk connectivity changed) */
+static cc_bool occlusionDirty;
 
 static void ChunkInfo_Init(struct ChunkInfo* chunk, int x, int y, int z) {
 	chunk->centreX = x + HALF_CHUNK_SIZE; chunk->centreY = y + HALF_CHUNK_SIZE; 
 	chunk->centreZ = z + HALF_CHUNK_SIZE;
 #ifndef CC_BUILD_GL11
-	chunk->vb = 0;
+	chunk->vb       = 0;
+	chunk->vbSlot   = 0;
+	chunk->vbOffset = 0;
 #endif
 
 	chunk->visible = true;  
@@ -59,6 +81,9 @@ static void ChunkInfo_Init(struct ChunkInfo* chunk, int x, int y, int z) {
 	chunk->allAir  = false;
 	chunk->noData  = true;
 	chunk->dirty   = true;
+	chunk->occluded     = false;
+	chunk->edited       = false;
+	chunk->connectivity = CHUNK_ALL_CONNECTED;
 
 	chunk->drawXMin = false; chunk->drawXMax = false; chunk->drawZMin = false;
 	chunk->drawZMax = false; chunk->drawYMin = false; chunk->drawYMax = false;
@@ -106,6 +131,24 @@ static void CheckWeather(float delta) {
 	Gfx_SetAlphaBlending(false);
 }
 
+/* Chunks in the same vertex buffer arena page share the same VB, so only need to bind it once */
+#define BindChunkVb(info) if (info->vb != boundVb) { boundVb = info->vb; Gfx_BindVb_Textured(boundVb); }
+#ifdef CC_BUILD_GL11
+#define ChunkVbOffset(info) 0
+#else
+#define ChunkVbOffset(info) info->vbOffset
+#endif
+
+#ifdef CC_BUILD_PACKEDVERTICES
+#define ChunkVertexFormat() (Builder_PackedVertices ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_TEXTURED)
+/* Packed vertex positions are relative to the minimum corner of the chunk */
+#define SetChunkOrigin(info) \
+	if (Builder_PackedVertices) Gfx_SetVertexOrigin(info->centreX - 8, info->centreY - 8, info->centreZ - 8);
+#else
+#define ChunkVertexFormat() VERTEX_FORMAT_TEXTURED
+#define SetChunkOrigin(info)
+#endif
+
 #ifdef CC_BUILD_GL11
 #define DrawFace(face, ign)    Gfx_BindVb(part.vbs[face]); Gfx_DrawIndexedTris_T2fC4b(0, 0);
 #define DrawFaces(f1, f2, ign) DrawFace(f1, ign); DrawFace(f2, ign);
@@ -134,6 +177,9 @@ static void RenderNormalBatch(int batch) {
 	struct ChunkPartInfo part;
 	cc_bool drawMin, drawMax;
 	int i, offset, count;
+#ifndef CC_BUILD_GL11
+	GfxResourceID boundVb = 0;
+#endif
 
 	for (i = 0; i < renderChunksCount; i++) {
 		info = renderChunks[i];
@@ -144,10 +190,11 @@ static void RenderNormalBatch(int batch) {
 		hasNormParts[batch] = true;
 
 #ifndef CC_BUILD_GL11
-		Gfx_BindVb_Textured(info->vb);
+		BindChunkVb(info);
+		SetChunkOrigin(info);
 #endif
 
-		offset  = part.offset + part.spriteCount;
+		offset  = part.offset + part.spriteCount + ChunkVbOffset(info);
 		drawMin = info->drawXMin && part.counts[FACE_XMIN];
 		drawMax = info->drawXMax && part.counts[FACE_XMAX];
 		DrawNormalFaces(FACE_XMIN, FACE_XMAX);
@@ -163,7 +210,7 @@ static void RenderNormalBatch(int batch) {
 		DrawNormalFaces(FACE_YMIN, FACE_YMAX);
 
 		if (!part.spriteCount) continue;
-		offset = part.offset;
+		offset = part.offset + ChunkVbOffset(info);
 		count  = part.spriteCount >> 2; /* 4 per sprite */
 
 		Gfx_SetFaceCulling(true);
@@ -198,7 +245,7 @@ void MapRenderer_RenderNormal(float delta) {
 	int batch;
 	if (!mapChunks) return;
 
-	Gfx_SetVertexFormat(VERTEX_FORMAT_TEXTURED);
+	Gfx_SetVertexFormat(ChunkVertexFormat());
 	Gfx_SetAlphaTest(true);
 	
 	Gfx_EnableMipmaps();
@@ -215,9 +262,6 @@ void MapRenderer_RenderNormal(float delta) {
 
 	CheckWeather(delta);
 	Gfx_SetAlphaTest(false);
-#if DEBUG_OCCLUSION
-	DebugPickedPos();
-#endif
 }
 
 #define DrawTranslucentFaces(minFace, maxFace) \
@@ -238,6 +282,9 @@ static void RenderTranslucentBatch(int batch) {
 	struct ChunkPartInfo part;
 	cc_bool drawMin, drawMax;
 	int i, offset;
+#ifndef CC_BUILD_GL11
+	GfxResourceID boundVb = 0;
+#endif
 
 	for (i = 0; i < renderChunksCount; i++) {
 		info = renderChunks[i];
@@ -248,10 +295,11 @@ static void RenderTranslucentBatch(int batch) {
 		hasTranParts[batch] = true;
 
 #ifndef CC_BUILD_GL11
-		Gfx_BindVb_Textured(info->vb);
+		BindChunkVb(info);
+		SetChunkOrigin(info);
 #endif
 
-		offset  = part.offset;
+		offset  = part.offset + ChunkVbOffset(info);
 		drawMin = (inTranslucent || info->drawXMin) && part.counts[FACE_XMIN];
 		drawMax = (inTranslucent || info->drawXMax) && part.counts[FACE_XMAX];
 		DrawTranslucentFaces(FACE_XMIN, FACE_XMAX);
@@ -274,7 +322,7 @@ void MapRenderer_RenderTranslucent(float delta) {
 
 	/* First fill depth buffer */
 	vertices = Game_Vertices;
-	Gfx_SetVertexFormat(VERTEX_FORMAT_TEXTURED);
+	Gfx_SetVertexFormat(ChunkVertexFormat());
 	Gfx_SetAlphaBlending(false);
 	Gfx_DepthOnlyRendering(true);
 
@@ -325,7 +373,14 @@ static void DeleteChunk(struct ChunkInfo* info) {
 #ifdef CC_BUILD_GL11
 	int j;
 #else
+	#ifdef CC_BUILD_VBARENA
+	if (info->vbSlot) {
+		Gfx_FreeArenaVb(&info->vbSlot);
+		info->vb = 0;
+	}
+	#endif
 	Gfx_DeleteVb(&info->vb);
+	info->vbOffset = 0;
 #endif
 
 	info->empty  = false; 
@@ -333,11 +388,6 @@ static void DeleteChunk(struct ChunkInfo* info) {
 	info->noData = true;
 	info->dirty  = true;
 
-#ifdef OCCLUSION
-	info.OcclusionFlags = 0;
-	info.OccludedFlags = 0;
-#endif
-
 	if (info->normalParts) {
 		ptr = info->normalParts;
 		for (i = 0; i < MapRenderer_1DUsedCount; i++, ptr += chunksCount) {
@@ -363,14 +413,16 @@ static void DeleteChunk(struct ChunkInfo* info) {
 	}
 }
 
-/* Builds the mesh (hence vertex buffer) for the given chunk, and updates internal state */
-static void BuildChunk(struct ChunkInfo* info, int* chunkUpdates) {
+/* Updates internal state after the mesh (hence vertex buffer) for the given chunk has been built */
+static void OnChunkBuilt(struct ChunkInfo* info) {
 	struct ChunkPartInfo* ptr;
-	int i;
+	int i, index = (int)(info - mapChunks);
 
-	Game.ChunkUpdates++;
-	(*chunkUpdates)++;
-	Builder_MakeChunk(info);
+	/* Only need to recalculate occlusion when the rebuilt chunk now connects to different chunks */
+	if (builtConnectivity[index] != info->connectivity) {
+		builtConnectivity[index] = info->connectivity;
+		if (MapRenderer_OcclusionCulling) occlusionDirty = true;
+	}
 
 	info->dirty  = false;
 	info->noData = !info->normalParts && !info->translucentParts;
@@ -392,6 +444,19 @@ static void BuildChunk(struct ChunkInfo* info, int* chunkUpdates) {
 	}
 }
 
+/* Builds (or queues building) the mesh for the given chunk */
+/* Returns whether the chunk was queued to be built later by Builder_BuildQueued */
+static cc_bool BuildChunk(struct ChunkInfo* info, int* chunkUpdates) {
+	Game.ChunkUpdates++;
+	(*chunkUpdates)++;
+	DeleteChunk(info);
+	info->edited = false;
+
+	if (Builder_QueueChunk(info)) return true;
+	OnChunkBuilt(info);
+	return false;
+}
+
 
 /*########################################################################################################################*
 *----------------------------------------------------Chunks mangagement---------------------------------------------------*
@@ -407,11 +472,20 @@ static void FreeChunks(void) {
 	Mem_Free(sortedChunks);
 	Mem_Free(renderChunks);
 	Mem_Free(distances);
+	Mem_Free(occlusionFlags);
+	Mem_Free(occlusionQueue);
+	Mem_Free(builtConnectivity);
+	Mem_Free(sortOffsets);
 
 	mapChunks    = NULL;
 	sortedChunks = NULL;
 	renderChunks = NULL;
 	distances    = NULL;
+	occlusionFlags = NULL;
+	occlusionQueue = NULL;
+	builtConnectivity = NULL;
+	sortOffsets    = NULL;
+	sortedChunksCount = 0;
 }
 
 static void AllocateParts(void) {
@@ -428,6 +502,9 @@ static void AllocateChunks(void) {
 	sortedChunks = (struct ChunkInfo**)Mem_Alloc(chunksCount, sizeof(struct ChunkInfo*), "sorted chunk info");
 	renderChunks = (struct ChunkInfo**)Mem_Alloc(chunksCount, sizeof(struct ChunkInfo*), "render chunk info");
 	distances    = (cc_uint32*)Mem_Alloc(chunksCount, 4, "chunk distances");
+	occlusionFlags = (cc_uint16*)Mem_Alloc(chunksCount, 2, "chunk occlusion flags");
+	occlusionQueue = (int*)Mem_Alloc(chunksCount, sizeof(int), "chunk occlusion queue");
+	builtConnectivity = (cc_uint32*)Mem_Alloc(chunksCount, 4, "chunk connectivity");
 }
 
 static void ResetPartFlags(void) {
@@ -454,13 +531,13 @@ static void InitChunks(void) {
 		for (y = 0; y < World.Height; y += CHUNK_SIZE) {
 			for (x = 0; x < World.Width; x += CHUNK_SIZE) {
 				ChunkInfo_Init(&mapChunks[index], x, y, z);
-				sortedChunks[index] = &mapChunks[index];
 				renderChunks[index] = &mapChunks[index];
-				distances[index]    = 0;
+				builtConnectivity[index] = CHUNK_ALL_CONNECTED;
 				index++;
 			}
 		}
 	}
+	sortedChunksCount = 0;
 }
 
 static void RefreshChunks(void) {
@@ -482,6 +559,9 @@ static void DeleteChunks(void) {
 		DeleteChunk(&mapChunks[i]);
 	}
 	ResetPartCounts();
+#ifdef CC_BUILD_VBARENA
+	Gfx_ReleaseArena();
+#endif
 }
 
 void MapRenderer_Refresh(void) {
@@ -527,8 +607,6 @@ static void RefreshBorderChunks(int maxHeight) {
 /*########################################################################################################################*
 *--------------------------------------------------Chunks updating/sorting------------------------------------------------*
 *#########################################################################################################################*/
-#define CHUNK_TARGET_TIME ((1.0f/30) + 0.01f)
-static int chunksTarget = 12;
 static Vec3 lastCamPos;
 static float lastYaw, lastPitch;
 /* Max distance from camera that chunks are rendered within */
@@ -537,6 +615,10 @@ static int renderDistSquared;
 /* Max distance from camera that chunks are built within */
 /* Chunks past this distance are automatically unloaded */
 static int buildDistSquared;
+/* Distance from camera that built chunks are unloaded at */
+#define UNLOAD_DIST_SQUARED (buildDistSquared + 32 * 16)
+/* Max distance from camera that chunks are included in sortedChunks */
+static int sortDistSquared;
 
 static int AdjustDist(int dist) {
 	if (dist < CHUNK_SIZE) dist = CHUNK_SIZE;
@@ -545,65 +627,132 @@ static int AdjustDist(int dist) {
 }
 
 static void CalcViewDists(void) {
+	int sortDist;
 	buildDistSquared  = AdjustDist(Game_UserViewDistance);
 	renderDistSquared = AdjustDist(Game_ViewDistance);
+
+	sortDist = max(UNLOAD_DIST_SQUARED - 1, renderDistSquared);
+	if (sortDist == sortDistSquared) return;
+	sortDistSquared = sortDist;
+
+	/* Chunk offsets need to be recalculated */
+	Mem_Free(sortOffsets);
+	sortOffsets = NULL;
+	chunkPos    = IVec3_MaxValue();
+}
+
+/* Chunks that need to be rebuilt, by priority. (edited by the player, visible, then not visible) */
+/* Visible and hidden chunks are in order of distance, as sortedChunks is sorted by distance */
+#define MAX_DIRTY_CHUNKS 1024
+static struct ChunkInfo* editedChunks[MAX_DIRTY_CHUNKS];
+static struct ChunkInfo* visibleChunks[MAX_DIRTY_CHUNKS];
+static struct ChunkInfo* hiddenChunks[MAX_DIRTY_CHUNKS];
+static cc_uint32 visibleDists[MAX_DIRTY_CHUNKS], hiddenDists[MAX_DIRTY_CHUNKS];
+static int editedCount, visibleCount, hiddenCount;
+/* Estimated time to build a chunk on worker threads, in microseconds */
+static int queuedChunkCost = 500;
+
+static void AddDirtyChunk(struct ChunkInfo* info, cc_uint32 distSqr) {
+	if (info->edited) {
+		if (editedCount < maxChunkUpdates) editedChunks[editedCount++] = info;
+	} else if (info->visible) {
+		if (visibleCount == maxChunkUpdates) return;
+		visibleDists[visibleCount]  = distSqr;
+		visibleChunks[visibleCount] = info; visibleCount++;
+	} else {
+		if (hiddenCount == maxChunkUpdates) return;
+		hiddenDists[hiddenCount]  = distSqr;
+		hiddenChunks[hiddenCount] = info; hiddenCount++;
+	}
+}
+
+/* Builds the highest priority dirty chunks, until the time budget for this frame is used up */
+static void BuildDirtyChunks(int* chunkUpdates) {
+	cc_uint64 beg = Stopwatch_Measure(), queuedBeg;
+	int v = 0, h = 0, i, queued = 0, elapsed;
+	struct ChunkInfo* info;
+
+	/* Always rebuild chunks edited by the player, so that the change is seen straight away */
+	for (i = 0; i < editedCount; i++) 
+	{
+		queued += BuildChunk(editedChunks[i], chunkUpdates);
+	}
+
+	while ((v < visibleCount || h < hiddenCount) && *chunkUpdates < maxChunkUpdates) 
+	{
+		/* Chunks being built on worker threads have not actually used any time yet */
+		elapsed = (int)Stopwatch_ElapsedMicroseconds(beg, Stopwatch_Measure());
+		if (elapsed + queued * queuedChunkCost >= chunkBuildBudget) break;
+
+		/* Hidden chunks are only built first when they are less than half as far away */
+		if (h == hiddenCount || (v < visibleCount && visibleDists[v] / 4 <= hiddenDists[h])) {
+			info = visibleChunks[v++];
+		} else {
+			info = hiddenChunks[h++];
+		}
+		queued += BuildChunk(info, chunkUpdates);
+	}
+	editedCount = 0; visibleCount = 0; hiddenCount = 0;
+	if (!queued) return;
+
+	/* Chunks may have been queued to be built on worker threads */
+	queuedBeg = Stopwatch_Measure();
+	Builder_BuildQueued(OnChunkBuilt);
+	elapsed   = (int)Stopwatch_ElapsedMicroseconds(queuedBeg, Stopwatch_Measure()) / queued;
+	/* Smooth out the estimate, as build time varies a lot between chunks */
+	queuedChunkCost = (queuedChunkCost * 3 + max(elapsed, 1)) / 4;
 }
 
-static int UpdateChunksAndVisibility(int* chunkUpdates) {
+static int UpdateChunksAndVisibility(void) {
 	int renderDistSqr = renderDistSquared;
 	int buildDistSqr  = buildDistSquared;
 
 	struct ChunkInfo* info;
 	int i, j = 0, distSqr;
 
-	for (i = 0; i < chunksCount; i++) 
+	for (i = 0; i < sortedChunksCount; i++) 
 	{
 		info = sortedChunks[i];
 		if (info->empty) continue;
 		distSqr = distances[i];
 		
 		/* Auto unload chunks far away chunks */
-		if (!info->noData && distSqr >= buildDistSqr + 32 * 16) {
+		if (!info->noData && distSqr >= UNLOAD_DIST_SQUARED) {
 			DeleteChunk(info); continue;
 		}
 
-		if (info->dirty && distSqr <= buildDistSqr && *chunkUpdates < chunksTarget) {
-			DeleteChunk(info);
-			BuildChunk(info, chunkUpdates);
-		}
-
-		info->visible = distSqr <= renderDistSqr &&
+		info->visible = distSqr <= renderDistSqr && !info->occluded &&
 			FrustumCulling_SphereInFrustum(info->centreX, info->centreY, info->centreZ, 14); /* 14 ~ sqrt(3 * 8^2) */
+		if (info->dirty && distSqr <= buildDistSqr) AddDirtyChunk(info, distSqr);
+
 		if (info->visible && !info->empty) { renderChunks[j] = info; j++; }
 	}
 	return j;
 }
 
-static int UpdateChunksStill(int* chunkUpdates) {
+static int UpdateChunksStill(void) {
 	int renderDistSqr = renderDistSquared;
 	int buildDistSqr  = buildDistSquared;
 
 	struct ChunkInfo* info;
 	int i, j = 0, distSqr;
 
-	for (i = 0; i < chunksCount; i++) 
+	for (i = 0; i < sortedChunksCount; i++) 
 	{
 		info = sortedChunks[i];
 		if (info->empty) continue;
 		distSqr = distances[i];
 
 		/* Auto unload chunks far away chunks */
-		if (!info->noData && distSqr >= buildDistSqr + 32 * 16) {
+		if (!info->noData && distSqr >= UNLOAD_DIST_SQUARED) {
 			DeleteChunk(info); continue;
 		}
 
-		if (info->dirty && distSqr <= buildDistSqr && *chunkUpdates < chunksTarget) {
-			DeleteChunk(info);
-			BuildChunk(info, chunkUpdates);
-
+		if (info->dirty && distSqr <= buildDistSqr) {
 			/* only need to update the visibility of chunks in range. */
-			info->visible = distSqr <= renderDistSqr &&
+			info->visible = distSqr <= renderDistSqr && !info->occluded &&
 				FrustumCulling_SphereInFrustum(info->centreX, info->centreY, info->centreZ, 14); /* 14 ~ sqrt(3 * 8^2) */
+			AddDirtyChunk(info, distSqr);
 			if (info->visible && !info->empty) { renderChunks[j] = info; j++; }
 		} else if (info->visible) {
 			renderChunks[j] = info; j++;
@@ -612,22 +761,20 @@ static int UpdateChunksStill(int* chunkUpdates) {
 	return j;
 }
 
-static void UpdateChunks(float delta) {
+static void UpdateChunks(cc_bool occlusionChanged) {
 	struct LocalPlayer* p;
 	cc_bool samePos;
 	int chunkUpdates = 0;
 
-	/* Build more chunks if 30 FPS or over, otherwise slowdown */
-	chunksTarget += delta < CHUNK_TARGET_TIME ? 1 : -1; 
-	Math_Clamp(chunksTarget, 4, maxChunkUpdates);
-
 	p = Entities.CurPlayer;
-	samePos = Vec3_Equals(&Camera.CurrentPos, &lastCamPos)
+	/* Visibility of all chunks needs to be recalculated when which chunks are occluded changed */
+	samePos = !occlusionChanged && Vec3_Equals(&Camera.CurrentPos, &lastCamPos)
 		&& p->Base.Pitch == lastPitch && p->Base.Yaw == lastYaw;
 
 	renderChunksCount = samePos ?
-		UpdateChunksStill(&chunkUpdates) :
-		UpdateChunksAndVisibility(&chunkUpdates);
+		UpdateChunksStill() :
+		UpdateChunksAndVisibility();
+	BuildDirtyChunks(&chunkUpdates);
 
 	lastCamPos = Camera.CurrentPos;
 	lastPitch  = p->Base.Pitch;
@@ -655,11 +802,149 @@ static void SortMapChunks(int left, int right) {
 	}
 }
 
-static void UpdateSortOrder(void) {
+static void SortChunkOffsets(struct ChunkOffset* values, cc_uint32* keys, int left, int right) {
+	struct ChunkOffset value; cc_uint32 key;
+
+	while (left < right) {
+		int i = left, j = right;
+		cc_uint32 pivot = keys[(i + j) >> 1];
+
+		/* partition the list */
+		while (i <= j) {
+			while (pivot > keys[i]) i++;
+			while (pivot < keys[j]) j--;
+			QuickSort_Swap_KV_Maybe();
+		}
+		/* recurse into the smaller subset */
+		if (j - left <= right - i) {
+			if (left < j) SortChunkOffsets(values, keys, left, j);
+			left = i;
+		} else {
+			if (i < right) SortChunkOffsets(values, keys, i, right);
+			right = j;
+		}
+	}
+}
+
+/* Calculates offsets of all chunks within sorting distance, sorted by distance */
+/* Only one octant is stored, since the other 7 octants are just mirrors of it */
+static void CalcSortOffsets(void) {
+	cc_uint32* keys = NULL;
+	int x, y, z, dist, count = 0;
+
+	/* First pass counts, second pass fills in the offsets */
+	for (;;) {
+		for (z = 0; z < World.ChunksZ; z++) {
+			if (z * z * (CHUNK_SIZE * CHUNK_SIZE) > sortDistSquared) break;
+
+			for (y = 0; y < World.ChunksY; y++) {
+				if ((y * y + z * z) * (CHUNK_SIZE * CHUNK_SIZE) > sortDistSquared) break;
+
+				for (x = 0; x < World.ChunksX; x++) {
+					dist = (x * x + y * y + z * z) * (CHUNK_SIZE * CHUNK_SIZE);
+					if (dist > sortDistSquared) break;
+
+					if (sortOffsets) {
+						sortOffsets[count].x = x; sortOffsets[count].y = y; sortOffsets[count].z = z;
+						keys[count] = dist;
+					}
+					count++;
+				}
+			}
+		}
+
+		if (sortOffsets) break;
+		sortOffsetsCount = count; count = 0;
+		sortOffsets = (struct ChunkOffset*)Mem_Alloc(sortOffsetsCount, sizeof(struct ChunkOffset), "chunk offsets");
+		keys        = (cc_uint32*)Mem_Alloc(sortOffsetsCount, 4, "chunk offset distances");
+	}
+
+	SortChunkOffsets(sortOffsets, keys, 0, sortOffsetsCount - 1);
+	Mem_Free(keys);
+}
+
+static void AddSortedChunk(struct ChunkInfo* info, IVec3 pos) {
+	int dx, dy, dz;
+	/* Calculate distance to chunk centre */
+	dx = info->centreX - pos.x; dy = info->centreY - pos.y; dz = info->centreZ - pos.z;
+	sortedChunks[sortedChunksCount] = info;
+	distances[sortedChunksCount]    = dx * dx + dy * dy + dz * dz;
+	sortedChunksCount++;
+
+	/* Consider these 3 chunks: */
+	/* |       X-1      |        X        |       X+1      | */
+	/* |################|########@########|################| */
+	/* Assume the player is standing at @, then DrawXMin/XMax is calculated as this */
+	/*    X-1: DrawXMin = false, DrawXMax = true  */
+	/*    X  : DrawXMin = true,  DrawXMax = true  */
+	/*    X+1: DrawXMin = true,  DrawXMax = false */
+
+	info->drawXMin = dx >= 0; info->drawXMax = dx <= 0;
+	info->drawZMin = dz >= 0; info->drawZMax = dz <= 0;
+	info->drawYMin = dy >= 0; info->drawYMax = dy <= 0;
+}
+
+/* Unloads chunks that were in range of the old camera position but are now too far away */
+static void UnloadSortedChunks(IVec3 pos) {
 	struct ChunkInfo* info;
-	IVec3 pos;
 	int i, dx, dy, dz;
 
+	for (i = 0; i < sortedChunksCount; i++) 
+	{
+		info = sortedChunks[i];
+		if (info->noData) continue;
+
+		dx = info->centreX - pos.x; dy = info->centreY - pos.y; dz = info->centreZ - pos.z;
+		if (dx * dx + dy * dy + dz * dz >= UNLOAD_DIST_SQUARED) DeleteChunk(info);
+	}
+}
+
+/* Sorts chunks by walking the precalculated offsets outwards from the camera's chunk */
+static void SortChunksByOffsets(IVec3 pos) {
+	struct ChunkOffset* offset;
+	int cx = pos.x >> CHUNK_SHIFT, cy = pos.y >> CHUNK_SHIFT, cz = pos.z >> CHUNK_SHIFT;
+	int i, j, x, y, z;
+
+	for (i = 0; i < sortOffsetsCount; i++) 
+	{
+		offset = &sortOffsets[i];
+		/* Bit 0/1/2 selects whether offset is mirrored on X/Y/Z axis */
+		for (j = 0; j < 8; j++) 
+		{
+			if ((j & 1) && !offset->x) continue;
+			if ((j & 2) && !offset->y) continue;
+			if ((j & 4) && !offset->z) continue;
+
+			x = (j & 1) ? cx - offset->x : cx + offset->x;
+			y = (j & 2) ? cy - offset->y : cy + offset->y;
+			z = (j & 4) ? cz - offset->z : cz + offset->z;
+
+			if (x < 0 || y < 0 || z < 0 || x >= World.ChunksX || y >= World.ChunksY || z >= World.ChunksZ) continue;
+			AddSortedChunk(&mapChunks[World_ChunkPack(x, y, z)], pos);
+		}
+	}
+}
+
+/* Sorts all chunks within sorting distance of the camera */
+/* Only used when the camera is outside the map, since offsets only extend as far as the map does */
+static void SortChunksByDistance(IVec3 pos) {
+	struct ChunkInfo* info;
+	int i, dx, dy, dz;
+
+	for (i = 0; i < chunksCount; i++) 
+	{
+		info = &mapChunks[i];
+		dx = info->centreX - pos.x; dy = info->centreY - pos.y; dz = info->centreZ - pos.z;
+		if (dx * dx + dy * dy + dz * dz > sortDistSquared) continue;
+
+		AddSortedChunk(info, pos);
+	}
+	SortMapChunks(0, sortedChunksCount - 1);
+}
+
+static void UpdateSortOrder(void) {
+	IVec3 pos;
+
 	/* pos is centre coordinate of chunk camera is in */
 	IVec3_Floor(&pos, &Camera.CurrentPos);
 	pos.x = (pos.x & ~CHUNK_MASK) + HALF_CHUNK_SIZE;
@@ -671,34 +956,149 @@ static void UpdateSortOrder(void) {
 	chunkPos = pos;
 	if (!chunksCount) return;
 
-	for (i = 0; i < chunksCount; i++) {
-		info = sortedChunks[i];
-		/* Calculate distance to chunk centre */
-		dx = info->centreX - pos.x; dy = info->centreY - pos.y; dz = info->centreZ - pos.z;
-		distances[i] = dx * dx + dy * dy + dz * dz;
-
-		/* Consider these 3 chunks: */
-		/* |       X-1      |        X        |       X+1      | */
-		/* |################|########@########|################| */
-		/* Assume the player is standing at @, then DrawXMin/XMax is calculated as this */
-		/*    X-1: DrawXMin = false, DrawXMax = true  */
-		/*    X  : DrawXMin = true,  DrawXMax = true  */
-		/*    X+1: DrawXMin = true,  DrawXMax = false */
+	UnloadSortedChunks(pos);
+	sortedChunksCount = 0;
 
-		info->drawXMin = dx >= 0; info->drawXMax = dx <= 0;
-		info->drawZMin = dz >= 0; info->drawZMax = dz <= 0;
-		info->drawYMin = dy >= 0; info->drawYMax = dy <= 0;
+	if (World_Contains(pos.x, pos.y, pos.z)) {
+		if (!sortOffsets) CalcSortOffsets();
+		SortChunksByOffsets(pos);
+	} else {
+		SortChunksByDistance(pos);
 	}
 
-	SortMapChunks(0, chunksCount - 1);
 	ResetPartFlags();
-	/*SimpleOcclusionCulling();*/
+	if (MapRenderer_OcclusionCulling) occlusionDirty = true;
 }
 
+
+/*########################################################################################################################*
+*----------------------------------------------------Occlusion culling----------------------------------------------------*
+*#########################################################################################################################*/
+/* Chunks are flood filled outwards from the chunk the camera is in, and can only be seen through */
+/*  if the face they were entered through is connected to the face being left through. */
+/* Since lines of sight never turn back towards the camera, only faces moving away are followed. */
+#define OCCLUSION_FACES_MASK      0x3F
+#define OCCLUSION_PROCESSED_SHIFT 6
+#define OCCLUSION_QUEUED          (1 << 12)
+static int occlusionHead, occlusionCount;
+
+static void Occlusion_Enter(int cx, int cy, int cz, Face face) {
+	int index = World_ChunkPack(cx, cy, cz);
+	struct ChunkInfo* info = &mapChunks[index];
+	int dx, dy, dz;
+	if (occlusionFlags[index] & (1 << face)) return;
+
+	/* Chunks past render distance are never rendered anyway */
+	dx = info->centreX - chunkPos.x; dy = info->centreY - chunkPos.y; dz = info->centreZ - chunkPos.z;
+	if (dx * dx + dy * dy + dz * dz > renderDistSquared) return;
+
+	info->occluded = false;
+	occlusionFlags[index] |= 1 << face;
+	if (occlusionFlags[index] & OCCLUSION_QUEUED) return;
+
+	occlusionFlags[index] |= OCCLUSION_QUEUED;
+	occlusionQueue[(occlusionHead + occlusionCount) % chunksCount] = index;
+	occlusionCount++;
+}
+
+/* Whether any of the given faces are connected to the given face */
+static cc_bool Occlusion_Connected(cc_uint32 connectivity, int faces, Face exit) {
+	int face;
+	for (face = 0; face < FACE_COUNT; face++) 
+	{
+		if (face == exit || !(faces & (1 << face))) continue;
+		if (connectivity & CHUNK_FACES_BIT(face, exit)) return true;
+	}
+	return false;
+}
+
+static void Occlusion_Visit(int index, int camX, int camY, int camZ) {
+	struct ChunkInfo* info = &mapChunks[index];
+	cc_uint32 conn = info->connectivity;
+	int flags = occlusionFlags[index];
+	int cx = info->centreX >> CHUNK_SHIFT, cy = info->centreY >> CHUNK_SHIFT, cz = info->centreZ >> CHUNK_SHIFT;
+	/* Only need to process faces not already processed in a previous visit */
+	int faces = (flags & ~(flags >> OCCLUSION_PROCESSED_SHIFT)) & OCCLUSION_FACES_MASK;
+
+	flags |= faces << OCCLUSION_PROCESSED_SHIFT;
+	occlusionFlags[index] = flags & ~OCCLUSION_QUEUED;
+
+	if (cx > 0                  && cx <= camX && Occlusion_Connected(conn, faces, FACE_XMIN)) Occlusion_Enter(cx - 1, cy, cz, FACE_XMAX);
+	if (cx < World.ChunksX - 1  && cx >= camX && Occlusion_Connected(conn, faces, FACE_XMAX)) Occlusion_Enter(cx + 1, cy, cz, FACE_XMIN);
+	if (cz > 0                  && cz <= camZ && Occlusion_Connected(conn, faces, FACE_ZMIN)) Occlusion_Enter(cx, cy, cz - 1, FACE_ZMAX);
+	if (cz < World.ChunksZ - 1  && cz >= camZ && Occlusion_Connected(conn, faces, FACE_ZMAX)) Occlusion_Enter(cx, cy, cz + 1, FACE_ZMIN);
+	if (cy > 0                  && cy <= camY && Occlusion_Connected(conn, faces, FACE_YMIN)) Occlusion_Enter(cx, cy - 1, cz, FACE_YMAX);
+	if (cy < World.ChunksY - 1  && cy >= camY && Occlusion_Connected(conn, faces, FACE_YMAX)) Occlusion_Enter(cx, cy + 1, cz, FACE_YMIN);
+}
+
+static void CalcOcclusion(void) {
+	int i, index, cx, cy, cz;
+	cc_bool culling;
+	IVec3 pos;
+
+	occlusionDirty = false;
+
+	IVec3_Floor(&pos, &Camera.CurrentPos);
+	cx = pos.x >> CHUNK_SHIFT; cy = pos.y >> CHUNK_SHIFT; cz = pos.z >> CHUNK_SHIFT;
+	/* Can't reliably work out what is visible when camera is outside the map or inside a solid block */
+	culling = World_Contains(pos.x, pos.y, pos.z) && !Blocks.FullOpaque[World_GetBlock(pos.x, pos.y, pos.z)];
+
+	/* Chunks not in sortedChunks are too far away to be rendered anyway */
+	for (i = 0; i < sortedChunksCount; i++) 
+	{
+		sortedChunks[i]->occluded = culling;
+		occlusionFlags[sortedChunks[i] - mapChunks] = 0;
+	}
+	if (!culling) return;
+
+	/* Camera can see out of every face of the chunk it is in */
+	index = World_ChunkPack(cx, cy, cz);
+	mapChunks[index].occluded = false;
+	occlusionFlags[index]     = OCCLUSION_FACES_MASK | (OCCLUSION_FACES_MASK << OCCLUSION_PROCESSED_SHIFT);
+
+	occlusionHead  = 0;
+	occlusionCount = 0;
+	if (cx > 0)                 Occlusion_Enter(cx - 1, cy, cz, FACE_XMAX);
+	if (cx < World.ChunksX - 1) Occlusion_Enter(cx + 1, cy, cz, FACE_XMIN);
+	if (cz > 0)                 Occlusion_Enter(cx, cy, cz - 1, FACE_ZMAX);
+	if (cz < World.ChunksZ - 1) Occlusion_Enter(cx, cy, cz + 1, FACE_ZMIN);
+	if (cy > 0)                 Occlusion_Enter(cx, cy - 1, cz, FACE_YMAX);
+	if (cy < World.ChunksY - 1) Occlusion_Enter(cx, cy + 1, cz, FACE_YMIN);
+
+	while (occlusionCount) {
+		index = occlusionQueue[occlusionHead];
+		occlusionHead = (occlusionHead + 1) % chunksCount;
+		occlusionCount--;
+		Occlusion_Visit(index, cx, cy, cz);
+	}
+}
+
+#ifdef CC_BUILD_VBARENA
+/* Rebuilding the chunk moves its mesh into another arena page */
+static void EvictChunk(void* owner) {
+	struct ChunkInfo* info = (struct ChunkInfo*)owner;
+	int dx = info->centreX - chunkPos.x, dy = info->centreY - chunkPos.y, dz = info->centreZ - chunkPos.z;
+
+	/* Chunks past build distance are never rebuilt, so just delete their mesh instead */
+	if (dx * dx + dy * dy + dz * dz > buildDistSquared) {
+		DeleteChunk(info);
+	} else {
+		ChunkInfo_Refresh(info);
+	}
+}
+#endif
+
 void MapRenderer_Update(float delta) {
+	cc_bool occlusionChanged;
 	if (!mapChunks) return;
 	UpdateSortOrder();
-	UpdateChunks(delta);
+
+	occlusionChanged = occlusionDirty;
+	if (occlusionChanged) CalcOcclusion();
+	UpdateChunks(occlusionChanged);
+#ifdef CC_BUILD_VBARENA
+	Gfx_CompactArena(EvictChunk);
+#endif
 }
 
 
@@ -713,6 +1113,25 @@ void MapRenderer_RefreshChunk(int cx, int cy, int cz) {
 	ChunkInfo_Refresh(chunk);
 }
 
+/* Prioritises rebuilding chunks around blocks the player changes */
+static void OnUserBlockChanged(void* obj, IVec3 coords, BlockID old, BlockID now) {
+	int minX = max(0, coords.x - 1) >> CHUNK_SHIFT, maxX = min(World.MaxX, coords.x + 1) >> CHUNK_SHIFT;
+	int minY = max(0, coords.y - 1) >> CHUNK_SHIFT, maxY = min(World.MaxY, coords.y + 1) >> CHUNK_SHIFT;
+	int minZ = max(0, coords.z - 1) >> CHUNK_SHIFT, maxZ = min(World.MaxZ, coords.z + 1) >> CHUNK_SHIFT;
+	struct ChunkInfo* chunk;
+	int cx, cy, cz;
+	if (!mapChunks) return;
+
+	/* Chunks next to the block may also need rebuilding, when the block is on the edge of a chunk */
+	for (cy = minY; cy <= maxY; cy++)
+		for (cz = minZ; cz <= maxZ; cz++)
+			for (cx = minX; cx <= maxX; cx++)
+	{
+		chunk = &mapChunks[World_ChunkPack(cx, cy, cz)];
+		if (chunk->dirty) chunk->edited = true;
+	}
+}
+
 void MapRenderer_OnBlockChanged(int x, int y, int z, BlockID block) {
 	int cx = x >> CHUNK_SHIFT, cy = y >> CHUNK_SHIFT, cz = z >> CHUNK_SHIFT;
 	struct ChunkInfo* chunk;
@@ -790,6 +1209,7 @@ static void OnInit(void) {
 	Event_Register_(&TextureEvents.AtlasChanged,  NULL, OnTerrainAtlasChanged);
 	Event_Register_(&WorldEvents.EnvVarChanged,   NULL, OnEnvVariableChanged);
 	Event_Register_(&BlockEvents.BlockDefChanged, NULL, OnBlockDefinitionChanged);
+	Event_Register_(&UserEvents.BlockChanged,     NULL, OnUserBlockChanged);
 
 	Event_Register_(&GfxEvents.ViewDistanceChanged, NULL, OnVisibilityChanged);
 	Event_Register_(&GfxEvents.ProjectionChanged,   NULL, OnVisibilityChanged);
@@ -799,7 +1219,9 @@ static void OnInit(void) {
 	/* This = 87 fixes map being invisible when no textures */
 	MapRenderer_1DUsedCount = 87; /* Atlas1D_UsedAtlasesCount(); */
 	chunkPos   = IVec3_MaxValue();
-	maxChunkUpdates = Options_GetInt(OPT_MAX_CHUNK_UPDATES, 4, 1024, 30);
+	maxChunkUpdates  = Options_GetInt(OPT_MAX_CHUNK_UPDATES, 4, MAX_DIRTY_CHUNKS, 256);
+	chunkBuildBudget = Options_GetInt(OPT_CHUNK_BUILD_BUDGET, 1, 100, 5) * 1000;
+	MapRenderer_OcclusionCulling = Options_GetBool(OPT_OCCLUSION_CULLING, true);
 	CalcViewDists();
 }
 
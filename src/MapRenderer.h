@@ -14,6 +14,8 @@ extern struct IGameComponent MapRenderer_Component;
 
 /* Max used 1D atlases. (i.e. Atlas1D_Index(maxTextureLoc) + 1) */
 extern int MapRenderer_1DUsedCount;
+/* Whether chunks hidden behind other chunks (e.g. caves behind solid rock) are skipped when rendering. */
+extern cc_bool MapRenderer_OcclusionCulling;
 
 /* Buffer for all chunk parts. There are (MapRenderer_ChunksCount * Atlas1D_Count) parts in the buffer,
 with parts for 'normal' buffer being in lower half. */
@@ -32,6 +34,10 @@ struct ChunkPartInfo {
 	cc_uint16 counts[FACE_COUNT]; /* Counts per face */
 };
 
+/* Bit in ChunkInfo connectivity for whether the two given faces of the chunk are connected */
+#define CHUNK_FACES_BIT(a, b) ((cc_uint32)1 << ((a) < (b) ? (a) * FACE_COUNT + (b) : (b) * FACE_COUNT + (a)))
+#define CHUNK_ALL_CONNECTED 0xFFFFFFFFUL
+
 /* Describes data necessary for rendering a chunk. */
 struct ChunkInfo {	
 	cc_uint16 centreX, centreY, centreZ; /* Centre coordinates of the chunk */
@@ -41,6 +47,8 @@ struct ChunkInfo {
 	cc_uint8 dirty : 1;   /* Whether chunk is pending being rebuilt */
 	cc_uint8 allAir : 1;  /* Whether chunk is completely air */
 	cc_uint8 noData : 1;  /* Whether the chunk is currently empty of data, but may have data if built */
+	cc_uint8 occluded : 1; /* Whether chunk is hidden from the camera behind other chunks */
+	cc_uint8 edited : 1;  /* Whether chunk is pending being rebuilt because the player changed a block in it */
 	cc_uint8 : 0;         /* pad to next byte*/
 
 	cc_uint8 drawXMin : 1;
@@ -50,12 +58,12 @@ struct ChunkInfo {
 	cc_uint8 drawYMin : 1;
 	cc_uint8 drawYMax : 1;
 	cc_uint8 : 0;          /* pad to next byte */
-#ifdef OCCLUSION
-	public cc_bool Visited = false, Occluded = false;
-	public byte OcclusionFlags, OccludedFlags, DistanceFlags;
-#endif
+	/* Which pairs of faces of this chunk are connected through non-opaque blocks (see CHUNK_FACES_BIT) */
+	cc_uint32 connectivity;
 #ifndef CC_BUILD_GL11
 	GfxResourceID vb;
+	int vbSlot;   /* Slot in the vertex buffer arena, 0 if vb is only used by this chunk */
+	int vbOffset; /* Index of the first vertex of this chunk in vb */
 #endif
 	struct ChunkPartInfo* normalParts;
 	struct ChunkPartInfo* translucentParts;
@@ -1357,12 +1357,34 @@ static void SaveLevelScreen_RemoveOverwrites(struct SaveLevelScreen* s) {
 static cc_result DoSaveMap(const cc_string* path, struct GZipState* state) {
 	static const cc_string schematic = String_FromConst(".schematic");
 	static const cc_string mine      = String_FromConst(".mine");
+	static const cc_string snapshot  = String_FromConst(".ccmap");
 	struct Stream stream, compStream;
 	cc_result res;
+	int level;
+
+	/* The map may be being saved over the file it was memory mapped from */
+	res = Map_ReleaseFile(path);
+	if (res) { Logger_SysWarn2(res, "saving", path); return res; }
 
 	res = Stream_CreateFile(&stream, path);
 	if (res) { Logger_SysWarn2(res, "creating", path); return res; }
+
+	/* Snapshots are written uncompressed, so they can be memory mapped when loaded */
+	if (String_CaselessEnds(path, &snapshot)) {
+		res = Snapshot_Save(&stream);
+		if (res) {
+			stream.Close(&stream);
+			Logger_SysWarn2(res, "encoding", path); return res;
+		}
+
+		res = stream.Close(&stream);
+		if (res) { Logger_SysWarn2(res, "closing", path); return res; }
+		return 0;
+	}
+
 	GZip_MakeStream(&compStream, state, &stream);
+	level = Options_GetInt(OPT_SAVE_COMPRESSION, DEFLATE_LEVEL_NONE, DEFLATE_LEVEL_BEST, DEFLATE_LEVEL_DEFAULT);
+	Deflate_SetLevel(&state->Base, level);
 
 	if (String_CaselessEnds(path, &schematic)) {
 		res = Schematic_Save(&compStream);
@@ -1444,10 +1466,10 @@ static void SaveLevelScreen_UploadCallback(const cc_string* path) {
 
 static void SaveLevelScreen_File(void* screen, void* b) {
 	static const char* const titles[] = {
-		"ClassiCube map", "Minecraft schematic", "Minecraft classic map", NULL
+		"ClassiCube map", "Minecraft schematic", "Minecraft classic map", "ClassiCube snapshot", NULL
 	};
 	static const char* const filters[] = {
-		".cw", ".schematic", ".mine", NULL
+		".cw", ".schematic", ".mine", ".ccmap", NULL
 	};
 	struct SaveLevelScreen* s = (struct SaveLevelScreen*)screen;
 	struct SaveFileDialogArgs args;
@@ -1847,7 +1869,7 @@ static void LoadLevelScreen_LoadEntries(struct ListScreen* s) {
 static void LoadLevelScreen_UploadCallback(const cc_string* path) { Map_LoadFrom(path); }
 static void LoadLevelScreen_ActionFunc(void* s, void* w) {
 	static const char* const filters[] = { 
-		".cw", ".dat", ".lvl", ".mine", ".fcm", ".mclevel", NULL 
+		".cw", ".dat", ".lvl", ".mine", ".fcm", ".mclevel", ".ccmap", NULL 
 	}; /* TODO not hardcode list */
 	static struct OpenFileDialogArgs args = {
 		"Classic map files", filters,
@@ -31,6 +31,7 @@ Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 #define OPT_WINDOW_WIDTH "window-width"
 #define OPT_WINDOW_HEIGHT "window-height"
 #define OPT_AUTO_PAUSE "auto-pause"
+#define OPT_SAVE_COMPRESSION "save-compression"
 
 #define OPT_HACKS_ENABLED "hacks-hacksenabled"
 #define OPT_FIELD_OF_VIEW "hacks-fov"
@@ -72,12 +73,21 @@ Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 #define OPT_CLASSIC_CHAT "nostalgia-classicchat"
 #define OPT_CLASSIC_INVENTORY "nostalgia-classicinventory"
 #define OPT_MAX_CHUNK_UPDATES "gfx-maxchunkupdates"
+#define OPT_CHUNK_BUILD_BUDGET "gfx-chunkbudget"
+#define OPT_BUILDER_THREADS "gfx-builderthreads"
+#define OPT_GREEDY_MESHING "gfx-greedymeshing"
+#define OPT_PACKED_VERTICES "gfx-packedvertices"
+#define OPT_OCCLUSION_CULLING "gfx-occlusionculling"
+#define OPT_SOFTGPU_THREADS "gfx-softgputhreads"
+#define OPT_GEN_THREADS "gen-threads"
 #define OPT_CAMERA_MASS "cameramass"
 #define OPT_CAMERA_SMOOTH "camera-smooth"
 #define OPT_GRAB_CURSOR "win-grab-cursor"
 #define OPT_TOUCH_BUTTONS "gui-touchbuttons"
 #define OPT_TOUCH_HALIGN "gui-touch-halign"
 #define OPT_TOUCH_SCALE "gui-touchscale"
+#define OPT_NET_CAPTURE "net-capture"
+#define OPT_NET_REPLAY_RATE "net-replayrate"
 #define OPT_HTTP_ONLY "http-no-https"
 #define OPT_HTTPS_VERIFY "https-verify"
 #define OPT_SKIN_SERVER "http-skinserver"
@@ -286,6 +286,15 @@ cc_result File_Position(cc_file file, cc_uint32* pos);
 /* Attempts to retrieve the length of the given file. */
 cc_result File_Length(cc_file file, cc_uint32* len);
 
+#ifdef CC_BUILD_FILEMAP
+/* Attempts to map the first 'size' bytes of the given file into memory. */
+/* NOTE: The mapped memory is copy-on-write, so changes to it are never written to the file. */
+/* NOTE: The mapped memory stays valid after the file is closed, until File_Unmap is called. */
+cc_result File_Map(cc_file file, cc_uint32 size, void** data);
+/* Unmaps memory previously mapped using File_Map. */
+void File_Unmap(void* data, cc_uint32 size);
+#endif
+
 
 /*########################################################################################################################*
 *---------------------------------------------------------Threading-------------------------------------------------------*
@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <utime.h>
 #include <signal.h>
 #include <stdio.h>
@@ -404,6 +405,15 @@ cc_result File_Length(cc_file file, cc_uint32* len) {
 	*len = st.st_size; return 0;
 }
 
+cc_result File_Map(cc_file file, cc_uint32 size, void** data) {
+	void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	if (ptr == MAP_FAILED) { *data = NULL; return errno; }
+
+	*data = ptr; return 0;
+}
+
+void File_Unmap(void* data, cc_uint32 size) { munmap(data, size); }
+
 
 /*########################################################################################################################*
 *--------------------------------------------------------Threading--------------------------------------------------------*
@@ -408,6 +408,21 @@ cc_result File_Length(cc_file file, cc_uint32* len) {
 	return *len != INVALID_FILE_SIZE ? 0 : GetLastError();
 }
 
+cc_result File_Map(cc_file file, cc_uint32 size, void** data) {
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, size, NULL);
+	cc_result res  = 0;
+	if (!mapping) { *data = NULL; return GetLastError(); }
+
+	*data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+	if (!*data) res = GetLastError();
+
+	/* The mapped view keeps the file mapping alive */
+	CloseHandle(mapping);
+	return res;
+}
+
+void File_Unmap(void* data, cc_uint32 size) { UnmapViewOfFile(data); }
+
 
 /*########################################################################################################################*
 *--------------------------------------------------------Threading--------------------------------------------------------*
@@ -43,8 +43,6 @@ static cc_bool classic_receivedFirstPos;
 /* Map state */
 static cc_bool map_begunLoading;
 static cc_uint64 map_receiveBeg;
-static struct Stream map_part;
-static int map_volume;
 
 /*########################################################################################################################*
 *-----------------------------------------------------CPE extensions------------------------------------------------------*
@@ -346,14 +344,31 @@ static void WoM_Tick(void) {
 *#########################################################################################################################*/
 #define MAP_SIZE_LEN 4
 
+/* Decompression progress of a map stream, as last seen by the main thread */
+struct MapProgress {
+	int index, volume;
+	cc_result res;
+};
+
 struct MapState {
 	struct InflateState inflateState;
-	struct Stream stream;
+	struct Stream stream, part;
 	BlockRaw* blocks;
 	struct GZipHeader gzHeader;
 	cc_uint8 size[MAP_SIZE_LEN];
-	int index, sizeIndex;
+	int index, sizeIndex, volume;
 	cc_bool allocFailed;
+	struct MapProgress ready;
+#ifdef CC_BUILD_ASYNCMAPLOAD
+	/* Compressed data received by the main thread, but not yet given to the worker thread */
+	cc_uint8* queued;  int queuedCount, queuedCapacity;
+	/* Compressed data currently being decompressed by the worker thread */
+	cc_uint8* working; int workingCapacity;
+	void* thread;
+	void* signal;  /* Signalled when data is queued or the worker thread should stop */
+	void* drained; /* Signalled when the worker thread takes the queued data */
+	cc_bool finished;
+#endif
 };
 static struct MapState map1;
 #ifdef EXTENDED_BLOCKS
@@ -370,27 +385,21 @@ static void DisconnectInvalidMap(cc_result res) {
 }
 
 static void MapState_Init(struct MapState* m) {
-	Inflate_MakeStream2(&m->stream, &m->inflateState, &map_part);
+	Inflate_MakeStream2(&m->stream, &m->inflateState, &m->part);
 	GZipHeader_Init(&m->gzHeader);
 
 	m->index       = 0;
 	m->blocks      = NULL;
 	m->sizeIndex   = 0;
+	m->volume      = 0;
 	m->allocFailed = false;
+	Mem_Set(&m->ready, 0, sizeof(m->ready));
 }
 
-static CC_INLINE void MapState_SkipHeader(struct MapState* m) {
+static CC_INLINE void MapState_SkipHeader(struct MapState* m, int volume) {
 	m->gzHeader.done = true;
 	m->sizeIndex     = MAP_SIZE_LEN;
-}
-
-static void FreeMapStates(void) {
-	Mem_Free(map1.blocks);
-	map1.blocks = NULL;
-#ifdef EXTENDED_BLOCKS
-	Mem_Free(map2.blocks);
-	map2.blocks = NULL;
-#endif
+	m->volume        = volume;
 }
 
 static cc_result MapState_Read(struct MapState* m) {
@@ -409,25 +418,201 @@ static cc_result MapState_Read(struct MapState* m) {
 		if (m->sizeIndex < MAP_SIZE_LEN) return 0;
 	}
 
-	if (!map_volume) map_volume = Stream_GetU32_BE(m->size);
+	if (!m->volume) m->volume = Stream_GetU32_BE(m->size);
 
 	if (!m->blocks) {
-		m->blocks = (BlockRaw*)Mem_TryAlloc(map_volume, 1);
+		m->blocks = (BlockRaw*)Mem_TryAlloc(m->volume, 1);
 		/* unlikely but possible */
-		if (!m->blocks) {
-			Window_ShowDialog("Out of memory", "Not enough free memory to join that map.\nTry joining a different map.");
-			m->allocFailed = true;
-			return 0;
-		}
+		if (!m->blocks) { m->allocFailed = true; return 0; }
 	}
 
-	left = map_volume - m->index;
+	left = m->volume - m->index;
 	res  = m->stream.Read(&m->stream, &m->blocks[m->index], left, &read);
 
 	m->index += read;
 	return res;
 }
 
+/* Decompresses all of the compressed data in the map stream's current part */
+static cc_result MapState_Process(struct MapState* m) {
+	cc_result res;
+
+	if (!m->gzHeader.done) {
+		res = GZipHeader_Read(&m->part, &m->gzHeader);
+		if (res && res != ERR_END_OF_STREAM) return res;
+	}
+	return m->gzHeader.done ? MapState_Read(m) : 0;
+}
+
+static void MapState_Publish(struct MapState* m, cc_result res) {
+	m->ready.index  = m->index;
+	m->ready.volume = m->volume;
+	m->ready.res    = res;
+}
+
+#ifdef CC_BUILD_ASYNCMAPLOAD
+/* Max amount of compressed data that can be queued before the main thread waits for the worker thread */
+#define MAP_MAX_QUEUED (256 * 1024)
+/* Protects queued data and published progress of all map streams */
+/* NOTE: Only exists while any map stream has a worker thread */
+static void* map_mutex;
+
+static void MapState_RunWorker(struct MapState* m) {
+	cc_uint8* data;
+	int count, capacity;
+	cc_bool finished;
+	cc_result res = 0;
+
+	for (;;) {
+		Mutex_Lock(map_mutex);
+		{
+			/* Swap buffers, so the main thread can keep queueing data while this is decompressed */
+			data     = m->queued;         count = m->queuedCount;
+			capacity = m->queuedCapacity; finished = m->finished;
+
+			m->queued         = m->working;
+			m->queuedCapacity = m->workingCapacity;
+			m->queuedCount    = 0;
+			m->working         = data;
+			m->workingCapacity = capacity;
+		}
+		Mutex_Unlock(map_mutex);
+		Waitable_Signal(m->drained);
+
+		if (count) {
+			/* Rest of the stream is unusable after an error, so just drop it */
+			if (res) continue;
+			Stream_ReadonlyMemory(&m->part, data, count);
+			res = MapState_Process(m);
+
+			Mutex_Lock(map_mutex);
+			MapState_Publish(m, res);
+			Mutex_Unlock(map_mutex);
+		} else if (finished) {
+			return;
+		} else {
+			Waitable_Wait(m->signal);
+		}
+	}
+}
+
+static void MapState_RunWorker1(void) { MapState_RunWorker(&map1); }
+#ifdef EXTENDED_BLOCKS
+static void MapState_RunWorker2(void) { MapState_RunWorker(&map2); }
+#endif
+
+static void MapState_StartWorker(struct MapState* m) {
+	Thread_StartFunc func = MapState_RunWorker1;
+#ifdef EXTENDED_BLOCKS
+	if (m == &map2) func = MapState_RunWorker2;
+#endif
+	if (!map_mutex) map_mutex = Mutex_Create("Map decompress");
+
+	m->finished = false;
+	m->signal   = Waitable_Create("Map decompress");
+	m->drained  = Waitable_Create("Map decompress drained");
+	Thread_Run(&m->thread, func, 64 * 1024, "Map decompress");
+}
+
+/* Waits for the worker thread to decompress all queued data (or discards it), then stops the worker thread */
+static void MapState_StopWorker(struct MapState* m, cc_bool discard) {
+	if (!m->thread) return;
+
+	Mutex_Lock(map_mutex);
+	{
+		m->finished = true;
+		if (discard) m->queuedCount = 0;
+	}
+	Mutex_Unlock(map_mutex);
+
+	Waitable_Signal(m->signal);
+	Thread_Join(m->thread);
+	Waitable_Free(m->signal);
+	Waitable_Free(m->drained);
+	m->thread  = NULL;
+	m->signal  = NULL;
+	m->drained = NULL;
+
+	Mem_Free(m->queued);
+	Mem_Free(m->working);
+	m->queued  = NULL; m->queuedCount = 0; m->queuedCapacity  = 0;
+	m->working = NULL;                     m->workingCapacity = 0;
+
+	/* Mutex is shared, so can only be freed once no map stream is using it */
+#ifdef EXTENDED_BLOCKS
+	if (map2.thread) return;
+#endif
+	if (map1.thread) return;
+	Mutex_Free(map_mutex);
+	map_mutex = NULL;
+}
+
+/* Queues compressed data to be decompressed by the map stream's worker thread */
+static cc_result MapState_Submit(struct MapState* m, cc_uint8* data, int len) {
+	int capacity;
+	cc_result res;
+	if (!m->thread) MapState_StartWorker(m);
+
+	Mutex_Lock(map_mutex);
+	{
+		/* Wait for the worker thread to catch up when too much data is queued, */
+		/*  which in turn stops more data being received from the server */
+		while (m->queuedCount && m->queuedCount + len > MAP_MAX_QUEUED) {
+			Mutex_Unlock(map_mutex);
+			Waitable_Signal(m->signal);
+			Waitable_Wait(m->drained);
+			Mutex_Lock(map_mutex);
+		}
+
+		if (m->queuedCount + len > m->queuedCapacity) {
+			capacity  = max(m->queuedCapacity * 2, 8192);
+			capacity  = max(capacity, m->queuedCount + len);
+			m->queued = (cc_uint8*)Mem_Realloc(m->queued, capacity, 1, "map data queue");
+			m->queuedCapacity = capacity;
+		}
+
+		Mem_Copy(m->queued + m->queuedCount, data, len);
+		m->queuedCount += len;
+		res = m->ready.res;
+	}
+	Mutex_Unlock(map_mutex);
+
+	Waitable_Signal(m->signal);
+	return res;
+}
+
+static void MapState_GetProgress(struct MapState* m, struct MapProgress* progress) {
+	Mutex_Lock(map_mutex);
+	*progress = m->ready;
+	Mutex_Unlock(map_mutex);
+}
+#else
+static void MapState_StopWorker(struct MapState* m, cc_bool discard) { }
+
+static cc_result MapState_Submit(struct MapState* m, cc_uint8* data, int len) {
+	cc_result res;
+	Stream_ReadonlyMemory(&m->part, data, len);
+
+	res = MapState_Process(m);
+	MapState_Publish(m, res);
+	return res;
+}
+
+static void MapState_GetProgress(struct MapState* m, struct MapProgress* progress) {
+	*progress = m->ready;
+}
+#endif
+
+static void FreeMapStates(void) {
+	MapState_StopWorker(&map1, true);
+	Mem_Free(map1.blocks);
+	map1.blocks = NULL;
+#ifdef EXTENDED_BLOCKS
+	MapState_StopWorker(&map2, true);
+	Mem_Free(map2.blocks);
+	map2.blocks = NULL;
+#endif
+}
 
 /*########################################################################################################################*
 *----------------------------------------------------Classic protocol-----------------------------------------------------*
@@ -536,7 +721,6 @@ static void Classic_StartLoading(void) {
 
 	map_begunLoading = true;
 	map_receiveBeg   = Stopwatch_Measure();
-	map_volume       = 0;
 
 	MapState_Init(&map1);
 #ifdef EXTENDED_BLOCKS
@@ -545,6 +729,7 @@ static void Classic_StartLoading(void) {
 }
 
 static void Classic_LevelInit(cc_uint8* data) {
+	int volume;
 	/* in case server is buggy and sends LevelInit multiple times */
 	if (map_begunLoading) return;
 
@@ -552,14 +737,15 @@ static void Classic_LevelInit(cc_uint8* data) {
 	if (!IsSupported(fastMap_Ext)) return;
 
 	/* Fast map puts volume in header, and uses raw DEFLATE without GZIP header/footer */
-	map_volume = Stream_GetU32_BE(data);
-	MapState_SkipHeader(&map1);
+	volume = Stream_GetU32_BE(data);
+	MapState_SkipHeader(&map1, volume);
 #ifdef EXTENDED_BLOCKS
-	MapState_SkipHeader(&map2);
+	MapState_SkipHeader(&map2, volume);
 #endif
 }
 
 static void Classic_LevelDataChunk(cc_uint8* data) {
+	struct MapProgress ready;
 	struct MapState* m;
 	int usedLength;
 	float progress;
@@ -569,11 +755,6 @@ static void Classic_LevelDataChunk(cc_uint8* data) {
 	if (!map_begunLoading) Classic_StartLoading();
 	usedLength = Stream_GetU16_BE(data);
 
-	map_part.meta.mem.cur    = data + 2;
-	map_part.meta.mem.base   = data + 2;
-	map_part.meta.mem.left   = usedLength;
-	map_part.meta.mem.length = usedLength;
-
 #ifndef EXTENDED_BLOCKS
 	m = &map1;
 #else
@@ -585,33 +766,45 @@ static void Classic_LevelDataChunk(cc_uint8* data) {
 	}
 #endif
 
-	if (!m->gzHeader.done) {
-		res = GZipHeader_Read(&map_part, &m->gzHeader);
-		if (res && res != ERR_END_OF_STREAM) { DisconnectInvalidMap(res); return; }
-	}
+	/* With CC_BUILD_ASYNCMAPLOAD, this only queues the data to be decompressed on a worker thread */
+	res = MapState_Submit(m, data + 2, usedLength);
+	if (res) { DisconnectInvalidMap(res); return; }
 
-	if (m->gzHeader.done) {
-		res = MapState_Read(m);
-		if (res) { DisconnectInvalidMap(res); return; }
-	}
+	MapState_GetProgress(&map1, &ready);
 
-	progress = !map_volume ? 0.0f : (float)map1.index / map_volume;
+	progress = !ready.volume ? 0.0f : (float)ready.index / ready.volume;
 	Event_RaiseFloat(&WorldEvents.Loading, progress);
 }
 
 static void Classic_LevelFinalise(cc_uint8* data) {
 	int width, height, length, volume;
 	cc_uint64 end;
+	cc_result res;
 	int delta;
 
+	/* Wait for all received map data to be decompressed */
+	MapState_StopWorker(&map1, false);
+#ifdef EXTENDED_BLOCKS
+	MapState_StopWorker(&map2, false);
+#endif
+
 	end   = Stopwatch_Measure();
 	delta = Stopwatch_ElapsedMS(map_receiveBeg, end);
 	Platform_Log1("map loading took: %i", &delta);
 	map_begunLoading = false;
 	WoM_CheckSendWomID();
 
+	res = map1.ready.res;
 #ifdef EXTENDED_BLOCKS
-	if (map2.allocFailed) FreeMapStates();
+	if (!res) res = map2.ready.res;
+#endif
+	if (res) { DisconnectInvalidMap(res); return; }
+
+#ifdef EXTENDED_BLOCKS
+	if (map2.allocFailed) {
+		Window_ShowDialog("Out of memory", "Not enough free memory to join that map.\nTry joining a different map.");
+		FreeMapStates();
+	}
 #endif
 
 	width  = Stream_GetU16_BE(data + 0);
@@ -620,14 +813,15 @@ static void Classic_LevelFinalise(cc_uint8* data) {
 	volume = width * height * length;
 
 	if (map1.allocFailed) {
+		Window_ShowDialog("Out of memory", "Not enough free memory to join that map.\nTry joining a different map.");
 		Chat_AddRaw("&cFailed to load map, try joining a different map");
 		Chat_AddRaw("   &cNot enough free memory to load the map");
 	} else if (!map1.blocks) {
 		Chat_AddRaw("&cFailed to load map, try joining a different map");
 		Chat_AddRaw("   &cAttempted to load map without a Blocks array");
-	} else if (map_volume != volume) {
+	} else if (map1.volume != volume) {
 		Chat_AddRaw("&cFailed to load map, try joining a different map");
-		Chat_Add2(  "   &cBlocks array size (%i) does not match volume of map (%i)", &map_volume, &volume);
+		Chat_Add2(  "   &cBlocks array size (%i) does not match volume of map (%i)", &map1.volume, &volume);
 		FreeMapStates();
 	} else if (!World_CheckVolume(width, height, length)) {
 		Chat_AddRaw("&cFailed to load map, try joining a different map");
@@ -800,7 +994,6 @@ static void Classic_ReadAbsoluteLocation(cc_uint8* data, EntityID id, cc_uint8 f
 
 #define Classic_HandshakeSize() (Game_Version.Protocol > PROTOCOL_0019 ? 131 : 130)
 static void Classic_Reset(void) {
-	Stream_ReadonlyMemory(&map_part, NULL, 0);
 	map_begunLoading = false;
 	classic_receivedFirstPos = false;
 
@@ -823,9 +1016,13 @@ static void Classic_Reset(void) {
 	Net_Set(OPCODE_SET_PERMISSION, Classic_SetPermission, 2);
 }
 
+/* Position updates are superseded by later ones, so don't add to the backlog of unsent data */
+#define POSITION_MAX_BACKLOG 1024
+
 static cc_uint8* Classic_Tick(cc_uint8* data) {
 	struct Entity* e = &Entities.CurPlayer->Base;
 	if (!classic_receivedFirstPos) return data;
+	if (Server_PendingSendBytes() >= POSITION_MAX_BACKLOG) return data;
 
 	/* Report end position of each physics tick, rather than current position */
 	/*  (otherwise can miss landing on a block then jumping off of it again) */
@@ -25,6 +25,7 @@
 #include "Input.h"
 #include "Errors.h"
 #include "Options.h"
+#include "Stream.h"
 
 static char nameBuffer[STRING_SIZE];
 static char motdBuffer[STRING_SIZE];
@@ -244,6 +245,20 @@ static cc_bool net_connecting;
 static float net_connectElapsed;
 #define NET_TIMEOUT_SECS 15
 
+/* File that all data received from the server is written to, if capturing is enabled */
+static struct Stream net_capture;
+static cc_bool net_capturing;
+struct _NetStats NetStats;
+
+/* Outgoing data is queued in this ring buffer, then written to the socket without blocking */
+/*  in MPConnection_Tick. This also combines small packets (e.g. position updates) into one write */
+#define NET_SEND_BUFFER_SIZE (4096 * 4)
+#define NET_SEND_BUFFER_MASK (NET_SEND_BUFFER_SIZE - 1)
+static cc_uint8  net_sendBuffer[NET_SEND_BUFFER_SIZE];
+static cc_uint32 net_sendHead, net_sendCount;
+
+static void MPConnection_FlushSend(void);
+
 static void MPConnection_FinishConnect(void) {
 	net_connecting = false;
 	Event_RaiseVoid(&NetEvents.Connected);
@@ -252,6 +267,7 @@ static void MPConnection_FinishConnect(void) {
 	net_readCurrent = net_readBuffer;
 	net_lastPacket  = Game.Time;
 	Classic_SendLogin();
+	MPConnection_FlushSend();
 }
 
 static void MPConnection_Fail(const cc_string* reason) {
@@ -293,6 +309,34 @@ static void MPConnection_TickConnect(struct ScheduledTask* task) {
 	}
 }
 
+/* Begins writing all data received from the server to a file, for later replaying */
+static void MPConnection_BeginCapture(void) {
+	cc_string path; char pathBuffer[FILENAME_SIZE];
+	cc_result res;
+	String_InitArray(path, pathBuffer);
+
+	Options_Get(OPT_NET_CAPTURE, &path, "");
+	if (!path.length) return;
+
+	res = Stream_CreateFile(&net_capture, &path);
+	if (res) { Logger_SysWarn2(res, "creating", &path); return; }
+	net_capturing = true;
+}
+
+static void MPConnection_EndCapture(void) {
+	if (!net_capturing) return;
+	net_capture.Close(&net_capture);
+	net_capturing = false;
+}
+
+static void MPConnection_Capture(cc_uint32 read) {
+	cc_result res = Stream_Write(&net_capture, net_readCurrent, read);
+	if (!res) return;
+
+	Logger_SysWarn(res, "writing network capture");
+	MPConnection_EndCapture();
+}
+
 static void MPConnection_BeginConnect(void) {
 	static const cc_string invalid_reason = String_FromConst("Invalid IP address");
 	cc_string title; char titleBuffer[STRING_SIZE];
@@ -326,9 +370,12 @@ static void MPConnection_BeginConnect(void) {
 		Server.Disconnected = false;
 		net_connecting      = true;
 		net_connectElapsed  = 0;
+		net_sendHead        = 0;
+		net_sendCount       = 0;
 
 		String_Format2(&title, "Connecting to %s:%i..", &Server.Address, &Server.Port);
 		LoadingScreen_Show(&title, &String_Empty);
+		MPConnection_BeginCapture();
 	}
 }
 
@@ -377,12 +424,78 @@ static void DisconnectInvalidOpcode(cc_uint8 opcode) {
 	Game_Disconnect(&title, &tmp); return;
 }
 
-static void MPConnection_Tick(struct ScheduledTask* task) {
+/* Handles all of the complete packets in the read buffer, after 'read' more bytes were read into it */
+/* Returns false if a packet with an invalid opcode was received */
+static cc_bool MPConnection_HandleData(cc_uint32 read) {
 	Net_Handler handler;
 	cc_uint8* readEnd;
 	cc_uint8* readCur;
-	cc_uint32 read;
+	cc_uint64 beg;
 	int i, remaining;
+
+	readCur        = net_readBuffer;
+	readEnd        = net_readCurrent + read;
+	net_lastPacket = Game.Time;
+	NetStats.Bytes += read;
+
+	while (readCur < readEnd) {
+		cc_uint8 opcode = readCur[0];
+
+		/* Workaround for older D3 servers which wrote one byte too many for HackControl packets */
+		if (cpe_needD3Fix && lastOpcode == OPCODE_HACK_CONTROL && (opcode == 0x00 || opcode == 0xFF)) {
+			Platform_LogConst("Skipping invalid HackControl byte from D3 server");
+			readCur++;
+			LocalPlayer_ResetJumpVelocity(Entities.CurPlayer);
+			continue;
+		}
+
+		if (readCur + Protocol.Sizes[opcode] > readEnd) break;
+		handler = Protocol.Handlers[opcode];
+		if (!handler) { DisconnectInvalidOpcode(opcode); return false; }
+
+		lastOpcode = opcode;
+		NetStats.Packets++;
+		NetStats.Counts[opcode]++;
+
+		if (NetStats.MeasureHandlers) {
+			beg = Stopwatch_Measure();
+			handler(readCur + 1); /* skip opcode */
+			NetStats.Times[opcode] += Stopwatch_Measure() - beg;
+		} else {
+			handler(readCur + 1); /* skip opcode */
+		}
+		readCur += Protocol.Sizes[opcode];
+	}
+
+	/* Protocol packets might be split up across TCP packets */
+	/* If so, copy last few unprocessed bytes back to beginning of buffer */
+	/* These bytes are then later combined with subsequently read TCP packet data */
+	remaining = (int)(readEnd - readCur);
+	for (i = 0; i < remaining; i++) 
+	{
+		net_readBuffer[i] = readCur[i];
+	}
+	net_readCurrent = net_readBuffer + remaining;
+	return true;
+}
+
+/* Sends any packets that are regularly sent to the server, and any queued data */
+static void MPConnection_TickSend(void) {
+	if (net_writeFailure) {
+		Platform_Log1("Error from send: %e", &net_writeFailure);
+		MPConnection_Disconnect(); return;
+	}
+
+	/* Network is ticked 60 times a second. We only send position updates 20 times a second */
+	if ((ticks++ % 3) == 0) {
+		TexturePack_CheckPending();
+		Protocol_Tick();
+	}
+	MPConnection_FlushSend();
+}
+
+static void MPConnection_Tick(struct ScheduledTask* task) {
+	cc_uint32 read;
 	cc_result res;
 
 	if (Server.Disconnected) return;
@@ -403,77 +516,72 @@ static void MPConnection_Tick(struct ScheduledTask* task) {
 		/* TODO: Should this be checked unconditonally instead of just when read = 0 ? */
 		if (net_lastPacket + 30 < Game.Time) { MPConnection_Disconnect(); return; }
 	} else {
-		readCur        = net_readBuffer;
-		readEnd        = net_readCurrent + read;
-		net_lastPacket = Game.Time;
-
-		while (readCur < readEnd) {
-			cc_uint8 opcode = readCur[0];
-
-			/* Workaround for older D3 servers which wrote one byte too many for HackControl packets */
-			if (cpe_needD3Fix && lastOpcode == OPCODE_HACK_CONTROL && (opcode == 0x00 || opcode == 0xFF)) {
-				Platform_LogConst("Skipping invalid HackControl byte from D3 server");
-				readCur++;
-				LocalPlayer_ResetJumpVelocity(Entities.CurPlayer);
-				continue;
-			}
-
-			if (readCur + Protocol.Sizes[opcode] > readEnd) break;
-			handler = Protocol.Handlers[opcode];
-			if (!handler) { DisconnectInvalidOpcode(opcode); return; }
-
-			lastOpcode = opcode;
-			handler(readCur + 1); /* skip opcode */
-			readCur += Protocol.Sizes[opcode];
-		}
-
-		/* Protocol packets might be split up across TCP packets */
-		/* If so, copy last few unprocessed bytes back to beginning of buffer */
-		/* These bytes are then later combined with subsequently read TCP packet data */
-		remaining = (int)(readEnd - readCur);
-		for (i = 0; i < remaining; i++) 
-		{
-			net_readBuffer[i] = readCur[i];
-		}
-		net_readCurrent = net_readBuffer + remaining;
+		if (net_capturing) MPConnection_Capture(read);
+		if (!MPConnection_HandleData(read)) return;
 	}
+	MPConnection_TickSend();
+}
 
-	if (net_writeFailure) {
-		Platform_Log1("Error from send: %e", &net_writeFailure);
-		MPConnection_Disconnect(); return;
+/* Writes as much queued data to the socket as possible without blocking */
+static void MPConnection_FlushSend(void) {
+	cc_uint32 len, wrote;
+	cc_result res;
+	if (net_writeFailure) return;
+
+	while (net_sendCount) {
+		/* Queued data may wrap around to the start of the buffer */
+		len = min(net_sendCount, NET_SEND_BUFFER_SIZE - net_sendHead);
+		res = Socket_Write(net_socket, &net_sendBuffer[net_sendHead], len, &wrote);
+
+		/* Socket's send buffer is full, so try again next tick */
+		if (res == ReturnCode_SocketInProgess || res == ReturnCode_SocketWouldBlock) return;
+
+		/* NOTE: Not immediately disconnecting here, as otherwise we sometimes miss out on kick messages */
+		if (res)    { net_writeFailure = res;                  return; }
+		if (!wrote) { net_writeFailure = ERR_INVALID_ARGUMENT; return; }
+
+		net_sendHead   = (net_sendHead + wrote) & NET_SEND_BUFFER_MASK;
+		net_sendCount -= wrote;
 	}
+}
 
-	/* Network is ticked 60 times a second. We only send position updates 20 times a second */
-	if ((ticks++ % 3) != 0) return;
+/* The send buffer only fills up when the server does not read data for a long time */
+/*  (or when lots of data is sent at once), so just wait for a bit, up to 10 seconds */
+static cc_bool MPConnection_WaitForSpace(void) {
+	int tries;
+	for (tries = 0; tries < 1000; tries++)
+	{
+		MPConnection_FlushSend();
+		if (net_writeFailure) return false;
 
-	TexturePack_CheckPending();
-	Protocol_Tick();
+		if (net_sendCount < NET_SEND_BUFFER_SIZE) return true;
+		Thread_Sleep(10);
+	}
+
+	net_writeFailure = ReturnCode_SocketWouldBlock;
+	return false;
 }
 
 static void MPConnection_SendData(const cc_uint8* data, cc_uint32 len) {
-	cc_uint32 wrote;
-	cc_result res;
-	int tries = 0;
-	if (Server.Disconnected) return;
+	cc_uint32 tail, count;
+	if (Server.Disconnected || net_writeFailure) return;
 
 	while (len) {
-		res = Socket_Write(net_socket, data, len, &wrote);
-		/* If sending would block (send buffer full), retry for a bit up to 10 seconds */
-		/* TODO: Avoid doing this and manually buffer data when this happens */
-		if (res && tries < 1000 && (res == ReturnCode_SocketInProgess || res == ReturnCode_SocketWouldBlock)) {
-			Thread_Sleep(10);
-			tries++;
-			continue;
-		}
+		if (net_sendCount == NET_SEND_BUFFER_SIZE && !MPConnection_WaitForSpace()) return;
 
-		/* NOTE: Not immediately disconnecting here, as otherwise we sometimes miss out on kick messages */
-		if (res)    { net_writeFailure = res;                  return; }
-		if (!wrote) { net_writeFailure = ERR_INVALID_ARGUMENT; return; }
+		tail  = (net_sendHead + net_sendCount) & NET_SEND_BUFFER_MASK;
+		count = min(len,   NET_SEND_BUFFER_SIZE - tail);
+		count = min(count, NET_SEND_BUFFER_SIZE - net_sendCount);
 
-		data += wrote; len -= wrote;
+		Mem_Copy(&net_sendBuffer[tail], data, count);
+		net_sendCount += count;
+		data += count; len -= count;
 	}
 }
 
+cc_uint32 Server_PendingSendBytes(void) { return net_sendCount; }
+
+
 static void MPConnection_Init(void) {
 	Server_ResetState();
 	Server.IsSinglePlayer = false;
@@ -485,8 +593,101 @@ static void MPConnection_Init(void) {
 	Server.SendData     = MPConnection_SendData;
 	net_readCurrent     = net_readBuffer;
 }
+
+
+/*########################################################################################################################*
+*----------------------------------------------------Replay connection----------------------------------------------------*
+*#########################################################################################################################*/
+static char replayBuffer[FILENAME_SIZE];
+cc_string MP_ReplayPath = String_FromArray(replayBuffer);
+
+static struct Stream replay_stream;
+static cc_bool replay_opened;
+/* Bytes of captured data that can still be replayed before the rate limit is reached */
+static float replay_allowance;
+/* Bytes of captured data replayed per second, or 0 for no limit */
+static int replay_rate;
+/* Max time spent replaying captured data each tick when there is no rate limit */
+#define REPLAY_TICK_MAX_MS 50
+
+static void ReplayConnection_BeginConnect(void) {
+	static const cc_string title = String_FromConst("Failed to replay network capture");
+	cc_string reason; char reasonBuffer[STRING_SIZE * 2];
+	cc_result res;
+
+	replay_rate = Options_GetInt(OPT_NET_REPLAY_RATE, 0, 1024 * 1024, 0) * 1024;
+	replay_allowance = 0;
+
+	res = Stream_OpenFile(&replay_stream, &MP_ReplayPath);
+	if (res) {
+		String_InitArray(reason, reasonBuffer);
+		String_Format2(&reason, "Error opening %s: %e", &MP_ReplayPath, &res);
+		Game_Disconnect(&title, &reason); return;
+	}
+
+	replay_opened       = true;
+	Server.Disconnected = false;
+	MPConnection_FinishConnect();
+}
+
+static void ReplayConnection_End(void) {
+	if (replay_opened) replay_stream.Close(&replay_stream);
+	replay_opened        = false;
+	NetStats.ReplayEnded = true;
+}
+
+static void ReplayConnection_Tick(struct ScheduledTask* task) {
+	cc_uint64 beg = Stopwatch_Measure();
+	cc_uint32 count, read;
+	cc_result res;
+	if (Server.Disconnected || !replay_opened) return;
+
+	if (replay_rate) {
+		replay_allowance += replay_rate * (float)task->interval;
+		replay_allowance  = min(replay_allowance, replay_rate);
+	}
+
+	do {
+		count = 4096 * 4;
+		if (replay_rate) count = min(count, (cc_uint32)replay_allowance);
+		if (!count) break;
+
+		res = replay_stream.Read(&replay_stream, net_readCurrent, count, &read);
+		if (res) Logger_SysWarn(res, "reading network capture");
+		if (res || !read) { ReplayConnection_End(); break; }
+
+		if (replay_rate) replay_allowance -= read;
+		if (!MPConnection_HandleData(read)) return;
+	} while (!replay_rate && Stopwatch_ElapsedMS(beg, Stopwatch_Measure()) < REPLAY_TICK_MAX_MS);
+
+	MPConnection_TickSend();
+}
+
+/* Data sent to the server is just discarded, as nothing is listening */
+static void ReplayConnection_SendData(const cc_uint8* data, cc_uint32 len) { }
+
+static void ReplayConnection_Init(void) {
+	MPConnection_Init();
+	Server.BeginConnect = ReplayConnection_BeginConnect;
+	Server.Tick         = ReplayConnection_Tick;
+	Server.SendData     = ReplayConnection_SendData;
+
+	String_Copy(&Server.Address, &MP_ReplayPath);
+}
+
+static void CloseStreams(void) {
+	MPConnection_EndCapture();
+	if (replay_opened) replay_stream.Close(&replay_stream);
+	replay_opened = false;
+}
 #else
 static void MPConnection_Init(void) { SPConnection_Init(); }
+static void ReplayConnection_Init(void) { SPConnection_Init(); }
+static void CloseStreams(void) { }
+
+cc_uint32 Server_PendingSendBytes(void) { return 0; }
+cc_string MP_ReplayPath;
+struct _NetStats NetStats;
 #endif
 
 
@@ -509,7 +710,9 @@ static void OnInit(void) {
 	String_InitArray(Server.MOTD,    motdBuffer);
 	String_InitArray(Server.AppName, appBuffer);
 
-	if (!Server.Address.length) {
+	if (MP_ReplayPath.length) {
+		ReplayConnection_Init();
+	} else if (!Server.Address.length) {
 		SPConnection_Init();
 	} else {
 		MPConnection_Init();
@@ -542,6 +745,7 @@ static void OnClose(void) {
 		Physics_Free();
 	} else {
 		Ping_Reset();
+		CloseStreams();
 		if (Server.Disconnected) return;
 
 		Socket_Close(net_socket);
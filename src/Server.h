@@ -74,8 +74,29 @@ CC_VAR extern struct _ServerConnectionData {
 /* Otherwise just calls TexturePack_Extract */
 void Server_RetrieveTexturePack(const cc_string* url);
 
+/* Returns the number of bytes queued to be sent to the server, that have not been sent yet */
+/* NOTE: Always 0 when in singleplayer */
+cc_uint32 Server_PendingSendBytes(void);
+
 /* Path of map to automatically load in singleplayer */
 extern cc_string SP_AutoloadMap;
+/* Path of captured network data to replay, instead of connecting to a multiplayer server */
+/* NOTE: Data is captured by setting the net-capture option to a file path */
+extern cc_string MP_ReplayPath;
+
+/* Statistics about the data received from multiplayer servers */
+extern struct _NetStats {
+	/* Total number of bytes and packets received */
+	cc_uint64 Bytes, Packets;
+	/* Number of packets received with each opcode */
+	cc_uint32 Counts[256];
+	/* Total time spent in the handler of each opcode, in Stopwatch_Measure units */
+	/* NOTE: Only measured when MeasureHandlers is true */
+	cc_uint64 Times[256];
+	cc_bool MeasureHandlers;
+	/* Whether all of the captured network data has been replayed */
+	cc_bool ReplayEnded;
+} NetStats;
 
 CC_END_HEADER
 #endif
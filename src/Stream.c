@@ -171,6 +171,14 @@ void Stream_FromFile(struct Stream* s, cc_file file) {
 	s->Length   = Stream_FileLength;
 }
 
+cc_result Stream_MapFile(struct Stream* s, cc_uint32 size, void** data) {
+	*data = NULL;
+#ifdef CC_BUILD_FILEMAP
+	if (s->Read == Stream_FileRead) return File_Map(s->meta.file, size, data);
+#endif
+	return ERR_NOT_SUPPORTED;
+}
+
 
 /*########################################################################################################################*
 *-----------------------------------------------------PortionStream-------------------------------------------------------*
@@ -61,6 +61,9 @@ cc_result Stream_AppendFile(struct Stream* s, const cc_string* path);
 cc_result Stream_WriteAllTo(const cc_string* path, const cc_uint8* data, cc_uint32 length);
 /* Wraps a file, allowing reading from/writing to/seeking in the file. */
 CC_API void Stream_FromFile(struct Stream* s, cc_file file);
+/* Attempts to memory map the first 'size' bytes of the file wrapped by the given stream. (see File_Map) */
+/* Returns ERR_NOT_SUPPORTED if the stream does not wrap a file, or files cannot be memory mapped */
+cc_result Stream_MapFile(struct Stream* s, cc_uint32 size, void** data);
 
 /* Wraps another Stream, only allows reading up to 'len' bytes from the wrapped stream. */
 CC_API void Stream_ReadonlyPortion(struct Stream* s, struct Stream* source, cc_uint32 len);
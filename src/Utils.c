@@ -5,6 +5,7 @@
 #include "Stream.h"
 #include "Errors.h"
 #include "Logger.h"
+#include "Funcs.h"
 
 
 /*########################################################################################################################*
@@ -366,3 +367,92 @@ int EntryList_Find(struct StringsBuffer* list, const cc_string* key, char separa
 	return -1;
 }
 
+
+/*########################################################################################################################*
+*-------------------------------------------------------Worker pool-------------------------------------------------------*
+*#########################################################################################################################*/
+static void WorkerPool_RunJobs(struct WorkerPool* pool, int thread) {
+	int i;
+	for (;;) {
+		Mutex_Lock(pool->mutex);
+		i = pool->nextJob++;
+		Mutex_Unlock(pool->mutex);
+
+		if (i >= pool->jobsCount) return;
+		pool->func(i, thread);
+	}
+}
+
+void WorkerPool_WorkerMain(struct WorkerPool* pool) {
+	int id;
+	Mutex_Lock(pool->mutex);
+	id = pool->started++;
+	Mutex_Unlock(pool->mutex);
+
+	for (;;) {
+		Waitable_Wait(pool->signals[id]);
+		if (pool->quit) return;
+		WorkerPool_RunJobs(pool, id);
+
+		Mutex_Lock(pool->mutex);
+		if (--pool->pending == 0) Waitable_Signal(pool->done);
+		Mutex_Unlock(pool->mutex);
+	}
+}
+
+static void WorkerPool_Start(struct WorkerPool* pool) {
+	int i, count = min(pool->threads, WORKERPOOL_MAX_THREADS);
+	pool->mutex = Mutex_Create(pool->name);
+	pool->done  = Waitable_Create(pool->name);
+
+	for (i = 0; i < count; i++)
+	{
+		pool->signals[i] = Waitable_Create(pool->name);
+	}
+	for (i = 0; i < count; i++)
+	{
+		Thread_Run(&pool->workers[i], pool->workerMain, pool->stackSize, pool->name);
+	}
+	pool->count = count;
+}
+
+void WorkerPool_Run(struct WorkerPool* pool, WorkerPool_Func func, int count) {
+	int i;
+	if (!pool->threads || count <= 1) {
+		for (i = 0; i < count; i++) func(i, pool->count);
+		return;
+	}
+	if (!pool->count) WorkerPool_Start(pool);
+
+	pool->func      = func;
+	pool->jobsCount = count;
+	pool->nextJob   = 0;
+	pool->pending   = pool->count;
+	for (i = 0; i < pool->count; i++)
+	{
+		Waitable_Signal(pool->signals[i]);
+	}
+
+	/* Calling thread also runs jobs, rather than just waiting for the workers */
+	WorkerPool_RunJobs(pool, pool->count);
+	Waitable_Wait(pool->done);
+}
+
+void WorkerPool_Stop(struct WorkerPool* pool) {
+	int i;
+	if (!pool->count) return;
+	pool->quit = true;
+
+	for (i = 0; i < pool->count; i++)
+	{
+		Waitable_Signal(pool->signals[i]);
+		Thread_Join(pool->workers[i]);
+		Waitable_Free(pool->signals[i]);
+	}
+
+	Waitable_Free(pool->done);
+	Mutex_Free(pool->mutex);
+	pool->count   = 0;
+	pool->started = 0;
+	pool->quit    = false;
+}
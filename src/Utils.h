@@ -77,5 +77,39 @@ CC_NOINLINE STRING_REF cc_string EntryList_UNSAFE_Get(struct StringsBuffer* list
 /* Finds the index of the entry whose key caselessly equals the given key. */
 CC_NOINLINE int EntryList_Find(struct StringsBuffer* list, const cc_string* key, char separator);
 
+#define WORKERPOOL_MAX_THREADS 16
+typedef void (*WorkerPool_Func)(int index, int thread);
+/* Pool of worker threads that jobs are spread across */
+/* NOTE: Worker threads are only started on the first call to WorkerPool_Run */
+struct WorkerPool {
+	/* Entry point of the worker threads, which must just call WorkerPool_WorkerMain with this pool */
+	/* (thread entry points are not given any arguments, so cannot be shared between pools) */
+	void (*workerMain)(void);
+	const char* name;
+	int stackSize;
+	int threads; /* Number of worker threads to start (0 runs all jobs on the calling thread) */
+
+	void* workers[WORKERPOOL_MAX_THREADS];
+	void* signals[WORKERPOOL_MAX_THREADS];
+	void* done;
+	void* mutex;
+	int count, started, pending; /* count is number of worker threads currently running */
+	volatile cc_bool quit;
+
+	WorkerPool_Func func;
+	int jobsCount, nextJob;
+};
+
+/* Calls func for every index from 0 to count - 1, spread across the worker threads and calling thread. */
+/* thread is which thread func is being called on. (from 0 to number of worker threads inclusive, */
+/*  where the calling thread is always the last) */
+/* NOTE: Only one thread can call this for a given pool at a time */
+void WorkerPool_Run(struct WorkerPool* pool, WorkerPool_Func func, int count);
+/* Runs jobs given to the pool until the pool is stopped. */
+void WorkerPool_WorkerMain(struct WorkerPool* pool);
+/* Stops and waits for all the worker threads of the pool */
+/* NOTE: Changes to threads only take effect after this */
+void WorkerPool_Stop(struct WorkerPool* pool);
+
 CC_END_HEADER
 #endif
@@ -10,6 +10,7 @@
 #include "Game.h"
 #include "TexturePack.h"
 #include "Window.h"
+#include "Funcs.h"
 
 struct _WorldData World;
 static char nameBuffer[STRING_SIZE];
@@ -37,14 +38,37 @@ static void GenerateNewUuid(void) {
 	World.Uuid[8] |= 0x80; /* variant 2*/
 }
 
-void World_Reset(void) {
+#ifdef CC_BUILD_FILEMAP
+/* Memory mapped file that World.Blocks (and possibly World.Blocks2) point into */
+static cc_uint8* mappedData;
+static cc_uint32 mappedSize;
+#define IsMapped(blocks) (mappedData && (cc_uint8*)(blocks) >= mappedData && (cc_uint8*)(blocks) < mappedData + mappedSize)
+#else
+#define IsMapped(blocks) false
+#endif
+
+static void FreeBlocks(void) {
 #ifdef EXTENDED_BLOCKS
-	if (World.Blocks != World.Blocks2) Mem_Free(World.Blocks2);
+	if (World.Blocks != World.Blocks2 && !IsMapped(World.Blocks2)) Mem_Free(World.Blocks2);
 	World.Blocks2 = NULL;
-	World.IDMask  = 0xFF;
 #endif
-	Mem_Free(World.Blocks);
+	if (!IsMapped(World.Blocks)) Mem_Free(World.Blocks);
 	World.Blocks = NULL;
+
+#ifdef CC_BUILD_FILEMAP
+	if (mappedData) File_Unmap(mappedData, mappedSize);
+	mappedData = NULL;
+	mappedSize = 0;
+#endif
+}
+
+void World_Reset(void) {
+	FreeBlocks();
+#ifdef EXTENDED_BLOCKS
+	World.IDMask = 0xFF;
+#endif
+	Mem_Free(World.Summaries);
+	World.Summaries = NULL;
 	String_InitArray(World.Name, nameBuffer);
 
 	World_SetDimensions(0, 0, 0);
@@ -54,6 +78,7 @@ void World_Reset(void) {
 	Env_Reset();
 }
 
+static void CalcAllSummaries(void);
 void World_NewMap(void) {
 	World_Reset();
 	Event_RaiseVoid(&WorldEvents.NewMap);
@@ -76,6 +101,11 @@ void World_SetNewMap(BlockRaw* blocks, int width, int height, int length) {
 	}
 #endif
 
+	if (World.Blocks) {
+		World.Summaries = (struct ChunkSummary*)Mem_TryAlloc(World.ChunksCount, sizeof(struct ChunkSummary));
+		if (World.Summaries) { CalcAllSummaries(); } else { World_OutOfMemory(); }
+	}
+
 	if (Env.EdgeHeight == -1)   { Env.EdgeHeight   = height / 2; }
 	if (Env.CloudsHeight == -1) { Env.CloudsHeight = height + 2; }
 
@@ -112,6 +142,115 @@ void World_OutOfMemory(void) {
 	World_Reset();
 }
 
+#ifdef CC_BUILD_FILEMAP
+void World_SetMapped(void* data, cc_uint32 size) {
+	mappedData = (cc_uint8*)data;
+	mappedSize = size;
+}
+
+static BlockRaw* CopyMapped(BlockRaw* blocks) {
+	BlockRaw* copy = (BlockRaw*)Mem_TryAlloc(World.Volume, 1);
+	if (copy) Mem_Copy(copy, blocks, World.Volume);
+	return copy;
+}
+
+cc_bool World_CopyMapped(void) {
+	BlockRaw* blocks;
+#ifdef EXTENDED_BLOCKS
+	BlockRaw* blocks2;
+#endif
+	if (!mappedData) return true;
+
+	blocks = CopyMapped(World.Blocks);
+	if (!blocks) return false;
+
+#ifdef EXTENDED_BLOCKS
+	if (World.Blocks2 == World.Blocks) {
+		World.Blocks2 = blocks;
+	} else if (IsMapped(World.Blocks2)) {
+		blocks2 = CopyMapped(World.Blocks2);
+		if (!blocks2) { Mem_Free(blocks); return false; }
+		World.Blocks2 = blocks2;
+	}
+#endif
+	World.Blocks = blocks;
+
+	File_Unmap(mappedData, mappedSize);
+	mappedData = NULL;
+	mappedSize = 0;
+	return true;
+}
+#endif
+
+
+
+/*########################################################################################################################*
+*-----------------------------------------------------Chunk summaries-----------------------------------------------------*
+*#########################################################################################################################*/
+/* Whether block definitions have changed since the summaries were last calculated */
+static cc_bool summariesDirty;
+
+static void Summary_Count(struct ChunkSummary* s, BlockID block, int delta) {
+	if (block != BLOCK_AIR)                    s->NonAir   += delta;
+	if (Blocks.Brightness[block])              s->Emitters += delta;
+}
+
+static void CalcSummary(struct ChunkSummary* s, int x1, int y1, int z1) {
+	int x2 = min(x1 + CHUNK_SIZE, World.Width);
+	int y2 = min(y1 + CHUNK_SIZE, World.Height);
+	int z2 = min(z1 + CHUNK_SIZE, World.Length);
+	int x, y, z, index;
+	BlockID block;
+
+	s->NonAir  = 0; s->Emitters = 0;
+	s->Uniform = true;
+	s->Block   = World_GetBlock(x1, y1, z1);
+
+	for (y = y1; y < y2; y++) {
+		for (z = z1; z < z2; z++) {
+			index = World_Pack(x1, y, z);
+
+			for (x = x1; x < x2; x++, index++) {
+				block = (BlockID)World_GetRawBlock(index);
+				if (block != s->Block) s->Uniform = false;
+				Summary_Count(s, block, 1);
+			}
+		}
+	}
+}
+
+static void CalcAllSummaries(void) {
+	int cx, cy, cz;
+	for (cy = 0; cy < World.ChunksY; cy++) {
+		for (cz = 0; cz < World.ChunksZ; cz++) {
+			for (cx = 0; cx < World.ChunksX; cx++) {
+				CalcSummary(&World.Summaries[World_ChunkPack(cx, cy, cz)],
+							cx << CHUNK_SHIFT, cy << CHUNK_SHIFT, cz << CHUNK_SHIFT);
+			}
+		}
+	}
+	summariesDirty = false;
+}
+
+static void UpdateSummary(int x, int y, int z, BlockID old, BlockID now) {
+	struct ChunkSummary* s;
+	if (old == now || !World.Summaries) return;
+	s = &World.Summaries[World_ChunkPack(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT)];
+
+	Summary_Count(s, old, -1);
+	Summary_Count(s, now,  1);
+
+	if (now != s->Block) s->Uniform = false;
+	if (!s->NonAir) { s->Uniform = true; s->Block = BLOCK_AIR; }
+}
+
+cc_bool World_ChunkHasEmitters(int cx, int cy, int cz) {
+	if (summariesDirty) CalcAllSummaries();
+	return World.Summaries[World_ChunkPack(cx, cy, cz)].Emitters != 0;
+}
+
+static void OnBlockDefChanged(void* obj) { summariesDirty = true; }
+
 
 #ifdef EXTENDED_BLOCKS
 static CC_NOINLINE void LazyInitUpper(int i, BlockID block) {
@@ -124,6 +263,7 @@ static CC_NOINLINE void LazyInitUpper(int i, BlockID block) {
 
 void World_SetBlock(int x, int y, int z, BlockID block) {
 	int i = World_Pack(x, y, z);
+	UpdateSummary(x, y, z, (BlockID)World_GetRawBlock(i), block);
 	World.Blocks[i] = (BlockRaw)block;
 
 	/* defer allocation of second map array if possible */
@@ -136,7 +276,9 @@ void World_SetBlock(int x, int y, int z, BlockID block) {
 }
 #else
 void World_SetBlock(int x, int y, int z, BlockID block) {
-	World.Blocks[World_Pack(x, y, z)] = block; 
+	int i = World_Pack(x, y, z);
+	UpdateSummary(x, y, z, World.Blocks[i], block);
+	World.Blocks[i] = block; 
 }
 #endif
 
@@ -320,7 +462,17 @@ Vec3 Respawn_FindSpawnPosition(float x, float z, Vec3 modelSize) {
 	return spawn;
 }
 
+static void OnInit(void) {
+	World_Reset();
+	Event_Register_(&BlockEvents.BlockDefChanged, NULL, OnBlockDefChanged);
+}
+
+static void OnFree(void) {
+	World_Reset();
+	Event_Unregister_(&BlockEvents.BlockDefChanged, NULL, OnBlockDefChanged);
+}
+
 struct IGameComponent World_Component = {
-	World_Reset, /* Init  */
-	World_Reset  /* Free  */
+	OnInit, /* Init  */
+	OnFree  /* Free  */
 };
@@ -20,6 +20,20 @@ extern struct IGameComponent World_Component;
 #define World_ChunkPack(cx, cy, cz) (((cz) * World.ChunksY + (cy)) * World.ChunksX + (cx))
 /* TODO: Swap Y and Z? Make sure to update MapRenderer's ResetChunkCache and ClearChunkCache methods! */
 
+/* Summary of the blocks in a chunk, kept up to date as blocks are changed */
+/* NOTE: Only counts blocks that are inside the world (partial chunks on the world edges) */
+struct ChunkSummary {
+	/* Number of blocks in the chunk that are not air */
+	cc_uint16 NonAir;
+	/* Number of blocks in the chunk that emit light (see Blocks.Brightness) */
+	/* NOTE: Use World_ChunkHasEmitters, as this is recalculated lazily after block definitions change */
+	cc_uint16 Emitters;
+	/* Whether every block in the chunk is Block */
+	/* NOTE: Is only set again when the chunk becomes all air, so may be false for a uniform chunk */
+	cc_bool Uniform;
+	BlockID Block;
+};
+
 
 CC_VAR extern struct _WorldData {
 	/* The blocks in the world. */
@@ -60,6 +74,9 @@ CC_VAR extern struct _WorldData {
 	int ChunksCount;
 	/* Seed world was generated with. May be 0 (unknown) */
 	int Seed;
+	/* Summary of the blocks in each chunk, indexed by World_ChunkPack */
+	/* NOTE: Is NULL when World.Blocks is NULL */
+	struct ChunkSummary* Summaries;
 } World;
 
 /* Frees the blocks array, sets dimensions to 0, resets environment to default. */
@@ -78,7 +95,17 @@ void World_OutOfMemory(void);
 #ifdef EXTENDED_BLOCKS
 /* Sets World.Blocks2 and updates internal state for more than 256 blocks. */
 void World_SetMapUpper(BlockRaw* blocks);
+#endif
+#ifdef CC_BUILD_FILEMAP
+/* Sets the memory mapped file that World.Blocks (and World.Blocks2) point into */
+/* NOTE: The mapped file is unmapped instead of freed when the world is reset */
+void World_SetMapped(void* data, cc_uint32 size);
+/* Copies the blocks of the world out of the memory mapped file (if any), then unmaps it */
+/* NOTE: Must be called before overwriting the file the world was loaded from */
+cc_bool World_CopyMapped(void);
+#endif
 
+#ifdef EXTENDED_BLOCKS
 #define World_GetRawBlock(idx) ((World.Blocks[idx] | (World.Blocks2[idx] << 8)) & World.IDMask)
 
 /* Gets the block at the given coordinates. */
@@ -102,6 +129,8 @@ void World_SetBlock(int x, int y, int z, BlockID block);
 /* If coordinates are outside the map, returns BLOCK_AIR. */
 /* Otherwise returns the block at the given coordinates. */
 BlockID World_SafeGetBlock(int x, int y, int z);
+/* Whether any blocks in the given chunk emit light */
+cc_bool World_ChunkHasEmitters(int cx, int cy, int cz);
 
 /* Whether the given coordinates lie inside the map. */
 static CC_INLINE cc_bool World_Contains(int x, int y, int z) {
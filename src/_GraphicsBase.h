@@ -15,7 +15,7 @@ struct _GfxData Gfx;
 static GfxResourceID Gfx_quadVb, Gfx_texVb;
 const cc_string Gfx_LowPerfMessage = String_FromConst("&eRunning in reduced performance mode (game minimised or hidden)");
 
-static const int strideSizes[] = { SIZEOF_VERTEX_COLOURED, SIZEOF_VERTEX_TEXTURED };
+static const int strideSizes[] = { SIZEOF_VERTEX_COLOURED, SIZEOF_VERTEX_TEXTURED, SIZEOF_VERTEX_PACKED };
 /* Whether mipmaps must be created for all dimensions down to 1x1 or not */
 static cc_bool customMipmapsLevels;
 /* Current format and size of vertices */
@@ -494,6 +494,219 @@ void Gfx_SetDynamicVbData(GfxResourceID vb, void* vertices, int vCount) {
 #endif
 
 
+#ifdef CC_BUILD_VBARENA
+/*########################################################################################################################*
+*---------------------------------------------------Vertex buffer arena---------------------------------------------------*
+*#########################################################################################################################*/
+/* Smallest slots have (1 << ARENA_MIN_SHIFT) vertices */
+#define ARENA_MIN_SHIFT 7
+#define ARENA_MAX_SLOTS (GFX_ARENA_PAGE_VERTICES >> ARENA_MIN_SHIFT)
+/* Slot handles are (page index * ARENA_MAX_SLOTS + slot index + 1), so that 0 means no slot */
+#define Arena_Page(handle) (&arenaPages[((handle) - 1) / ARENA_MAX_SLOTS])
+#define Arena_Slot(handle) (((handle) - 1) % ARENA_MAX_SLOTS)
+
+/* Acquires temp memory for changing count vertices, starting at the given vertex of a dynamic vertex buffer */
+static void* Gfx_LockVbRange(GfxResourceID vb, VertexFormat fmt, int offset, int count);
+/* Submits the changed vertices from the last call to Gfx_LockVbRange */
+static void  Gfx_UnlockVbRange(GfxResourceID vb);
+
+struct ArenaPage {
+	GfxResourceID vb; /* 0 if this page has been deleted */
+	cc_uint8 fmt, shift;
+	cc_bool draining; /* Whether slots are being moved out of this page, so it can be deleted */
+	int used, capacity, firstFree;
+	void** owners;    /* Owner of each slot, or NULL if the slot is free */
+};
+static struct ArenaPage* arenaPages;
+static int arenaPagesCount;
+
+static void Arena_DeletePage(struct ArenaPage* page) {
+	Gfx_DeleteDynamicVb(&page->vb);
+	Mem_Free(page->owners);
+
+	page->owners   = NULL;
+	page->draining = false;
+	page->used     = 0;
+}
+
+/* Whether another page can still fit slots of the same size class as the given page */
+static cc_bool Arena_HasRoomElsewhere(struct ArenaPage* page) {
+	struct ArenaPage* other;
+	int i;
+
+	for (i = 0; i < arenaPagesCount; i++) 
+	{
+		other = &arenaPages[i];
+		if (other == page || !other->vb || other->draining) continue;
+		if (other->fmt != page->fmt || other->shift != page->shift) continue;
+		if (other->used < other->capacity) return true;
+	}
+	return false;
+}
+
+static int Arena_AddPage(VertexFormat fmt, int shift) {
+	struct ArenaPage* page;
+	struct ArenaPage* pages;
+	int i;
+
+	for (i = 0; i < arenaPagesCount; i++) 
+	{
+		if (!arenaPages[i].vb) break;
+	}
+
+	if (i == arenaPagesCount) {
+		pages = (struct ArenaPage*)Mem_TryRealloc(arenaPages, arenaPagesCount + 1, sizeof(struct ArenaPage));
+		if (!pages) return -1;
+
+		arenaPages = pages;
+		arenaPagesCount++;
+		arenaPages[i].vb = 0;
+	}
+	page = &arenaPages[i];
+
+	page->capacity  = GFX_ARENA_PAGE_VERTICES >> shift;
+	page->owners    = (void**)Mem_TryAllocCleared(page->capacity, sizeof(void*));
+	if (!page->owners) return -1;
+
+	page->vb = Gfx_CreateDynamicVb(fmt, GFX_ARENA_PAGE_VERTICES);
+	if (!page->vb) { Mem_Free(page->owners); page->owners = NULL; return -1; }
+
+	page->fmt       = fmt;
+	page->shift     = shift;
+	page->draining  = false;
+	page->used      = 0;
+	page->firstFree = 0;
+	return i;
+}
+
+int Gfx_AllocArenaVb(VertexFormat fmt, int count, void* owner) {
+	struct ArenaPage* page;
+	int i, shift, best = -1;
+	if (count > GFX_ARENA_PAGE_VERTICES) return 0;
+
+	shift = ARENA_MIN_SHIFT;
+	while ((1 << shift) < count) shift++;
+
+	/* Fill up the fullest pages first, so that mostly empty pages are more likely to become empty */
+	for (i = 0; i < arenaPagesCount; i++) 
+	{
+		page = &arenaPages[i];
+		if (!page->vb || page->draining || page->used == page->capacity) continue;
+		if (page->fmt != fmt || page->shift != shift) continue;
+
+		if (best == -1 || page->used > arenaPages[best].used) best = i;
+	}
+
+	if (best == -1) best = Arena_AddPage(fmt, shift);
+	if (best == -1) return 0;
+	page = &arenaPages[best];
+
+	for (i = page->firstFree; page->owners[i]; i++) { }
+	page->owners[i] = owner;
+	page->used++;
+	page->firstFree = i + 1;
+	return best * ARENA_MAX_SLOTS + i + 1;
+}
+
+void Gfx_FreeArenaVb(int* slot) {
+	struct ArenaPage* page;
+	int i;
+	if (!(*slot)) return;
+
+	page = Arena_Page(*slot);
+	i    = Arena_Slot(*slot);
+	*slot = 0;
+
+	page->owners[i] = NULL;
+	page->used--;
+	page->firstFree = min(page->firstFree, i);
+	if (page->used) return;
+
+	/* Keep one empty page around to avoid constantly recreating it when chunks are rebuilt */
+	if (page->draining || Arena_HasRoomElsewhere(page)) Arena_DeletePage(page);
+}
+
+GfxResourceID Gfx_GetArenaVb(int slot, int* offset) {
+	struct ArenaPage* page = Arena_Page(slot);
+	*offset = Arena_Slot(slot) << page->shift;
+	return page->vb;
+}
+
+void* Gfx_LockArenaVb(int slot, int count) {
+	struct ArenaPage* page = Arena_Page(slot);
+	int offset = Arena_Slot(slot) << page->shift;
+	return Gfx_LockVbRange(page->vb, (VertexFormat)page->fmt, offset, count);
+}
+
+void Gfx_UnlockArenaVb(int slot) {
+	Gfx_UnlockVbRange(Arena_Page(slot)->vb);
+}
+
+static void Arena_Compact(VertexFormat fmt, int shift, Gfx_ArenaEvictFunc evict) {
+	struct ArenaPage* page;
+	struct ArenaPage* least = NULL;
+	int i, unused = 0;
+
+	for (i = 0; i < arenaPagesCount; i++) 
+	{
+		page = &arenaPages[i];
+		if (!page->vb || page->fmt != fmt || page->shift != shift) continue;
+		/* Only move the slots of one page at a time */
+		if (page->draining) return;
+
+		unused += page->capacity - page->used;
+		if (!least || page->used < least->used) least = page;
+	}
+
+	/* Only worth it when at least one page worth of slots is unused */
+	if (!least || unused < least->capacity) return;
+	if (!least->used) { Arena_DeletePage(least); return; }
+	/* The slots of the page must also fit into the free slots of the other pages */
+	if (unused - (least->capacity - least->used) < least->used) return;
+
+	least->draining = true;
+	/* Evicting may free slots straight away, which deletes the page once it is empty */
+	for (i = 0; least->owners && i < least->capacity; i++) 
+	{
+		if (least->owners[i]) evict(least->owners[i]);
+	}
+}
+
+void Gfx_CompactArena(Gfx_ArenaEvictFunc evict) {
+	int fmt, shift;
+	if (!arenaPagesCount) return;
+
+	for (fmt = 0; fmt <= VERTEX_FORMAT_PACKED; fmt++) 
+	{
+		for (shift = ARENA_MIN_SHIFT; (1 << shift) <= GFX_ARENA_PAGE_VERTICES; shift++) 
+		{
+			Arena_Compact((VertexFormat)fmt, shift, evict);
+		}
+	}
+}
+
+void Gfx_ReleaseArena(void) {
+	int i, pages = 0;
+
+	for (i = 0; i < arenaPagesCount; i++) 
+	{
+		if (!arenaPages[i].vb) continue;
+
+		if (arenaPages[i].used) {
+			pages++;
+		} else {
+			Arena_DeletePage(&arenaPages[i]);
+		}
+	}
+	if (pages) return;
+
+	Mem_Free(arenaPages);
+	arenaPages      = NULL;
+	arenaPagesCount = 0;
+}
+#endif
+
+
 /*########################################################################################################################*
 *----------------------------------------------------Graphics component---------------------------------------------------*
 *#########################################################################################################################*/
@@ -9,6 +9,7 @@
 #include "Launcher.h"
 #include "Server.h"
 #include "Options.h"
+#include "Benchmark.h"
 #include "main.h"
 
 /*########################################################################################################################*
@@ -189,6 +190,31 @@ static int RunProgram(int argc, char** argv) {
 		Options_Get(LOPT_USERNAME, &Game_Username, DEFAULT_USERNAME);
 		String_Copy(&SP_AutoloadMap, &args[0]); /* TODO: don't copy args? */
 		RunGame();
+	/* --benchmark [file path] - run benchmark in singleplayer with auto loaded map */
+	} else if (argsCount == 2 && String_CaselessEqualsConst(&args[0], DEFAULT_BENCHMARK_ARG)) {
+		if (!IsOpenableFile(&args[1])) {
+			WarnInvalidArg("Map not found", &args[1]);
+			return 1;
+		}
+
+		Options_Get(LOPT_USERNAME, &Game_Username, DEFAULT_USERNAME);
+		String_Copy(&SP_AutoloadMap, &args[1]);
+		Benchmark_Enabled = true;
+		RunGame();
+	/* --netbenchmark [file path] - run benchmark that replays captured network data */
+	} else if (argsCount == 2 && String_CaselessEqualsConst(&args[0], DEFAULT_NETBENCHMARK_ARG)) {
+		cc_filepath path;
+		Platform_EncodePath(&path, &args[1]);
+		if (!File_Exists(&path)) {
+			WarnInvalidArg("Capture not found", &args[1]);
+			return 1;
+		}
+
+		Options_Get(LOPT_USERNAME, &Game_Username, DEFAULT_USERNAME);
+		String_Copy(&MP_ReplayPath, &args[1]);
+		Benchmark_Enabled = true;
+		Benchmark_Network = true;
+		RunGame();
 #endif
 	/* mc://[addr]:[port]/[user]/[mppass] - run multiplayer using direct URL form arguments */
 	} else if (argsCount == 1 && DirectUrl_Claims(&args[0], &host, &r.user, &r.mppass)) {
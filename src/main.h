@@ -8,6 +8,8 @@ CC_BEGIN_HEADER
 
 #define DEFAULT_SINGLEPLAYER_ARG "--singleplayer"
 #define DEFAULT_RESUME_ARG       "--resume"
+#define DEFAULT_BENCHMARK_ARG    "--benchmark"
+#define DEFAULT_NETBENCHMARK_ARG "--netbenchmark"
 
 struct ResumeInfo {
 	cc_string user, ip, port, server, mppass;